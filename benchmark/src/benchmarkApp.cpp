@@ -0,0 +1,1245 @@
+#include "benchmarkApp.h"
+#include "ofxGpuThicklinesMath.h"
+#include "ofxGpuThicklinesPrograms.h"
+#include "ofxGpuThicklinesQuantize.h"
+#include "ofxGpuThicklinesTessellator.h"
+#include <atomic>
+#include <fstream>
+#include <random>
+#include <thread>
+#ifndef TARGET_WIN32
+#include <sys/resource.h>
+#endif
+
+namespace {
+    const ofxGpuThicklines::IndexMode indexModes[] = {
+        ofxGpuThicklines::INDEX_LINES_ADJACENCY,
+        ofxGpuThicklines::INDEX_LINE_STRIP_ADJACENCY,
+        ofxGpuThicklines::INDEX_LINES
+    };
+    const ofxGpuThicklines::VertexLayout layouts[] = {
+        ofxGpuThicklines::LAYOUT_SPLIT,
+        ofxGpuThicklines::LAYOUT_INTERLEAVED
+    };
+    const size_t polylinePoints = 10000;
+    const int updateFramesPerCase = 5;
+    const int gpuWarmupFrames = 10;
+    const int gpuFramesPerCase = 60;
+    const uint64_t handoffUpdates = 100000000; // vertex updates per handoff case
+    const size_t referenceWidth = 1024;
+    const size_t referenceHeight = 768;
+    const int referenceRuns = 5;
+    // of the vertex shader math against the tessellator, which computes the same in other steps:
+    // in normalized device coordinates, about 0.005 pixels of the reference scenes
+    const float expansionTolerance = 1e-5f;
+    const int pickingFrames = 10;
+    const int pickingQueries = 20; // per frame
+
+    // the reference scenes are built with the helpers below rather than with ofRandom(), ofNoise(),
+    // ofMesh::sphere() and the ofMatrix4x4 factories, which round differently between platforms and
+    // releases of openFrameworks: the golden images have to match wherever the benchmark is built.
+    // std::mt19937 gives the same numbers everywhere, its distributions don't
+    struct ReferenceRandom {
+        std::mt19937 engine;
+        explicit ReferenceRandom(uint32_t seed) : engine(seed) { ; }
+        float operator()(float max) { return (*this)(0, max); }
+        float operator()(float min, float max) {
+            return float(min + (max - min) * (engine() / 4294967296.0));
+        }
+    };
+
+    // in double, laid out as ofMatrix4x4 for row vectors: a point is transformed as p * m.
+    // The picking cases use these too.
+    struct ReferenceMatrix {
+        double m[4][4];
+
+        ReferenceMatrix() {
+            for(int i=0; i<4; ++i)
+                for(int j=0; j<4; ++j)
+                    m[i][j] = i == j ? 1 : 0;
+        }
+        ReferenceMatrix operator*(const ReferenceMatrix &o) const {
+            ReferenceMatrix r;
+            for(int i=0; i<4; ++i) {
+                for(int j=0; j<4; ++j) {
+                    r.m[i][j] = 0;
+                    for(int k=0; k<4; ++k)
+                        r.m[i][j] += m[i][k] * o.m[k][j];
+                }
+            }
+            return r;
+        }
+        ofMatrix4x4 toMatrix() const {
+            float values[16];
+            for(int i=0; i<16; ++i)
+                values[i] = float(m[i / 4][i % 4]);
+            return ofMatrix4x4(values);
+        }
+
+        static ReferenceMatrix translation(double x, double y, double z) {
+            ReferenceMatrix r;
+            r.m[3][0] = x; r.m[3][1] = y; r.m[3][2] = z;
+            return r;
+        }
+        static ReferenceMatrix scale(double x, double y, double z) {
+            ReferenceMatrix r;
+            r.m[0][0] = x; r.m[1][1] = y; r.m[2][2] = z;
+            return r;
+        }
+        // as gluLookAt()
+        static ReferenceMatrix lookAt(const double eye[3], const double center[3], const double up[3]) {
+            double f[3] = { center[0] - eye[0], center[1] - eye[1], center[2] - eye[2] };
+            normalize(f);
+            double s[3] = { f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0] };
+            normalize(s);
+            const double u[3] = { s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0] };
+            ReferenceMatrix r;
+            for(int i=0; i<3; ++i) {
+                r.m[i][0] = s[i];
+                r.m[i][1] = u[i];
+                r.m[i][2] = -f[i];
+            }
+            r.m[3][0] = -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+            r.m[3][1] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+            r.m[3][2] = f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2];
+            return r;
+        }
+        // as gluPerspective(), the field of view in degrees
+        static ReferenceMatrix perspective(double fovy, double aspect, double zNear, double zFar) {
+            const double f = 1 / std::tan(fovy * PI / 360);
+            ReferenceMatrix r;
+            r.m[0][0] = f / aspect;
+            r.m[1][1] = f;
+            r.m[2][2] = (zFar + zNear) / (zNear - zFar);
+            r.m[2][3] = -1;
+            r.m[3][2] = 2 * zFar * zNear / (zNear - zFar);
+            r.m[3][3] = 0;
+            return r;
+        }
+        // as glOrtho()
+        static ReferenceMatrix ortho(double left, double right, double bottom, double top, double zNear, double zFar) {
+            ReferenceMatrix r;
+            r.m[0][0] = 2 / (right - left);
+            r.m[1][1] = 2 / (top - bottom);
+            r.m[2][2] = -2 / (zFar - zNear);
+            r.m[3][0] = -(right + left) / (right - left);
+            r.m[3][1] = -(top + bottom) / (top - bottom);
+            r.m[3][2] = -(zFar + zNear) / (zFar - zNear);
+            return r;
+        }
+
+    private:
+        static void normalize(double v[3]) {
+            const double length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            for(int i=0; i<3; ++i)
+                v[i] /= length;
+        }
+    };
+
+    // a UV sphere of triangles, `resolution` rings from pole to pole and twice as many around,
+    // with one vertex per pole
+    ofMesh referenceSphere(double radius, int resolution) {
+        ofMesh mesh;
+        mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+        const int around = resolution * 2;
+        mesh.addVertex(ofVec3f(0, float(radius), 0));
+        for(int ring=1; ring<resolution; ++ring) {
+            const double polar = PI * ring / resolution;
+            for(int i=0; i<around; ++i) {
+                const double azimuth = 2 * PI * i / around;
+                mesh.addVertex(ofVec3f(float(radius * std::sin(polar) * std::cos(azimuth)),
+                                       float(radius * std::cos(polar)),
+                                       float(radius * std::sin(polar) * std::sin(azimuth))));
+            }
+        }
+        const ofIndexType bottom = mesh.getNumVertices();
+        mesh.addVertex(ofVec3f(0, float(-radius), 0));
+        for(int i=0; i<around; ++i) {
+            const ofIndexType next = (i + 1) % around;
+            mesh.addIndex(0); mesh.addIndex(1 + i); mesh.addIndex(1 + next);
+            for(int ring=1; ring+1<resolution; ++ring) {
+                const ofIndexType a = 1 + (ring - 1) * around, b = a + around;
+                mesh.addIndex(a + i); mesh.addIndex(b + i); mesh.addIndex(a + next);
+                mesh.addIndex(a + next); mesh.addIndex(b + i); mesh.addIndex(b + next);
+            }
+            const ofIndexType last = 1 + (resolution - 2) * around;
+            mesh.addIndex(last + i); mesh.addIndex(bottom); mesh.addIndex(last + next);
+        }
+        return mesh;
+    }
+
+    float millisecondsSince(uint64_t t0) {
+        return (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+    }
+
+    // the most memory this process held so far, 0 where we can't tell
+    size_t processPeakBytes() {
+#ifdef TARGET_WIN32
+        return 0;
+#else
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef TARGET_OSX
+        return size_t(usage.ru_maxrss);
+#else
+        return size_t(usage.ru_maxrss) * 1024; // KiB on linux
+#endif
+#endif
+    }
+}
+
+//--------------------------------------------------------------
+void benchmarkApp::setup(){
+    ofLogNotice("benchmark") << "up to " << m_maxSegments << " segments, "
+                             << std::thread::hardware_concurrency() << " hardware threads";
+    if(m_gpu) {
+        // the cases are drawn one after the other by `draw()`
+        ofSetVerticalSync(false);
+        for(size_t segments=1000; segments<=m_maxSegments; segments*=10) {
+            for(int g=0; g<numGenerators; ++g) {
+                for(ofxGpuThicklines::IndexMode mode : indexModes) {
+                    for(ofxGpuThicklines::VertexLayout layout : layouts) {
+                        GpuResult r = GpuResult();
+                        r.generator = Generator(g);
+                        r.indexMode = mode;
+                        r.layout = layout;
+                        r.segments = segments;
+                        m_gpuResults.push_back(r);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    if(m_handoff) {
+        for(size_t vertices=1000; vertices<=m_maxSegments; vertices*=10) {
+            HandoffResult r = runHandoff(vertices, std::max(uint64_t(100), handoffUpdates / vertices));
+            ofLogNotice("benchmark") << "handoff " << vertices << " vertices: " << r.published << " frames published, "
+                                     << r.pulled << " pulled in " << r.ms << " ms, " << r.pullMs << " ms per pull, "
+                                     << r.errors << " errors";
+            if(r.errors > 0) {
+                ofLogError("benchmark") << "handoff of " << vertices << " vertices failed";
+                m_failed = true;
+            }
+            m_handoffResults.push_back(r);
+        }
+        finish();
+        return;
+    }
+
+    if(m_picking) {
+        // long segments across the scene, and short ones in dense random walks
+        const Generator generators[] = { GENERATOR_RANDOM_CURVES, GENERATOR_POLYLINES };
+        for(Generator g : generators) {
+            for(size_t segments=1000; segments<=m_maxSegments; segments*=10) {
+                PickingResult r = runPicking(g, segments);
+                ofLogNotice("benchmark") << "picking " << generatorName(g) << " " << r.segments << " segments: "
+                                         << r.picks << " picks, pick " << r.pickMs.avg << " ms, grid rebuilt " << r.rebuildMs.avg << " ms, linear scan "
+                                         << r.scanMs.avg << " ms, " << r.errors << " errors";
+                if(r.errors > 0) {
+                    ofLogError("benchmark") << "picking " << generatorName(g) << " " << r.segments << " segments failed";
+                    m_failed = true;
+                }
+                m_pickingResults.push_back(r);
+            }
+        }
+        finish();
+        return;
+    }
+
+    if(m_checks) {
+        ProgramsResult programs = runPrograms();
+        ofLogNotice("benchmark") << "programs: " << programs.programs << " held, " << programs.builds << " built";
+        if(! programs.passed()) {
+            ofLogError("benchmark") << "programs failed: " << (programs.shared ? "" : "a key was built twice ")
+                                    << (programs.separated ? "" : "colliding keys share a program ")
+                                    << (programs.rebuilt ? "" : "a program let go was not built again");
+            m_failed = true;
+        }
+        m_programsResults.push_back(programs);
+        for(int s=0; s<numReferenceScenes; ++s) {
+            for(ofxGpuThicklines::IndexMode mode : indexModes) {
+                if(mode == ofxGpuThicklines::INDEX_LINES) continue; // the tessellator doesn't take it
+                ExpansionResult e = runExpansion(ReferenceScene(s), mode);
+                ofLogNotice("benchmark") << "expansion " << referenceSceneName(e.scene) << " " << indexModeName(mode) << ": "
+                                         << e.segments << " segments, " << e.vertices << " vertices, largest error "
+                                         << e.maxError << ", " << e.mismatches << " mismatches";
+                if(e.mismatches > 0) {
+                    ofLogError("benchmark") << "expansion of " << referenceSceneName(e.scene) << " " << indexModeName(mode)
+                                            << " failed: the vertex shader math and the tessellator differ";
+                    m_failed = true;
+                }
+                m_expansionResults.push_back(e);
+            }
+        }
+        runQuantization(ofxGpuThicklines::POSITIONS_HALF);
+        runQuantization(ofxGpuThicklines::POSITIONS_UNORM16);
+        for(const QuantizationResult &q : m_quantizationResults) {
+            ofLogNotice("benchmark") << "quantization " << (q.positions == ofxGpuThicklines::POSITIONS_HALF ? "half" : "unorm16")
+                                     << (q.grown ? " grown" : "") << ": position error " << q.error.position
+                                     << " of " << q.bound.position << ", " << q.violations << " values beyond";
+            if(q.violations > 0) {
+                ofLogError("benchmark") << "quantization failed: " << q.violations << " values beyond the bound";
+                m_failed = true;
+            }
+        }
+        finish();
+        return;
+    }
+
+    if(m_reference) {
+        for(int s=0; s<numReferenceScenes; ++s) {
+            ReferenceResult r = runReference(ReferenceScene(s));
+            ofLogNotice("benchmark") << "reference " << referenceSceneName(r.scene) << ": " << r.triangles << " triangles, "
+                                     << r.fragments << " fragments, raster " << r.rasterMs.avg << " ms, golden "
+                                     << r.golden << " (" << r.differingPixels << " pixels differ)";
+            if(r.golden == "mismatch" || r.golden == "missing" || ! r.modesMatch) {
+                ofLogError("benchmark") << "reference " << referenceSceneName(r.scene) << " failed"
+                                        << (r.modesMatch ? "" : ": the index modes draw different images");
+                m_failed = true;
+            }
+            m_referenceResults.push_back(r);
+        }
+        finish();
+        return;
+    }
+
+    for(size_t segments=1000; segments<=m_maxSegments; segments*=10) {
+        for(int g=0; g<numGenerators; ++g) {
+            for(ofxGpuThicklines::IndexMode mode : indexModes) {
+                for(ofxGpuThicklines::VertexLayout layout : layouts) {
+                    Result r = run(Generator(g), mode, layout, segments);
+                    ofLogNotice("benchmark") << generatorName(r.generator) << " " << indexModeName(mode) << " "
+                                             << layoutName(layout) << " " << r.segments << " segments: setup "
+                                             << r.setupMs << " ms, reset " << r.resetMs << " ms, sparse update "
+                                             << r.sparseUpdateMs << " ms, full update " << r.fullUpdateMs << " ms";
+                    m_results.push_back(r);
+                }
+            }
+        }
+    }
+    finish();
+}
+
+//--------------------------------------------------------------
+void benchmarkApp::draw(){
+    if(! m_gpu) return;
+    if(m_gpuCase >= m_gpuResults.size()) {
+        finish();
+        return;
+    }
+    GpuResult &r = m_gpuResults[m_gpuCase];
+    if(m_gpuFrame == 0)
+        startGpuCase(r);
+
+    ofBackground(0);
+    m_cam.begin();
+    m_gpuLines.draw(2);
+    m_cam.end();
+
+    ++m_gpuFrame;
+    if(m_gpuFrame == gpuWarmupFrames)
+        m_gpuLines.clearStats();
+    if(m_gpuFrame == gpuWarmupFrames + gpuFramesPerCase) {
+        ofxGpuThicklines::StatsSummary summary = m_gpuLines.statsSummary();
+        r.segments = m_gpuLines.lastFrameStats().segments;
+        r.gpuFrames = summary.gpuFrames;
+        r.drawMs = summary.drawMs;
+        r.gpuMs = summary.gpuMs;
+        ofImage screen;
+        screen.grabScreen(0, 0, ofGetWidth(), ofGetHeight());
+        if(r.layout == ofxGpuThicklines::LAYOUT_SPLIT) {
+            m_gpuSplitPixels = screen.getPixels();
+        }
+        else {
+            r.differingPixels = ofxGpuThicklinesRasterizer::compare(m_gpuSplitPixels, screen.getPixels()).pixels;
+            if(r.differingPixels > 0) {
+                ofLogError("benchmark") << generatorName(r.generator) << " " << indexModeName(r.indexMode) << " "
+                                        << layoutName(r.layout) << " draws " << r.differingPixels
+                                        << " pixels differently from the split layout";
+                m_failed = true;
+            }
+        }
+        ofLogNotice("benchmark") << generatorName(r.generator) << " " << indexModeName(r.indexMode) << " "
+                                 << layoutName(r.layout) << " " << r.segments << " segments: draw "
+                                 << r.drawMs.avg << " ms, GPU " << r.gpuMs.avg << " ms (p99 " << r.gpuMs.p99 << ")";
+        ++m_gpuCase;
+        m_gpuFrame = 0;
+    }
+}
+
+// loads the scene of `r` and points the camera at it
+void benchmarkApp::startGpuCase(GpuResult &r){
+    Scene scene;
+    generate(r.generator, r.segments, scene);
+    m_gpuLines = ofxGpuThicklines();
+    m_gpuLines.setIndexMode(r.indexMode);
+    m_gpuLines.setVertexLayout(r.layout);
+    if(r.generator == GENERATOR_GRID || r.generator == GENERATOR_SPHERE)
+        m_gpuLines.setup(scene.mesh);
+    else
+        m_gpuLines.setup(std::move(scene.positions), std::move(scene.colors), std::move(scene.curves));
+    r.vertices = m_gpuLines.positions().size();
+
+    ofxGpuThicklinesCulling::Box box;
+    for(const ofVec3f &p : m_gpuLines.positions())
+        box.add(p);
+    const float radius = std::max(1.0f, (box.max - box.min).length() * 0.5f);
+    m_cam.setNearClip(radius * 0.1f);
+    m_cam.setFarClip(radius * 10);
+    m_cam.setPosition(box.center() + ofVec3f(0, 0, radius * 2));
+    m_cam.lookAt(box.center());
+}
+
+// the vertices frame `frame` changes: 0, which holds the frame number, and a random block.
+// every 16th frame changes all of them.
+void benchmarkApp::handoffFrame(uint64_t frame, size_t vertices, vector<size_t> &changed) {
+    changed.clear();
+    if(frame % 16 == 0) {
+        for(size_t i=0; i<vertices; ++i)
+            changed.push_back(i);
+        return;
+    }
+    std::mt19937 rng(static_cast<uint32_t>(frame));
+    size_t length = 1 + rng() % std::max(size_t(1), vertices / 50);
+    size_t begin = rng() % vertices;
+    changed.push_back(0);
+    for(size_t i=begin; i<std::min(begin + length, vertices); ++i)
+        changed.push_back(i);
+}
+
+benchmarkApp::HandoffResult benchmarkApp::runHandoff(size_t vertices, uint64_t frames) {
+    HandoffResult r = HandoffResult();
+    r.vertices = vertices;
+
+    // vertex i of frame g is at (i, g) with color (g, 0, 0, 1): the last frame that changed it
+    vector<ofVec3f> positions(vertices);
+    for(size_t i=0; i<vertices; ++i)
+        positions[i] = ofVec3f(i, 0, 0);
+    vector<ofVec4f> colors(vertices, ofVec4f(0, 0, 0, 1));
+    vector<size_t> curve(vertices);
+    for(size_t i=0; i<vertices; ++i)
+        curve[i] = i;
+    ofxGpuThicklines lines;
+    lines.setRenderBackend(ofxGpuThicklines::BACKEND_NONE);
+    lines.setup(positions, colors, vector< vector<size_t> >(1, curve));
+    shared_ptr<ofxGpuThicklines::Producer> producer = lines.startProducer();
+
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    std::atomic<bool> done(false);
+    std::thread worker([&]() {
+        vector<size_t> changed;
+        for(uint64_t g=1; g<=frames; ++g) {
+            handoffFrame(g, vertices, changed);
+            for(size_t i : changed)
+                producer->updateVertex(i, ofVec3f(i, g, 0), ofVec4f(g, 0, 0, 1));
+            producer->publish();
+        }
+        done = true;
+    });
+
+    vector<size_t> changed;
+    uint64_t seen = 0;
+    uint64_t pullMicros = 0;
+    for(;;) {
+        const bool finished = done; // before pulling, so that the last frame is pulled too
+        uint64_t p0 = ofGetElapsedTimeMicros();
+        if(! lines.pullUpdates()) {
+            if(finished) break;
+            continue;
+        }
+        pullMicros += ofGetElapsedTimeMicros() - p0;
+        ++r.pulled;
+        const uint64_t g = uint64_t(lines.positions()[0].y);
+        if(g <= seen) {
+            ++r.errors;
+            continue;
+        }
+        for(uint64_t k=seen+1; k<=g; ++k) {
+            handoffFrame(k, vertices, changed);
+            for(size_t i : changed) {
+                positions[i].y = k;
+                colors[i].x = k;
+            }
+        }
+        seen = g;
+        if(lines.positions() != positions || lines.colors() != colors)
+            ++r.errors;
+    }
+    worker.join();
+    if(seen != frames)
+        ++r.errors;
+    r.published = producer->numPublished();
+    r.ms = millisecondsSince(t0);
+    r.pullMs = r.pulled > 0 ? pullMicros / 1000.0f / r.pulled : 0;
+    return r;
+}
+
+namespace {
+    // as ofxGpuThicklinesPicker projects them: window position and clip space w, 0 behind the eye
+    void projectVertices(const vector<ofVec3f> &positions, const ofMatrix4x4 &modelViewProjection,
+                         const ofRectangle &viewport, vector<ofVec3f> &screen) {
+        screen.resize(positions.size());
+        for(size_t i=0; i<positions.size(); ++i) {
+            const ofVec4f clip = ofxGpuThicklinesMath::toClip(modelViewProjection, positions[i]);
+            screen[i] = clip.w > 0 ? ofVec3f(viewport.x + (clip.x / clip.w + 1.0f) * 0.5f * viewport.width,
+                                             viewport.y + (1.0f - clip.y / clip.w) * 0.5f * viewport.height, clip.w)
+                                   : ofVec3f(0, 0, 0);
+        }
+    }
+
+    // from `p` to the segment between two projected vertices, on screen, as the picker measures it.
+    // -1 for segments with an end behind the eye, which can't be picked
+    float screenDistance(const ofVec3f &a, const ofVec3f &b, ofVec2f p) {
+        if(! (a.z > 0 && b.z > 0))
+            return -1;
+        const ofVec2f ab(b.x - a.x, b.y - a.y), ap(p.x - a.x, p.y - a.y);
+        const float lengthSquared = ab.lengthSquared();
+        const float along = lengthSquared > 0 ? ofClamp(ap.dot(ab) / lengthSquared, 0, 1) : 0;
+        return (ap - ab * along).length();
+    }
+}
+
+benchmarkApp::PickingResult benchmarkApp::runPicking(Generator g, size_t segments) {
+    PickingResult r = PickingResult();
+    r.generator = g;
+    Scene scene;
+    generate(g, segments, scene);
+    scene.colors.assign(scene.positions.size(), ofVec4f(1, 1, 1, 1));
+    for(const vector<size_t> &curve : scene.curves)
+        r.segments += curve.size() - 1;
+    ofxGpuThicklines lines;
+    lines.setRenderBackend(ofxGpuThicklines::BACKEND_NONE);
+    lines.setup(scene.positions, scene.colors, scene.curves);
+
+    // the scene spans [0, 1000] in x and y, the camera looks at its center from a distance where
+    // it fills the viewport, and orbits it for the camera changes
+    const ofRectangle viewport(0, 0, referenceWidth, referenceHeight);
+    const double distance = 500 / std::tan(PI / 6);
+    const ReferenceMatrix projection = ReferenceMatrix::perspective(60, viewport.width / viewport.height, distance / 10, distance * 10);
+    auto camera = [&](double angle) {
+        const double eye[3] = { 500 + distance * std::sin(angle), 500, distance * std::cos(angle) };
+        const double center[3] = { 500, 500, 0 }, up[3] = { 0, 1, 0 };
+        return (ReferenceMatrix::lookAt(eye, center, up) * projection).toMatrix();
+    };
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(0, 1);
+    vector<ofVec3f> screen;
+    vector<float> pickMs, scanMs, rebuildMs;
+    // picks at random points, each checked against a linear scan over every segment. A different
+    // segment at the same distance is no error: ties are broken by the order of the segments.
+    // The distances may differ by rounding where the compiler fuses multiply-adds differently.
+    const float tolerance = 1e-3f;
+    auto check = [&](const ofMatrix4x4 &modelViewProjection, int picks) {
+        projectVertices(lines.positions(), modelViewProjection, viewport, screen);
+        for(int q=0; q<picks; ++q) {
+            // away from the edges by the radius, where the picker doesn't look for segments
+            // outside the viewport
+            const float radius = 2 + 8 * unit(rng);
+            const ofVec2f p(radius + (viewport.width - 2 * radius) * unit(rng), radius + (viewport.height - 2 * radius) * unit(rng));
+            const ofxGpuThicklines::Pick pick = lines.pick(p, modelViewProjection, viewport, radius);
+            (lines.pickingStats().rebuilt ? rebuildMs : pickMs).push_back(lines.pickingStats().milliseconds);
+
+            uint64_t t0 = ofGetElapsedTimeMicros();
+            bool hit = false;
+            float nearest = radius;
+            for(const vector<size_t> &curve : scene.curves) {
+                for(size_t j=0; j+1<curve.size(); ++j) {
+                    const float d = screenDistance(screen[curve[j]], screen[curve[j + 1]], p);
+                    if(d >= 0 && d <= nearest) {
+                        hit = true;
+                        nearest = d;
+                    }
+                }
+            }
+            scanMs.push_back(millisecondsSince(t0));
+
+            ++r.picks;
+            bool error = pick.hit != hit || (hit && std::abs(pick.distance - nearest) > tolerance);
+            if(! error && hit) {
+                const vector<size_t> &curve = scene.curves[pick.curve];
+                error = pick.segment + 1 >= curve.size()
+                     || std::abs(screenDistance(screen[curve[pick.segment]], screen[curve[pick.segment + 1]], p) - pick.distance) > tolerance;
+            }
+            if(error) {
+                if(r.errors < 10)
+                    ofLogError("benchmark") << "picking " << generatorName(g) << " " << r.segments << " segments: pick at " << p << " found "
+                                            << (pick.hit ? ofToString(pick.distance) : string("nothing")) << ", the scan "
+                                            << (hit ? ofToString(nearest) : string("nothing"));
+                ++r.errors;
+            }
+        }
+    };
+
+    // the vertices move under a fixed camera: the picks only sort in again the segments of the
+    // vertices moved. Every other frame picks before `endUpdates()`, which has to see the moves too.
+    const ofMatrix4x4 fixed = camera(0);
+    check(fixed, pickingQueries);
+    for(int frame=0; frame<pickingFrames; ++frame) {
+        lines.beginUpdates();
+        for(size_t k=0; k<std::max(size_t(1), lines.positions().size() / 100); ++k) {
+            const size_t i = rng() % lines.positions().size();
+            lines.updatePosition(i, lines.positions()[i] + ofVec3f(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f) * 40);
+        }
+        if(frame % 2 == 0)
+            lines.endUpdates();
+        check(fixed, pickingQueries);
+        if(frame % 2 == 1)
+            lines.endUpdates();
+    }
+    // then the camera moves every frame, and every first pick builds the whole grid again
+    for(int frame=1; frame<=pickingFrames; ++frame)
+        check(camera(0.02 * frame), 2);
+
+    r.pickMs = ofxGpuThicklinesStats::summarize(pickMs);
+    r.rebuildMs = ofxGpuThicklinesStats::summarize(rebuildMs);
+    r.scanMs = ofxGpuThicklinesStats::summarize(scanMs);
+    r.cells = lines.pickingStats().cells;
+    return r;
+}
+
+void benchmarkApp::referenceScene(ReferenceScene s, Scene &scene, ReferenceView &view) {
+    const float w = referenceWidth, h = referenceHeight;
+    vector<ofVec3f> &positions = scene.positions;
+    vector<ofVec4f> &colors = scene.colors;
+    vector< vector<size_t> > &curves = scene.curves;
+    ofMatrix4x4 &modelViewProjection = view.modelViewProjection;
+    view.lineWidth = 3;
+    view.perspective = true;
+    view.globalColor = ofFloatColor(1, 1, 1, 1);
+    view.blendMode = OF_BLENDMODE_ALPHA;
+    // the default camera of openFrameworks: a field of view of 60 degrees, and at a distance
+    // where the window height fits at z = 0
+    const double distance = h * 0.5 / std::tan(PI / 6);
+    const ReferenceMatrix projection = ReferenceMatrix::perspective(60, double(w) / h, distance / 10, distance * 10);
+
+    ReferenceRandom random(1);
+    if(s == REFERENCE_EXAMPLE) {
+        // example/testApp, with the mouse in the middle of the window, and alphas ramping up where
+        // the example takes them from ofNoise()
+        const int c = 15;
+        for(int i=0; i<c; ++i) {
+            const float x = random(w), y = random(h), z = random(-150, 150);
+            positions.push_back(ofVec3f(x, y, z));
+            colors.push_back(ofVec4f(1, 1, 1, 0.3f + 0.05f * i));
+        }
+        for(int i=0; i<500; ++i) {
+            vector<size_t> curve(size_t(random(3, 7)));
+            for(size_t &k : curve)
+                k = size_t(random(c)) % c;
+            curves.push_back(curve);
+        }
+        const size_t mouse = positions.size();
+        positions.push_back(ofVec3f(w / 2, h / 2, 0));
+        colors.push_back(ofVec4f(1, 1, 1, 1));
+        for(size_t i=0; i<c; ++i) {
+            for(size_t j=i+1; j<c; ++j) {
+                vector<size_t> curve;
+                curve.push_back(i); curve.push_back(mouse); curve.push_back(j);
+                curves.push_back(curve);
+            }
+        }
+        view.globalColor = ofColor(255, 50, 10, 255);
+        view.blendMode = OF_BLENDMODE_SCREEN;
+        // ofScale(1, -1, 1), then ofTranslate(-w / 2, -h / 2)
+        const double eye[3] = { 0, 0, distance }, center[3] = { 0, 0, 0 }, up[3] = { 0, 1, 0 };
+        modelViewProjection = (ReferenceMatrix::translation(-w / 2, -h / 2, 0)
+                               * ReferenceMatrix::scale(1, -1, 1)
+                               * ReferenceMatrix::lookAt(eye, center, up)
+                               * projection).toMatrix();
+    }
+    else if(s == REFERENCE_SPHERE) {
+        const float radius = h * 0.35f;
+        ofMesh mesh = referenceSphere(radius, 24);
+        positions = mesh.getVertices();
+        curves = ofxGpuThicklines::meshToCurves(mesh);
+        for(const ofVec3f &p : positions)
+            colors.push_back(ofVec4f(0.5f + 0.5f * p.y / radius, 0.6f, 0.5f - 0.5f * p.y / radius, 0.8f));
+        view.lineWidth = 4;
+        const double eye[3] = { 0, distance * 0.5, distance }, center[3] = { 0, 0, 0 }, up[3] = { 0, 1, 0 };
+        modelViewProjection = (ReferenceMatrix::lookAt(eye, center, up) * projection).toMatrix();
+    }
+    else {
+        // one zigzag per row, the turns of row k being 14 (k + 1) degrees, so that the joins of
+        // the last rows turn further than MITER_LIMIT and take the other branch of the join code
+        const int rows = 12, points = 12;
+        const float length = w / (points + 2);
+        for(int k=0; k<rows; ++k) {
+            const float angle = ofDegToRad(7.0f * (k + 1));
+            ofVec3f p(length, h * (k + 0.5f) / (rows + 1), 0);
+            vector<size_t> curve;
+            for(int i=0; i<points; ++i) {
+                curve.push_back(positions.size());
+                positions.push_back(p);
+                colors.push_back(ofVec4f(float(i) / points, float(k) / rows, 1, 0.8f));
+                p += ofVec3f(std::cos(angle), i % 2 == 0 ? std::sin(angle) : -std::sin(angle), 0) * length;
+            }
+            curves.push_back(curve);
+        }
+        view.lineWidth = 12;
+        view.perspective = false;
+        modelViewProjection = ReferenceMatrix::ortho(0, w, 0, h, -1, 1).toMatrix();
+    }
+}
+
+benchmarkApp::ReferenceResult benchmarkApp::runReference(ReferenceScene s) {
+    ReferenceResult r = ReferenceResult();
+    r.scene = s;
+    r.width = referenceWidth;
+    r.height = referenceHeight;
+    Scene scene;
+    ReferenceView view;
+    referenceScene(s, scene, view);
+    for(const vector<size_t> &curve : scene.curves)
+        r.segments += curve.size() > 1 ? curve.size() - 1 : 0;
+
+    // the first mode is timed and compared with the golden image, the second has to draw the same
+    const ofxGpuThicklines::IndexMode modes[] = {
+        ofxGpuThicklines::INDEX_LINES_ADJACENCY,
+        ofxGpuThicklines::INDEX_LINE_STRIP_ADJACENCY
+    };
+    ofPixels images[2];
+    vector<float> tessellateMs, setupMs, rasterMs;
+    ofxGpuThicklinesRasterizer rasterizer;
+    rasterizer.allocate(r.width, r.height);
+    rasterizer.setGlobalColor(view.globalColor);
+    rasterizer.setBlendMode(view.blendMode);
+    for(int m=0; m<2; ++m) {
+        ofxGpuThicklines lines;
+        lines.setRenderBackend(ofxGpuThicklines::BACKEND_NONE);
+        lines.setIndexMode(modes[m]);
+        lines.setup(scene.positions, scene.colors, scene.curves);
+        for(int run=0; run<(m == 0 ? referenceRuns : 1); ++run) {
+            rasterizer.clear(ofFloatColor(0, 0, 0, 1));
+            rasterizer.draw(lines, view.modelViewProjection, view.lineWidth, view.perspective);
+            tessellateMs.push_back(rasterizer.stats().tessellateMs);
+            setupMs.push_back(rasterizer.stats().setupMs);
+            rasterMs.push_back(rasterizer.stats().rasterMs);
+        }
+        images[m] = rasterizer.pixels();
+        if(m == 0) {
+            r.triangles = rasterizer.stats().triangles;
+            r.fragments = rasterizer.stats().fragments;
+            r.tessellateMs = ofxGpuThicklinesStats::summarize(tessellateMs);
+            r.setupMs = ofxGpuThicklinesStats::summarize(setupMs);
+            r.rasterMs = ofxGpuThicklinesStats::summarize(rasterMs);
+        }
+    }
+    r.modesMatch = ofxGpuThicklinesRasterizer::compare(images[0], images[1]).pixels == 0;
+
+    const string name = referenceSceneName(s);
+    const string golden = ofToDataPath("reference/" + name + ".png");
+    if(m_record) {
+        ofDirectory::createDirectory(ofToDataPath("reference"), false, true);
+        ofSaveImage(images[0], golden);
+        r.golden = "recorded";
+    }
+    else if(ofFile::doesFileExist(golden)) {
+        ofPixels expected;
+        ofLoadImage(expected, golden);
+        ofxGpuThicklinesRasterizer::Difference d = ofxGpuThicklinesRasterizer::compare(images[0], expected);
+        r.differingPixels = d.pixels;
+        r.maxDifference = d.maxDifference;
+        r.golden = d.pixels == 0 ? "match" : "mismatch";
+        if(d.pixels > 0)
+            ofSaveImage(images[0], ofToDataPath("reference/" + name + ".actual.png"));
+    }
+    else {
+        r.golden = "missing";
+    }
+    return r;
+}
+
+namespace {
+    // stands in for ofShader, without a GL context
+    struct MockProgram {
+        int build; // 1 for the first program built, and so on
+    };
+}
+
+benchmarkApp::ProgramsResult benchmarkApp::runPrograms() {
+    ofxGpuThicklinesPrograms::Registry<MockProgram, string> registry;
+    int builds = 0;
+    auto build = [&](MockProgram &program) { program.build = ++builds; };
+    // every key gets the same hash, as if they all collided
+    const string keys[] = { "", "#define EDGE_IDS\n", "#define JOIN_TANGENTS\n" };
+    const size_t numKeys = sizeof(keys) / sizeof(keys[0]);
+    vector< shared_ptr<MockProgram> > held;
+    for(int round=0; round<2; ++round) {
+        for(const string &key : keys)
+            held.push_back(registry.get(0, key, build));
+    }
+
+    ProgramsResult r = ProgramsResult();
+    r.programs = registry.size();
+    r.builds = registry.builds();
+    r.shared = r.separated = true;
+    for(size_t i=0; i<numKeys; ++i) {
+        r.shared = r.shared && held[i] == held[numKeys + i];
+        for(size_t j=0; j<i; ++j)
+            r.separated = r.separated && held[i] != held[j];
+    }
+    r.separated = r.separated && r.programs == numKeys && r.builds == numKeys;
+    held.clear();
+    r.rebuilt = registry.get(0, keys[0], build)->build == int(numKeys) + 1;
+    return r;
+}
+
+namespace {
+    // the protected conversions `endUpdates()` and `setup()` upload with
+    struct PackedLines : public ofxGpuThicklines {
+        using ofxGpuThicklines::packPositions;
+        using ofxGpuThicklines::packColors;
+        using ofxGpuThicklines::packTexcoords;
+        using ofxGpuThicklines::m_positionRange;
+    };
+
+    // `decoded` against `expected`, which should be at most `bound` apart, up to the rounding of
+    // floats as large as `magnitude`: the values themselves, and the bounds UNORM16 is spread over
+    void checkQuantized(float decoded, float expected, float bound, float magnitude, float &error, size_t &violations) {
+        const float difference = std::abs(decoded - expected);
+        const float rounding = 2 * std::numeric_limits<float>::epsilon()
+            * (magnitude + std::max(std::abs(decoded), std::abs(expected)));
+        error = std::max(error, difference);
+        if(difference > bound + rounding)
+            ++violations;
+    }
+}
+
+namespace {
+    // relative, with an absolute floor of 1 for the values near 0. Non-finite values only match
+    // each other: segments of zero length give NaN normals in both expansions.
+    float expansionError(ofxGpuThicklinesMath::Vec2 a, ofVec2f b) {
+        const float d[2][2] = { { a.x, b.x }, { a.y, b.y } };
+        float error = 0;
+        for(int k=0; k<2; ++k) {
+            const bool finite = std::isfinite(d[k][0]), expected = std::isfinite(d[k][1]);
+            if(! finite || ! expected) {
+                if(finite != expected)
+                    return std::numeric_limits<float>::infinity();
+                continue;
+            }
+            error = std::max(error, std::abs(d[k][0] - d[k][1]) / std::max(1.0f, std::abs(d[k][1])));
+        }
+        return error;
+    }
+}
+
+benchmarkApp::ExpansionResult benchmarkApp::runExpansion(ReferenceScene s, ofxGpuThicklines::IndexMode mode) {
+    ExpansionResult r = ExpansionResult();
+    r.scene = s;
+    r.indexMode = mode;
+    Scene scene;
+    ReferenceView view;
+    referenceScene(s, scene, view);
+    ofxGpuThicklines lines;
+    lines.setRenderBackend(ofxGpuThicklines::BACKEND_NONE);
+    lines.setIndexMode(mode);
+    lines.setup(scene.positions, scene.colors, scene.curves);
+    const ofVec2f viewportSize(referenceWidth, referenceHeight);
+    ofxGpuThicklinesTessellator tessellator;
+    ofxGpuThicklinesTessellator::Output out;
+    tessellator.tessellate(lines, view.modelViewProjection, viewportSize, view.lineWidth, view.perspective, out);
+
+    ofxGpuThicklinesMath::Params params;
+    params.thickness = view.lineWidth;
+    params.perspective = view.perspective;
+    params.viewportSize = ofxGpuThicklinesMath::Vec2(viewportSize.x, viewportSize.y);
+    // the tessellator emits the segments in the order of their windows of 4 indices: the corner
+    // triangle where there is one, then the quad as 4 vertices, which corners 3..8 of the
+    // instanced backend run through as two triangles
+    static const int quadVertex[6] = { 0, 1, 2, 2, 1, 3 };
+    const ofxGpuThicklinesTessellator::Input in = ofxGpuThicklinesTessellator::input(lines);
+    const bool strip = mode == ofxGpuThicklines::INDEX_LINE_STRIP_ADJACENCY;
+    const size_t windows = in.numIndices < 4 ? 0 : (strip ? in.numIndices - 3 : in.numIndices / 4);
+    size_t next = 0;
+    for(size_t k=0; k<windows; ++k) {
+        const unsigned int *w = in.indices + k * (strip ? 1 : 4);
+        if(std::find(w, w + 4, 0xffffffffu) != w + 4) continue;
+        ofxGpuThicklinesMath::SegmentInput segment;
+        for(int j=0; j<4; ++j)
+            segment.clip[j] = ofxGpuThicklinesMath::toClip(view.modelViewProjection, in.positions[w[j]]);
+        segment.color[0] = in.colors[w[1]];
+        segment.color[1] = in.colors[w[2]];
+        const ofxGpuThicklinesMath::SegmentFrame frame = ofxGpuThicklinesMath::segmentFrame(segment, params);
+        ++r.segments;
+
+        ofxGpuThicklinesMath::OutputVertex v;
+        const size_t quad = next + (frame.capStart ? 3 : 0);
+        if(quad + 4 > out.vertices.size()) {
+            ++r.mismatches;
+            break;
+        }
+        for(int corner=0; corner<ofxGpuThicklinesMath::verticesPerSegment; ++corner) {
+            if(! ofxGpuThicklinesMath::segmentVertex(frame, segment, params, corner, v)) continue;
+            const ofxGpuThicklinesTessellator::Vertex &t = out.vertices[corner < 3 ? next + corner : quad + quadVertex[corner - 3]];
+            const float error = std::max(expansionError(v.position, t.position), expansionError(v.localTexCoord, t.localTexCoord));
+            ++r.vertices;
+            r.maxError = std::max(r.maxError, error);
+            if(error > expansionTolerance) {
+                if(r.mismatches < 10)
+                    ofLogError("benchmark") << "expansion of " << referenceSceneName(s) << " " << indexModeName(mode)
+                                            << ": segment " << r.segments - 1 << " corner " << corner << " at "
+                                            << v.position.x << ", " << v.position.y << " instead of " << t.position;
+                ++r.mismatches;
+            }
+        }
+        next = quad + 4;
+    }
+    if(next != out.vertices.size())
+        ++r.mismatches; // the tessellator drew segments of its own
+    return r;
+}
+
+void benchmarkApp::runQuantization(ofxGpuThicklines::PositionFormat positionFormat) {
+    Scene scene;
+    generate(GENERATOR_POLYLINES, 100000, scene);
+    const size_t n = scene.positions.size();
+    vector<ofVec2f> texcoords(n);
+    for(size_t i=0; i<n; ++i) {
+        scene.colors[i] = ofVec4f(ofRandom(1), ofRandom(1), ofRandom(1), ofRandom(1));
+        texcoords[i] = ofVec2f(ofRandom(-4, 4), ofRandom(-4, 4));
+    }
+    PackedLines lines;
+    lines.setRenderBackend(ofxGpuThicklines::BACKEND_NONE);
+    lines.setVertexFormat(ofxGpuThicklines::VertexFormat(positionFormat, ofxGpuThicklines::COLORS_RGBA8,
+                                                         ofxGpuThicklines::TEXCOORDS_HALF));
+    lines.setup(scene.positions, scene.colors, texcoords, scene.curves);
+
+    for(int grown=0; grown<2; ++grown) {
+        if(grown) {
+            // a few vertices far outside the bounds, which POSITIONS_UNORM16 has to grow for
+            for(size_t i=0; i<n; i+=n/16)
+                lines.updatePosition(i, lines.positions()[i] * 3 + ofVec3f(100, -100, 50));
+            lines.endUpdates();
+        }
+        QuantizationResult r = QuantizationResult();
+        r.positions = positionFormat;
+        r.grown = grown != 0;
+        r.vertices = n;
+        r.bound = lines.quantizationError();
+        r.error.position = ofVec3f(0, 0, 0);
+
+        // each of these reuses the same scratch space
+        const uint16_t *p = static_cast<const uint16_t*>(lines.packPositions(0, n));
+        vector<uint16_t> packed(p, p + 4 * n);
+        const ofVec3f offset = lines.m_positionRange.min, scale = lines.m_positionRange.max - offset;
+        for(size_t i=0; i<n; ++i) {
+            for(int c=0; c<3; ++c) {
+                // as the shaders read them: half floats, or normalized and spread over the bounds
+                const uint16_t v = packed[4 * i + c];
+                const float decoded = positionFormat == ofxGpuThicklines::POSITIONS_HALF
+                    ? ofxGpuThicklinesQuantize::fromHalf(v) : offset[c] + scale[c] * (v / 65535.0f);
+                const float magnitude = positionFormat == ofxGpuThicklines::POSITIONS_HALF
+                    ? 0 : std::abs(offset[c]) + std::abs(scale[c]);
+                checkQuantized(decoded, lines.positions()[i][c], r.bound.position[c], magnitude, r.error.position[c],
+                               r.violations);
+            }
+        }
+        const uint8_t *colors = static_cast<const uint8_t*>(lines.packColors(0, n));
+        for(size_t i=0; i<4 * n; ++i)
+            checkQuantized(colors[i] / 255.0f, (&lines.colors()[0].x)[i], r.bound.color, 0, r.error.color, r.violations);
+        const uint16_t *t = static_cast<const uint16_t*>(lines.packTexcoords(0, n));
+        for(size_t i=0; i<2 * n; ++i) {
+            checkQuantized(ofxGpuThicklinesQuantize::fromHalf(t[i]), (&lines.texcoords()[0].x)[i], r.bound.texcoord, 0,
+                           r.error.texcoord, r.violations);
+        }
+        m_quantizationResults.push_back(r);
+    }
+}
+
+void benchmarkApp::finish(){
+    std::ofstream file(ofToDataPath(m_outputPath).c_str());
+    writeJson(file);
+    ofLogNotice("benchmark") << "wrote " << ofToDataPath(m_outputPath);
+    writeJson(std::cout);
+    ofExit(m_failed ? 1 : 0);
+}
+
+const char *benchmarkApp::generatorName(Generator g) {
+    switch(g) {
+        case GENERATOR_RANDOM_CURVES: return "randomCurves";
+        case GENERATOR_POLYLINES: return "polylines";
+        case GENERATOR_GRID: return "grid";
+        case GENERATOR_SPHERE: return "sphere";
+    }
+    return "";
+}
+
+const char *benchmarkApp::referenceSceneName(ReferenceScene s) {
+    switch(s) {
+        case REFERENCE_EXAMPLE: return "example";
+        case REFERENCE_SPHERE: return "sphere";
+        case REFERENCE_MITERS: return "miters";
+    }
+    return "";
+}
+
+const char *benchmarkApp::indexModeName(ofxGpuThicklines::IndexMode mode) {
+    switch(mode) {
+        case ofxGpuThicklines::INDEX_LINES_ADJACENCY: return "linesAdjacency";
+        case ofxGpuThicklines::INDEX_LINE_STRIP_ADJACENCY: return "lineStripAdjacency";
+        case ofxGpuThicklines::INDEX_LINES: return "lines";
+    }
+    return "";
+}
+
+const char *benchmarkApp::layoutName(ofxGpuThicklines::VertexLayout layout) {
+    switch(layout) {
+        case ofxGpuThicklines::LAYOUT_SPLIT: return "split";
+        case ofxGpuThicklines::LAYOUT_INTERLEAVED: return "interleaved";
+    }
+    return "";
+}
+
+// about `segments` segments of generator `g`, the same every time
+void benchmarkApp::generate(Generator g, size_t segments, Scene &scene) {
+    ofSeedRandom(1);
+    if(g == GENERATOR_RANDOM_CURVES) {
+        size_t c = std::max(size_t(16), segments / 4);
+        scene.positions.resize(c);
+        for(size_t i=0; i<c; ++i)
+            scene.positions[i] = ofVec3f(ofRandom(1000), ofRandom(1000), ofRandom(-150,150));
+        for(size_t s=0; s<segments;) {
+            vector<size_t> curve(size_t(ofRandom(3,7)));
+            for(size_t &k : curve)
+                k = size_t(ofRandom(c)) % c;
+            s += curve.size() - 1;
+            scene.curves.push_back(std::move(curve));
+        }
+    }
+    else if(g == GENERATOR_POLYLINES) {
+        size_t points = std::min(polylinePoints, segments + 1);
+        size_t numCurves = segments / (points - 1);
+        scene.positions.reserve(numCurves * points);
+        for(size_t i=0; i<numCurves; ++i) {
+            vector<size_t> curve(points);
+            ofVec3f p(ofRandom(1000), ofRandom(1000), 0);
+            for(size_t &k : curve) {
+                p += ofVec3f(ofRandom(-1,1), ofRandom(-1,1), ofRandom(-1,1));
+                k = scene.positions.size();
+                scene.positions.push_back(p);
+            }
+            scene.curves.push_back(std::move(curve));
+        }
+    }
+    else if(g == GENERATOR_GRID) {
+        // about 3 edges per vertex
+        int n = std::max(2, int(std::sqrt(segments / 3.0)));
+        scene.mesh = ofMesh::plane(1000, 1000, n, n);
+    }
+    else {
+        // about 2 res^2 vertices with 3 edges each
+        int res = std::max(4, int(std::sqrt(segments / 6.0)));
+        scene.mesh = ofMesh::sphere(500, res);
+    }
+    scene.colors.assign(scene.positions.size(), ofVec4f(1,1,1,1));
+}
+
+benchmarkApp::Result benchmarkApp::run(Generator g, ofxGpuThicklines::IndexMode mode, ofxGpuThicklines::VertexLayout layout,
+                                       size_t segments) {
+    Result r = Result();
+    r.generator = g;
+    r.indexMode = mode;
+    r.layout = layout;
+
+    Scene scene;
+    generate(g, segments, scene);
+    ofxGpuThicklines lines;
+    lines.setRenderBackend(ofxGpuThicklines::BACKEND_NONE);
+    lines.setIndexMode(mode);
+    lines.setVertexLayout(layout);
+
+    // the data for `reset()`, prepared outside of the timings
+    vector<ofVec3f> positions;
+    vector<ofVec4f> colors;
+    vector<ofVec2f> texcoords;
+    vector< vector<size_t> > curves;
+
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    if(g == GENERATOR_GRID || g == GENERATOR_SPHERE) {
+        lines.setup(scene.mesh);
+        r.setupMs = millisecondsSince(t0);
+        r.decompositionMs = lines.decompositionStats().milliseconds;
+        positions = scene.mesh.getVertices();
+        colors.assign(positions.size(), ofVec4f(1,1,1,1));
+        texcoords = scene.mesh.getTexCoords();
+        curves = ofxGpuThicklines::meshToCurves(scene.mesh);
+        scene.mesh.clear();
+    }
+    else {
+        positions = scene.positions;
+        colors = scene.colors;
+        curves = scene.curves;
+        t0 = ofGetElapsedTimeMicros();
+        lines.setup(std::move(scene.positions), std::move(scene.colors), std::move(scene.curves));
+        r.setupMs = millisecondsSince(t0);
+    }
+    for(const vector<size_t> &curve : curves)
+        r.segments += curve.size() > 1 ? curve.size() - 1 : 0;
+    r.curves = curves.size();
+
+    t0 = ofGetElapsedTimeMicros();
+    lines.reset(std::move(positions), std::move(colors), std::move(texcoords), std::move(curves));
+    r.resetMs = millisecondsSince(t0);
+    r.vertices = lines.positions().size();
+    r.indices = lines.numIndices();
+    r.peakLoadBytes = lines.peakLoadBytes();
+
+    r.sparseUpdateMs = updateFrames(lines, 100, r.sparseUpdateBytes);
+    r.fullUpdateMs = updateFrames(lines, 1, r.fullUpdateBytes);
+    r.cpuMemoryBytes = lines.cpuMemoryBytes();
+    r.processPeakBytes = processPeakBytes();
+    return r;
+}
+
+// moves every `step`-th vertex a bit, returns the average time of a frame
+float benchmarkApp::updateFrames(ofxGpuThicklines &lines, size_t step, size_t &bytes) {
+    const size_t n = lines.positions().size();
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    for(int frame=0; frame<updateFramesPerCase; ++frame) {
+        ofVec3f offset(0, 0, frame % 2 == 0 ? 1 : -1);
+        lines.beginUpdates();
+        for(size_t i=0; i<n; i+=step)
+            lines.updatePosition(i, lines.positions()[i] + offset);
+        lines.endUpdates();
+    }
+    bytes = lines.bytesUploaded();
+    return millisecondsSince(t0) / updateFramesPerCase;
+}
+
+void benchmarkApp::writeJson(ostream &out) const {
+    out << "{\n";
+    out << "  \"date\": \"" << ofGetTimestampString("%Y-%m-%d %H:%M:%S") << "\",\n";
+    out << "  \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"maxSegments\": " << m_maxSegments << ",\n";
+    out << "  \"gpu\": " << (m_gpu ? "true" : "false") << ",\n";
+    out << "  \"results\": [";
+    for(size_t i=0; i<m_results.size(); ++i) {
+        const Result &r = m_results[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"generator\": \"" << generatorName(r.generator) << "\""
+            << ", \"indexMode\": \"" << indexModeName(r.indexMode) << "\""
+            << ", \"layout\": \"" << layoutName(r.layout) << "\""
+            << ", \"segments\": " << r.segments
+            << ", \"vertices\": " << r.vertices
+            << ", \"curves\": " << r.curves
+            << ", \"indices\": " << r.indices
+            << ", \"setupMs\": " << r.setupMs
+            << ", \"decompositionMs\": " << r.decompositionMs
+            << ", \"resetMs\": " << r.resetMs
+            << ", \"sparseUpdateMs\": " << r.sparseUpdateMs
+            << ", \"sparseUpdateBytes\": " << r.sparseUpdateBytes
+            << ", \"fullUpdateMs\": " << r.fullUpdateMs
+            << ", \"fullUpdateBytes\": " << r.fullUpdateBytes
+            << ", \"cpuMemoryBytes\": " << r.cpuMemoryBytes
+            << ", \"peakLoadBytes\": " << r.peakLoadBytes
+            << ", \"processPeakBytes\": " << r.processPeakBytes << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"gpuResults\": [";
+    for(size_t i=0; i<m_gpuResults.size(); ++i) {
+        const GpuResult &r = m_gpuResults[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"generator\": \"" << generatorName(r.generator) << "\""
+            << ", \"indexMode\": \"" << indexModeName(r.indexMode) << "\""
+            << ", \"layout\": \"" << layoutName(r.layout) << "\""
+            << ", \"segments\": " << r.segments
+            << ", \"vertices\": " << r.vertices
+            << ", \"gpuFrames\": " << r.gpuFrames
+            << ", \"drawMs\": " << r.drawMs.avg
+            << ", \"drawMsP99\": " << r.drawMs.p99
+            << ", \"gpuMs\": " << r.gpuMs.avg
+            << ", \"gpuMsP99\": " << r.gpuMs.p99
+            << ", \"differingPixels\": " << r.differingPixels << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"handoffResults\": [";
+    for(size_t i=0; i<m_handoffResults.size(); ++i) {
+        const HandoffResult &r = m_handoffResults[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"vertices\": " << r.vertices
+            << ", \"published\": " << r.published
+            << ", \"pulled\": " << r.pulled
+            << ", \"errors\": " << r.errors
+            << ", \"ms\": " << r.ms
+            << ", \"pullMs\": " << r.pullMs << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"pickingResults\": [";
+    for(size_t i=0; i<m_pickingResults.size(); ++i) {
+        const PickingResult &r = m_pickingResults[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"generator\": \"" << generatorName(r.generator) << "\""
+            << ", \"segments\": " << r.segments
+            << ", \"cells\": " << r.cells
+            << ", \"picks\": " << r.picks
+            << ", \"errors\": " << r.errors
+            << ", \"pickMs\": " << r.pickMs.avg
+            << ", \"pickMsP99\": " << r.pickMs.p99
+            << ", \"rebuildMs\": " << r.rebuildMs.avg
+            << ", \"scanMs\": " << r.scanMs.avg << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"referenceResults\": [";
+    for(size_t i=0; i<m_referenceResults.size(); ++i) {
+        const ReferenceResult &r = m_referenceResults[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"scene\": \"" << referenceSceneName(r.scene) << "\""
+            << ", \"width\": " << r.width
+            << ", \"height\": " << r.height
+            << ", \"segments\": " << r.segments
+            << ", \"triangles\": " << r.triangles
+            << ", \"fragments\": " << r.fragments
+            << ", \"tessellateMs\": " << r.tessellateMs.avg
+            << ", \"setupMs\": " << r.setupMs.avg
+            << ", \"rasterMs\": " << r.rasterMs.avg
+            << ", \"rasterMsMin\": " << r.rasterMs.min
+            << ", \"modesMatch\": " << (r.modesMatch ? "true" : "false")
+            << ", \"golden\": \"" << r.golden << "\""
+            << ", \"differingPixels\": " << r.differingPixels
+            << ", \"maxDifference\": " << r.maxDifference << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"programsResults\": [";
+    for(size_t i=0; i<m_programsResults.size(); ++i) {
+        const ProgramsResult &r = m_programsResults[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"programs\": " << r.programs
+            << ", \"builds\": " << r.builds
+            << ", \"shared\": " << (r.shared ? "true" : "false")
+            << ", \"separated\": " << (r.separated ? "true" : "false")
+            << ", \"rebuilt\": " << (r.rebuilt ? "true" : "false") << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"expansionResults\": [";
+    for(size_t i=0; i<m_expansionResults.size(); ++i) {
+        const ExpansionResult &r = m_expansionResults[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"scene\": \"" << referenceSceneName(r.scene) << "\""
+            << ", \"indexMode\": \"" << indexModeName(r.indexMode) << "\""
+            << ", \"segments\": " << r.segments
+            << ", \"vertices\": " << r.vertices
+            << ", \"maxError\": " << r.maxError
+            << ", \"mismatches\": " << r.mismatches << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"quantizationResults\": [";
+    for(size_t i=0; i<m_quantizationResults.size(); ++i) {
+        const QuantizationResult &r = m_quantizationResults[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"positions\": \"" << (r.positions == ofxGpuThicklines::POSITIONS_HALF ? "half" : "unorm16") << "\""
+            << ", \"grown\": " << (r.grown ? "true" : "false")
+            << ", \"vertices\": " << r.vertices
+            << ", \"positionError\": [" << r.error.position.x << ", " << r.error.position.y << ", " << r.error.position.z << "]"
+            << ", \"positionBound\": [" << r.bound.position.x << ", " << r.bound.position.y << ", " << r.bound.position.z << "]"
+            << ", \"colorError\": " << r.error.color
+            << ", \"colorBound\": " << r.bound.color
+            << ", \"texcoordError\": " << r.error.texcoord
+            << ", \"texcoordBound\": " << r.bound.texcoord
+            << ", \"violations\": " << r.violations << "}";
+    }
+    out << "\n  ]\n}\n";
+}
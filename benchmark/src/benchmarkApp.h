@@ -0,0 +1,225 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxGpuThicklines.h"
+#include "ofxGpuThicklinesRasterizer.h"
+
+// times the CPU side of ofxGpuThicklines on synthetic data, without a window or GPU:
+// the lines use BACKEND_NONE, which skips every GL call but counts the bytes that would be uploaded.
+//
+// for every generator, index mode, vertex layout and size (1k segments, then 10x up to
+// `m_maxSegments`) one case is run: `setup()` (with the mesh decomposition for the mesh
+// generators), a second `reset()` with the same data, and frames of `endUpdates()` that move a
+// few or all of the vertices.
+// the results go to `m_outputPath` as JSON, one object per case, to be kept per commit.
+//
+// with `m_gpu` the same scenes are drawn instead, in a window with the geometry shader backend,
+// to compare what the vertex layouts do to the GPU time of `draw()`. The last frame of every
+// interleaved case has to match that of the split case before it pixel for pixel, or the app
+// exits with 1: a layout that draws something else has no timings worth comparing.
+//
+// with `m_handoff` a worker thread publishes frames through a Producer as fast as it can while
+// the main thread pulls them as fast as it can, and every state pulled is checked against a
+// replay of the frames up to it: no frame may arrive torn, out of order, or with changes missing,
+// or the app exits with 1.
+//
+// with `m_picking` the vertices of random curves and polylines move while points are picked under
+// a fixed camera, then the camera moves, and every pick is checked against a linear scan over the
+// projected segments. The picks are timed next to the scan, and so are the picks that rebuild the whole grid
+// for a new camera.
+//
+// with `m_reference` scenes like the example are drawn by ofxGpuThicklinesRasterizer on the CPU and
+// compared with the golden images in `bin/data/reference/`, byte for byte. The scenes don't depend
+// on how openFrameworks draws random numbers or builds meshes and matrices, so that the same images
+// are expected everywhere. Mismatches are saved next to the golden image as `<scene>.actual.png`,
+// and they and missing golden images make the app exit with 1. With `m_record` the images drawn
+// replace the golden images instead, for when the rendering changes on purpose. The rasterizer is
+// timed too, so that the same run catches slowdowns.
+//
+// with `m_checks` the parts that need neither a GPU nor timings are checked, and any failure makes
+// the app exit with 1:
+// - the registry sharing shader programs has to tell apart keys whose hashes collide, with a mock
+//   program type in place of ofShader.
+// - `ofxGpuThicklinesMath::segmentVertex()`, the vertex shader math of the instanced backend, has
+//   to expand the reference scenes into the same vertices as ofxGpuThicklinesTessellator, which
+//   the golden images are drawn with, so that it can't drift from the geometry shader.
+// - the compact vertex formats have to stay within `quantizationError()`: the bytes uploaded are
+//   decoded as the shaders decode them and compared with the float vertices, after `setup()` and
+//   again after `endUpdates()` grew the bounds of POSITIONS_UNORM16.
+class benchmarkApp : public ofBaseApp{
+public:
+    benchmarkApp() : m_maxSegments(10000000), m_outputPath("benchmark.json"), m_gpu(false), m_handoff(false),
+                     m_picking(false), m_reference(false), m_record(false), m_checks(false),
+                     m_failed(false), m_gpuCase(0), m_gpuFrame(0) { ; }
+
+    void setup();
+    void draw();
+
+    size_t m_maxSegments;
+    string m_outputPath;
+    bool m_gpu;
+    bool m_handoff;
+    bool m_picking;
+    bool m_reference;
+    bool m_record;
+    bool m_checks;
+
+protected:
+    enum Generator {
+        GENERATOR_RANDOM_CURVES, // short curves between random points, like the example
+        GENERATOR_POLYLINES,     // random walks of 10000 points
+        GENERATOR_GRID,          // wireframe of ofMesh::plane()
+        GENERATOR_SPHERE         // wireframe of ofMesh::sphere()
+    };
+    static const int numGenerators = 4;
+    static const char *generatorName(Generator g);
+    static const char *indexModeName(ofxGpuThicklines::IndexMode mode);
+    static const char *layoutName(ofxGpuThicklines::VertexLayout layout);
+
+    struct Scene {
+        vector<ofVec3f> positions;
+        vector<ofVec4f> colors;
+        vector< vector<size_t> > curves;
+        ofMesh mesh; // for the mesh generators, instead of the above
+    };
+    static void generate(Generator g, size_t segments, Scene &scene);
+
+    struct Result {
+        Generator generator;
+        ofxGpuThicklines::IndexMode indexMode;
+        ofxGpuThicklines::VertexLayout layout;
+        size_t segments;
+        size_t vertices;
+        size_t curves;
+        size_t indices;
+        float setupMs;
+        float decompositionMs; // part of setupMs, mesh generators only
+        float resetMs;
+        float sparseUpdateMs;  // one frame moving 1% of the vertices
+        size_t sparseUpdateBytes;
+        float fullUpdateMs;    // one frame moving all vertices
+        size_t fullUpdateBytes;
+        size_t cpuMemoryBytes;
+        size_t peakLoadBytes;
+        size_t processPeakBytes; // of the whole run so far
+    };
+    Result run(Generator g, ofxGpuThicklines::IndexMode mode, ofxGpuThicklines::VertexLayout layout, size_t segments);
+    float updateFrames(ofxGpuThicklines &lines, size_t step, size_t &bytes);
+
+    // the GPU cases, one per frame range of `draw()`
+    struct GpuResult {
+        Generator generator;
+        ofxGpuThicklines::IndexMode indexMode;
+        ofxGpuThicklines::VertexLayout layout;
+        size_t segments; // asked for, then the ones drawn
+        size_t vertices;
+        size_t gpuFrames; // frames whose GPU time came back
+        ofxGpuThicklinesStats::Summary drawMs, gpuMs;
+        size_t differingPixels; // from the split layout, for the interleaved one
+    };
+    void startGpuCase(GpuResult &r);
+
+    struct HandoffResult {
+        size_t vertices;
+        uint64_t published;
+        uint64_t pulled;
+        size_t errors; // states pulled that match no frame, and a last frame that never arrived
+        float ms;
+        float pullMs; // average of `pullUpdates()` when it got a frame
+    };
+    HandoffResult runHandoff(size_t vertices, uint64_t frames);
+    static void handoffFrame(uint64_t frame, size_t vertices, vector<size_t> &changed);
+
+    struct PickingResult {
+        Generator generator; // random curves or polylines
+        size_t segments;
+        size_t cells;  // of the grid
+        size_t picks;
+        size_t errors; // picks that disagree with the linear scan
+        ofxGpuThicklinesStats::Summary pickMs;    // picks that kept the grid
+        ofxGpuThicklinesStats::Summary rebuildMs; // picks that built it anew, for a new camera
+        ofxGpuThicklinesStats::Summary scanMs;    // the linear scan, per pick
+    };
+    PickingResult runPicking(Generator g, size_t segments);
+
+    enum ReferenceScene {
+        REFERENCE_EXAMPLE, // the curves of the example, screen blended through a perspective camera
+        REFERENCE_SPHERE,  // thick wireframe of ofMesh::sphere()
+        REFERENCE_MITERS   // zigzags turning sharper and sharper, across the MITER_LIMIT branch
+    };
+    static const int numReferenceScenes = 3;
+    static const char *referenceSceneName(ReferenceScene s);
+
+    struct ReferenceView {
+        ofMatrix4x4 modelViewProjection;
+        float lineWidth;
+        bool perspective;
+        ofFloatColor globalColor;
+        ofBlendMode blendMode;
+    };
+    // of `referenceWidth` x `referenceHeight` pixels, the same on every platform
+    static void referenceScene(ReferenceScene s, Scene &scene, ReferenceView &view);
+
+    struct ReferenceResult {
+        ReferenceScene scene;
+        size_t width, height;
+        size_t segments;
+        size_t triangles;
+        size_t fragments;
+        ofxGpuThicklinesStats::Summary tessellateMs, setupMs, rasterMs;
+        bool modesMatch;        // the strip adjacency mode drew the same image
+        string golden;          // "match", "mismatch", "missing" or "recorded"
+        size_t differingPixels; // from the golden image
+        int maxDifference;
+    };
+    ReferenceResult runReference(ReferenceScene s);
+
+    struct ProgramsResult {
+        size_t programs;  // held after asking for every key twice
+        size_t builds;
+        bool shared;      // asking again for a key gave the same program
+        bool separated;   // keys with the same hash got programs of their own
+        bool rebuilt;     // a key was built again after its program was let go
+        bool passed() const { return shared && separated && rebuilt; }
+    };
+    ProgramsResult runPrograms();
+
+    // `ofxGpuThicklinesMath::segmentVertex()`, the vertex shader of the instanced backend on the
+    // CPU, against the output of ofxGpuThicklinesTessellator for the reference scenes
+    struct ExpansionResult {
+        ReferenceScene scene;
+        ofxGpuThicklines::IndexMode indexMode;
+        size_t segments;
+        size_t vertices;   // compared, the corner triangles that collapse are left out
+        float maxError;    // relative, of the positions in normalized device coordinates and the localTexCoords
+        size_t mismatches; // vertices beyond the tolerance
+    };
+    ExpansionResult runExpansion(ReferenceScene s, ofxGpuThicklines::IndexMode mode);
+
+    struct QuantizationResult {
+        ofxGpuThicklines::PositionFormat positions; // with COLORS_RGBA8 and TEXCOORDS_HALF
+        bool grown;       // checked after `endUpdates()` moved vertices outside the bounds
+        size_t vertices;
+        ofxGpuThicklines::QuantizationError bound, error; // promised by `quantizationError()`, and found
+        size_t violations; // values further off than the bound, up to float rounding
+    };
+    void runQuantization(ofxGpuThicklines::PositionFormat positions);
+
+    void finish(); // writes the results and quits
+    void writeJson(ostream &out) const;
+
+    vector<Result> m_results;
+    vector<GpuResult> m_gpuResults;
+    vector<HandoffResult> m_handoffResults;
+    vector<PickingResult> m_pickingResults;
+    vector<ReferenceResult> m_referenceResults;
+    vector<ProgramsResult> m_programsResults;
+    vector<ExpansionResult> m_expansionResults;
+    vector<QuantizationResult> m_quantizationResults;
+    bool m_failed; // exit with 1
+    size_t m_gpuCase; // the one being drawn
+    int m_gpuFrame;   // of the case being drawn
+    ofxGpuThicklines m_gpuLines;
+    ofPixels m_gpuSplitPixels; // the last frame of the split case, for the interleaved one after it
+    ofCamera m_cam;
+};
@@ -0,0 +1,79 @@
+#include "benchmarkApp.h"
+#include "ofAppNoWindow.h"
+#include "ofAppGLFWWindow.h"
+
+// like ofConsoleLoggerChannel, but all on stderr: stdout gets the JSON results and nothing else
+class stderrLoggerChannel : public ofBaseLoggerChannel {
+public:
+    void log(ofLogLevel level, const string &module, const string &message) {
+        fprintf(stderr, "[%s] %s%s%s\n", ofGetLogLevelName(level, true).c_str(), module.c_str(),
+                module.empty() ? "" : ": ", message.c_str());
+    }
+    void log(ofLogLevel level, const string &module, const char *format, ...) {
+        va_list args;
+        va_start(args, format);
+        log(level, module, format, args);
+        va_end(args);
+    }
+    void log(ofLogLevel level, const string &module, const char *format, va_list args) {
+        log(level, module, ofVAArgsToString(format, args));
+    }
+};
+
+//--------------------------------------------------------------
+// usage: benchmark [--gpu | --handoff | --picking | --reference [--record] | --checks] [maxSegments] [output.json]
+// the output path is relative to bin/data unless it is absolute. The results are also printed on
+// stdout, the log goes to stderr.
+// --gpu draws the scenes in a window to time the GPU, instead of timing the CPU side headless.
+// --handoff stress tests the handoff of updates from a worker thread instead.
+// --picking checks picks on moving vertices against a linear scan, and times both.
+// --reference draws scenes on the CPU and compares them with the golden images in bin/data/reference.
+// --record replaces the golden images with the images drawn, after a deliberate change of the rendering.
+// --checks checks the sharing of shader programs, the precision of the compact vertex formats and
+// the vertex math of the instanced backend against the tessellator on the reference scenes.
+int main(int argc, char *argv[]){
+    ofSetLoggerChannel(std::make_shared<stderrLoggerChannel>());
+    benchmarkApp *app = new benchmarkApp();
+    int arg = 1;
+    if(argc > arg && string(argv[arg]) == "--gpu") {
+        app->m_gpu = true;
+        ++arg;
+    }
+    else if(argc > arg && string(argv[arg]) == "--handoff") {
+        app->m_handoff = true;
+        ++arg;
+    }
+    else if(argc > arg && string(argv[arg]) == "--picking") {
+        app->m_picking = true;
+        ++arg;
+    }
+    else if(argc > arg && string(argv[arg]) == "--reference") {
+        app->m_reference = true;
+        ++arg;
+        if(argc > arg && string(argv[arg]) == "--record") {
+            app->m_record = true;
+            ++arg;
+        }
+    }
+    else if(argc > arg && string(argv[arg]) == "--checks") {
+        app->m_checks = true;
+        ++arg;
+    }
+    if(argc > arg)
+        app->m_maxSegments = ofToInt64(argv[arg]);
+    if(argc > arg + 1)
+        app->m_outputPath = argv[arg + 1];
+
+    if(app->m_gpu) {
+        ofGLWindowSettings settings;
+        settings.width = 1280;
+        settings.height = 960;
+        settings.windowMode = OF_WINDOW;
+        settings.setGLVersion(3,2);
+        ofCreateWindow(settings);
+    }
+    else {
+        ofSetupOpenGL(new ofAppNoWindow(), 1024, 768, OF_WINDOW); // no window, no GL context
+    }
+    ofRunApp(app);
+}
@@ -1,13 +1,103 @@
 #include "ofxGpuThicklines.h"
+#include "ofxGpuThicklinesMath.h"
+#include "ofxGpuThicklinesParallel.h"
+#include "ofxGpuThicklinesCache.h"
+#include "ofxGpuThicklinesPrograms.h"
 #include <cassert>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 
-void ofxGpuThicklines::setup(vector<ofVec3f> positions,
-                             vector<ofVec4f> colors,
-                             vector<ofVec2f> texcoords,
-                             vector< vector<size_t> > curves,
-                             string customFragShader) {
+namespace {
+    // inserts `defines` right after the `#version` line of a shader
+    string withDefines(const string &source, const string &defines) {
+        size_t eol = source.find('\n');
+        return source.substr(0, eol + 1) + defines + source.substr(eol + 1);
+    }
+}
+
+void ofxGpuThicklines::setupShader(string customFragShader) {
+    m_customFragShader = customFragShader;
+    m_shaderDefines = shaderDefines();
+    if(m_renderBackend == BACKEND_NONE)
+        return;
+    // timed by the callers, some call it from within the timing of a load
+    m_sharedShader = sharedShader(m_renderBackend, m_shaderDefines, customFragShader);
+    m_curvesShader = *m_sharedShader; // ofShader copies share the program
+
+    // the instanced backend has no per-vertex attributes, the buffers still go to the default slots
+    m_colorLocation = m_curvesShader.getAttributeLocation("color");
+    if(m_colorLocation < 0) m_colorLocation = ofShader::COLOR_ATTRIBUTE;
+    m_texcoordLocation = m_curvesShader.getAttributeLocation("texcoord");
+    if(m_texcoordLocation < 0) m_texcoordLocation = ofShader::TEXCOORD_ATTRIBUTE;
+    m_joinLocation = m_curvesShader.getAttributeLocation("join");
+    if(m_joinLocation < 0) m_joinLocation = ofShader::NORMAL_ATTRIBUTE;
+}
+
+string ofxGpuThicklines::shaderDefines() const {
+    string defines = "#define EDGE_IDS\n";
+    if(m_indexMode == INDEX_LINES)
+        defines += "#define JOIN_TANGENTS\n";
+    if(m_vertexFormat.positions != POSITIONS_FLOAT)
+        defines += "#define PACKED_POSITIONS\n";
+    if(m_vertexFormat.positions == POSITIONS_UNORM16)
+        defines += "#define UNORM_POSITIONS\n";
+    return defines;
+}
+
+void ofxGpuThicklines::loadShader(ofShader &shader, RenderBackend backend, const string &defines,
+                                  const string &customFragShader) {
     // curve shader
     {
+        // used by both backends in the INDEX_LINES mode, where each segment only knows its own two
+        // points: the directions of the neighbouring segments are found by mirroring v1 at the
+        // projected join tangent, which bisects the two segments meeting at a vertex.
+        string joinShaderFunctions = ("#ifdef JOIN_TANGENTS\n"
+                             "#define MITER_SCALE_LIMIT (1.0 / sqrt((1.0 - MITER_LIMIT) / 2.0))\n" // the miter scale at a turn of exactly MITER_LIMIT
+                             "\n"
+                             "vec2 join_neighbour(vec4 vertex, vec4 tangent, float miterScale, vec2 v1) {\n"
+                             "    if( miterScale <= 0.0 ) return v1;\n" // no join, continue straight
+                             "    vec2 t = normalize((tangent.xy * vertex.w - vertex.xy * tangent.w) * viewportSize);\n" // screen direction of the tangent
+                             "    float c = dot(t, v1);\n"
+                             "    return abs(c) > 0.1 ? 2.0 * c * t - v1 : v1;\n"
+                             "}\n"
+                             "#endif\n"
+                             "\n");
+
+        // the `edgeID` of a segment from its two vertices. With EDGE_IDS, its id in the table of
+        // `edgeTable()`: unique, stable and independent of the index buffer layout. Without (the
+        // batch and trail shaders), a hash of the pair.
+        // see ofxGpuThicklinesMath::edgeID() for a CPU version.
+        string edgeIdFunction = ("#ifdef EDGE_IDS\n"
+                             "uniform usamplerBuffer edgeTable;\n" // per vertex its first segment, then the larger vertex and the id of every segment
+                             "uniform int edgeTargets;\n" // where the larger vertices start
+                             "uniform int edgeIds;\n" // where the ids start
+                             "uniform int edgeIdBase;\n"
+                             "\n"
+                             "int edge_id(uint a, uint b) {\n"
+                             "    uint lo = min(a, b), hi = max(a, b);\n"
+                             "    int begin = int(texelFetch(edgeTable, int(lo)).r);\n"
+                             "    int end = int(texelFetch(edgeTable, int(lo) + 1).r);\n"
+                             "    int first = begin, last = end;\n"
+                             "    while( first < last ) {\n" // lower bound of hi among the segments of lo
+                             "        int mid = first + (last - first) / 2;\n"
+                             "        if( texelFetch(edgeTable, edgeTargets + mid).r < hi ) first = mid + 1;\n"
+                             "        else last = mid;\n"
+                             "    }\n"
+                             "    if( first == end || texelFetch(edgeTable, edgeTargets + first).r != hi ) return -1;\n" // no segment, e.g. simplified curves
+                             "    return edgeIdBase + int(texelFetch(edgeTable, edgeIds + first).r);\n"
+                             "}\n"
+                             "#else\n"
+                             "int edge_id(uint a, uint b) {\n"
+                             "    uint h = min(a, b) * 0x9e3779b1u + max(a, b);\n"
+                             "    h ^= h >> 16; h *= 0x7feb352du;\n"
+                             "    h ^= h >> 15; h *= 0x846ca68bu;\n"
+                             "    h ^= h >> 16;\n"
+                             "    return int(h & 0x7fffffffu);\n"
+                             "}\n"
+                             "#endif\n"
+                             "\n");
+
         string geomShader = ("#version 150 core\n"
                              "\n"
                              "uniform float thickness;\n" // the thickness of the line. if `perspective` is 0, the line width in pixels
@@ -19,8 +109,24 @@ void ofxGpuThicklines::setup(vector<ofVec3f> positions,
                              "in vec4 colorVarying[];\n"
                              "in vec2 texCoordVarying[];\n"
                              "in int vertexID[];\n"
+                             "#ifdef BATCH\n" // ofxGpuThicklinesBatch: the thickness of the object
+                             "in float objectThickness[];\n"
+                             "#define LINE_THICKNESS objectThickness[START]\n"
+                             "#else\n"
+                             "#define LINE_THICKNESS thickness\n"
+                             "#endif\n"
                              "\n"
+                             "#ifdef JOIN_TANGENTS\n" // GL_LINES, the joins come from per-vertex tangents
+                             "in vec4 joinTangent[];\n"
+                             "in float miterScale[];\n"
+                             "layout(lines) in;\n"
+                             "#define START 0\n"
+                             "#define END 1\n"
+                             "#else\n"
                              "layout(lines_adjacency) in;\n"
+                             "#define START 1\n"
+                             "#define END 2\n"
+                             "#endif\n"
                              "layout(triangle_strip, max_vertices = 7) out;\n"
                              "\n"
                              "\n" // end of next segment
@@ -34,8 +140,15 @@ void ofxGpuThicklines::setup(vector<ofVec3f> positions,
                              "    return vec2( vertex.xy / vertex.w ) * viewportSize;\n"
                              "}\n"
                              "\n"
+                             + joinShaderFunctions + edgeIdFunction +
                              "void main(void)\n"
                              "{\n"
+                             "#ifdef JOIN_TANGENTS\n"
+                             "    vec4 pos1 = gl_in[0].gl_Position;\n"
+                             "    vec4 pos2 = gl_in[1].gl_Position;\n"
+                             "    vec2 p1 = screen_space( pos1 );\n"
+                             "    vec2 p2 = screen_space( pos2 );\n"
+                             "#else\n"
                              "    \n" // get the four vertices passed to the shader:
                              "    vec4 pos0 = gl_in[0].gl_Position;\n"
                              "    vec4 pos1 = gl_in[1].gl_Position;\n"
@@ -46,20 +159,28 @@ void ofxGpuThicklines::setup(vector<ofVec3f> positions,
                              "    vec2 p1 = screen_space( pos1 );\n" // end of previous segment, start of current segment
                              "    vec2 p2 = screen_space( pos2 );\n" // end of current segment, start of next segment
                              "    vec2 p3 = screen_space( pos3 );\n" // end of next segment
+                             "#endif\n"
                              "\n"
-                             "    vec2 texCoord1 = texCoordVarying[1];\n"
-                             "    vec2 texCoord2 = texCoordVarying[2];\n"
+                             "    vec2 texCoord1 = texCoordVarying[START];\n"
+                             "    vec2 texCoord2 = texCoordVarying[END];\n"
                              "\n"
-                             // Cantor's pairing function.
-                             // might be possible to find a tighter mapping when assuming that the two vertex
-                             // ids are never equal.
-                             "    edgeID = ((vertexID[1] + vertexID[2]) * (vertexID[1] + vertexID[2] + 1) / 2 + vertexID[2]);\n"
+                             "    edgeID = edge_id(uint(vertexID[START]), uint(vertexID[END]));\n"
                              "    fedgeTexCoord = (texCoord1 + texCoord2) / 2.0;\n"
                              "\n"
                              // we estimate the scaling of the width by perspective is `perspective` == 1
-                             "    float thicknessA = thickness * (bool(perspective) ? (500.0 / pos1.w) : 1.0);\n" 
-                             "    float thicknessB = thickness * (bool(perspective) ? (500.0 / pos2.w) : 1.0);\n"
+                             "    float thicknessA = LINE_THICKNESS * (bool(perspective) ? (500.0 / pos1.w) : 1.0);\n" 
+                             "    float thicknessB = LINE_THICKNESS * (bool(perspective) ? (500.0 / pos2.w) : 1.0);\n"
                              "\n"
+                             "#ifdef JOIN_TANGENTS\n"
+                             "    vec2 v1 = normalize(p2-p1);\n"
+                             "    vec2 n1 = vec2(-v1.y, v1.x);\n"
+                             "    vec2 v0 = join_neighbour(pos1, joinTangent[START], miterScale[START], v1);\n"
+                             "    vec2 v2 = join_neighbour(pos2, joinTangent[END], miterScale[END], v1);\n"
+                             "    vec2 n0 = vec2(-v0.y, v0.x);\n"
+                             "    vec2 n2 = vec2(-v2.y, v2.x);\n"
+                             "    bool sharpStart = miterScale[START] > MITER_SCALE_LIMIT;\n"
+                             "    bool sharpEnd = miterScale[END] > MITER_SCALE_LIMIT;\n"
+                             "#else\n"
                              "    \n" // determine the direction of each of the 3 segments (previous, current, next)
                              "    vec2 v0 = normalize(p1-p0);\n"
                              "    vec2 v1 = normalize(p2-p1);\n"
@@ -76,6 +197,10 @@ void ofxGpuThicklines::setup(vector<ofVec3f> positions,
                              "    n0 = n1;"
                              "    n2 = n1;"
                              "\n"
+                             "    bool sharpStart = dot(v0,v1) < -MITER_LIMIT;\n"
+                             "    bool sharpEnd = dot(v1,v2) < -MITER_LIMIT;\n"
+                             "#endif\n"
+                             "\n"
                              "    \n" // determine miter lines by averaging the normals of the 2 segments
                              "    vec2 miter_a = normalize(n0 + n1);\n" // miter at start of current segment
                              "    vec2 miter_b = normalize(n1 + n2);\n" // miter at end of current segment
@@ -85,7 +210,7 @@ void ofxGpuThicklines::setup(vector<ofVec3f> positions,
                              "    float length_b = thicknessB / dot(miter_b, n1);\n"
                              "\n"
                              "    // prevent excessively long miters at sharp corners\n"
-                             "    if( dot(v0,v1) < -MITER_LIMIT ) {\n"
+                             "    if( sharpStart ) {\n"
                              "        miter_a = n1;\n"
                              "	      length_a = thicknessA;\n"
                              "\n"
@@ -94,25 +219,25 @@ void ofxGpuThicklines::setup(vector<ofVec3f> positions,
                              "\n"
                              "        fTexCoordVarying = texCoord1;\n"
                              "        flocalTexCoord = vec2(0, g);\n"
-                             "        fColorVarying = colorVarying[1];\n"
+                             "        fColorVarying = colorVarying[START];\n"
                              "        gl_Position = vec4( (p1 + thicknessA * mix(n0,n1,g) * f) / viewportSize, 0.0, 1.0 );\n"
                              "        EmitVertex();\n"
                              "\n"
                              "        fTexCoordVarying = texCoord1;\n"
                              "        flocalTexCoord = vec2(0, g); \n"
-                             "        fColorVarying = colorVarying[1];\n"
+                             "        fColorVarying = colorVarying[START];\n"
                              "        gl_Position = vec4( (p1 + thicknessA * mix(n1,n0,g) * f) / viewportSize, 0.0, 1.0 );\n"
                              "        EmitVertex();\n"
                              "\n"
                              "        fTexCoordVarying = texCoord1;\n"
                              "        flocalTexCoord = vec2(0, 0.5);\n"
-                             "        fColorVarying = colorVarying[1];\n"
+                             "        fColorVarying = colorVarying[START];\n"
                              "        gl_Position = vec4( p1 / viewportSize, 0.0, 1.0 );\n"
                              "        EmitVertex();\n"
                              "        EndPrimitive();\n"
                              "    }\n"
                              "\n"
-                             "    if( dot(v1,v2) < -MITER_LIMIT ) {\n"
+                             "    if( sharpEnd ) {\n"
                              "	      miter_b = n1;\n"
                              "	      length_b = thicknessB;\n"
                              "    }\n"
@@ -120,25 +245,25 @@ void ofxGpuThicklines::setup(vector<ofVec3f> positions,
                              "    \n" // generate the triangle strip
                              "    fTexCoordVarying = texCoord1;\n"
                              "    flocalTexCoord = vec2(0,0);\n"
-                             "    fColorVarying = colorVarying[1];\n"
+                             "    fColorVarying = colorVarying[START];\n"
                              "    gl_Position = vec4( (p1 + length_a * miter_a) / viewportSize, 0.0, 1.0 );\n"
                              "    EmitVertex();\n"
                              "  \n"
                              "    fTexCoordVarying = texCoord1;\n"
                              "    flocalTexCoord = vec2(0,1);\n"
-                             "    fColorVarying = colorVarying[1];\n"
+                             "    fColorVarying = colorVarying[START];\n"
                              "    gl_Position = vec4( (p1 - length_a * miter_a) / viewportSize, 0.0, 1.0 );\n"
                              "    EmitVertex();\n"
                              "  \n"
                              "    fTexCoordVarying = texCoord2;\n"
                              "    flocalTexCoord = vec2(1,0);\n"
-                             "    fColorVarying = colorVarying[2];\n"
+                             "    fColorVarying = colorVarying[END];\n"
                              "    gl_Position = vec4( (p2 + length_b * miter_b) / viewportSize, 0.0, 1.0 );\n"
                              "    EmitVertex();\n"
                              "  \n"
                              "    fTexCoordVarying = texCoord2;\n"
                              "    flocalTexCoord = vec2(1,1);\n"
-                             "    fColorVarying = colorVarying[2];\n"
+                             "    fColorVarying = colorVarying[END];\n"
                              "    gl_Position = vec4( (p2 - length_b * miter_b) / viewportSize, 0.0, 1.0 );\n"
                              "    EmitVertex();\n"
                              "\n"
@@ -153,18 +278,50 @@ void ofxGpuThicklines::setup(vector<ofVec3f> positions,
                              "in vec4 position;\n"
                              "in vec4 color;\n"
                              "in vec2 texcoord;\n"
+                             "#ifdef UNORM_POSITIONS\n"
+                             "uniform vec3 positionOffset;\n" // the bounds the positions are spread over
+                             "uniform vec3 positionScale;\n"
+                             "#endif\n"
                              "\n"
                              "out vec4 colorVarying;\n"
                              "out vec2 texCoordVarying;\n"
                              "out int vertexID;\n"
                              "\n"
+                             "#ifdef JOIN_TANGENTS\n"
+                             "in vec4 join;\n" // tangent and miter scale
+                             "out vec4 joinTangent;\n"
+                             "out float miterScale;\n"
+                             "#endif\n"
+                             "#ifdef BATCH\n"
+                             "uniform samplerBuffer objectBuffer;\n" // per object: 4 texels transform, color, thickness
+                             "in float object;\n"
+                             "out float objectThickness;\n"
+                             "#endif\n"
+                             "\n"
                              "void main()\n"
                              "{\n"
-                             "    gl_Position = modelViewProjectionMatrix * position;\n"
+                             "    vec4 p = position;\n"
+                             "#ifdef UNORM_POSITIONS\n"
+                             "    p.xyz = positionOffset + positionScale * p.xyz;\n"
+                             "#endif\n"
+                             "#ifdef BATCH\n"
+                             "    int o = int(object) * 6;\n"
+                             "    mat4 transform = mat4(texelFetch(objectBuffer, o), texelFetch(objectBuffer, o + 1),\n"
+                             "                          texelFetch(objectBuffer, o + 2), texelFetch(objectBuffer, o + 3));\n"
+                             "    gl_Position = modelViewProjectionMatrix * (transform * p);\n"
+                             "    colorVarying = color * texelFetch(objectBuffer, o + 4);\n"
+                             "    objectThickness = texelFetch(objectBuffer, o + 5).x;\n"
+                             "#else\n"
+                             "    gl_Position = modelViewProjectionMatrix * p;\n"
                              "    colorVarying = color;\n"
+                             "#endif\n"
                              "    vec2 drawTexCoord = (textureMatrix*vec4(texcoord.x,texcoord.y,0,1)).xy;\n"
                              "    texCoordVarying = drawTexCoord;\n"
                              "    vertexID = gl_VertexID;\n"
+                             "#ifdef JOIN_TANGENTS\n"
+                             "    joinTangent = modelViewProjectionMatrix * vec4(join.xyz, 0.0);\n"
+                             "    miterScale = join.w;\n"
+                             "#endif\n"
                              "}\n"
             );
         
@@ -182,19 +339,238 @@ void ofxGpuThicklines::setup(vector<ofVec3f> positions,
                              "    outputColor = globalColor * fColorVarying;\n"
                              "}\n"
             );
+        // vertex shader of the instanced backend: one instance per segment, which fetches its
+        // four points from buffer textures and expands them like the geometry shader above.
+        // see ofxGpuThicklinesMath.h for a CPU version.
+        string instancedVertShader = ("#version 150\n"
+                             "\n"
+                             "uniform mat4 textureMatrix;\n"
+                             "uniform mat4 modelViewProjectionMatrix;\n"
+                             "uniform float thickness;\n"
+                             "uniform int perspective;\n"
+                             "#define MITER_LIMIT 0.75\n"
+                             "uniform vec2	viewportSize;\n"
+                             "uniform samplerBuffer positionBuffer;\n" // 3 floats per point, one texel with PACKED_POSITIONS
+                             "uniform samplerBuffer colorBuffer;\n"
+                             "uniform samplerBuffer texcoordBuffer;\n"
+                             "uniform int hasTexcoords;\n"
+                             "uniform int restartIndex;\n"
+                             "#ifdef UNORM_POSITIONS\n"
+                             "uniform vec3 positionOffset;\n"
+                             "uniform vec3 positionScale;\n"
+                             "#endif\n"
+                             "\n"
+                             "#ifdef JOIN_TANGENTS\n"
+                             "uniform samplerBuffer joinBuffer;\n" // tangent and miter scale per point
+                             "#define SEGMENT uvec2\n" // indices of the start and end point
+                             "#define START x\n"
+                             "#define END y\n"
+                             "#else\n"
+                             "#define SEGMENT uvec4\n" // indices of the previous, start, end and next point
+                             "#define START y\n"
+                             "#define END z\n"
+                             "#endif\n"
+                             "in SEGMENT segment;\n"
+                             "\n"
+                             "out vec2 fTexCoordVarying;\n"
+                             "out vec2 flocalTexCoord;\n"
+                             "flat out vec2 fedgeTexCoord;\n"
+                             "out vec4 fColorVarying;\n"
+                             "flat out int edgeID;\n"
+                             "\n"
+                             "const int quadCorner[6] = int[6](0, 1, 2, 2, 1, 3);\n"
+                             "\n"
+                             "vec4 clipPosition(uint i) {\n"
+                             "#ifdef PACKED_POSITIONS\n"
+                             "    vec4 p = vec4(texelFetch(positionBuffer, int(i)).xyz, 1.0);\n"
+                             "#else\n"
+                             "    int b = int(i) * 3;\n"
+                             "    vec4 p = vec4(texelFetch(positionBuffer, b).r, texelFetch(positionBuffer, b + 1).r, texelFetch(positionBuffer, b + 2).r, 1.0);\n"
+                             "#endif\n"
+                             "#ifdef UNORM_POSITIONS\n"
+                             "    p.xyz = positionOffset + positionScale * p.xyz;\n"
+                             "#endif\n"
+                             "    return modelViewProjectionMatrix * p;\n"
+                             "}\n"
+                             "\n"
+                             "vec2 texCoord(uint i) {\n"
+                             "    vec2 t = hasTexcoords != 0 ? texelFetch(texcoordBuffer, int(i)).xy : vec2(0.0);\n"
+                             "    return (textureMatrix*vec4(t.x,t.y,0,1)).xy;\n"
+                             "}\n"
+                             "\n"
+                             "vec2 screen_space(vec4 vertex) {\n"
+                             "    return vec2( vertex.xy / vertex.w ) * viewportSize;\n"
+                             "}\n"
+                             "\n"
+                             + joinShaderFunctions + edgeIdFunction +
+                             "void main(void)\n"
+                             "{\n"
+                             "    vec2 texCoord1 = texCoord(segment.START);\n"
+                             "    vec2 texCoord2 = texCoord(segment.END);\n"
+                             "    edgeID = 0;\n"
+                             "    fedgeTexCoord = (texCoord1 + texCoord2) / 2.0;\n"
+                             "    fTexCoordVarying = texCoord1;\n"
+                             "    flocalTexCoord = vec2(0, 0.5);\n"
+                             "    fColorVarying = vec4(0.0);\n"
+                             "\n"
+                             "    \n" // windows that contain a restart index are gaps in the index buffer
+                             "    if(any(equal(segment, SEGMENT(uint(restartIndex))))) {\n"
+                             "        gl_Position = vec4(0.0, 0.0, 0.0, 1.0);\n"
+                             "        return;\n"
+                             "    }\n"
+                             "    edgeID = edge_id(segment.START, segment.END);\n"
+                             "\n"
+                             "    vec4 pos1 = clipPosition(segment.START);\n"
+                             "    vec4 pos2 = clipPosition(segment.END);\n"
+                             "    vec4 color1 = texelFetch(colorBuffer, int(segment.START));\n"
+                             "    vec4 color2 = texelFetch(colorBuffer, int(segment.END));\n"
+                             "    vec2 p1 = screen_space( pos1 );\n"
+                             "    vec2 p2 = screen_space( pos2 );\n"
+                             "\n"
+                             "    float thicknessA = thickness * (bool(perspective) ? (500.0 / pos1.w) : 1.0);\n"
+                             "    float thicknessB = thickness * (bool(perspective) ? (500.0 / pos2.w) : 1.0);\n"
+                             "\n"
+                             "#ifdef JOIN_TANGENTS\n"
+                             "    vec4 join1 = texelFetch(joinBuffer, int(segment.START));\n"
+                             "    vec4 join2 = texelFetch(joinBuffer, int(segment.END));\n"
+                             "    vec2 v1 = normalize(p2-p1);\n"
+                             "    vec2 n1 = vec2(-v1.y, v1.x);\n"
+                             "    vec2 v0 = join_neighbour(pos1, modelViewProjectionMatrix * vec4(join1.xyz, 0.0), join1.w, v1);\n"
+                             "    vec2 v2 = join_neighbour(pos2, modelViewProjectionMatrix * vec4(join2.xyz, 0.0), join2.w, v1);\n"
+                             "    vec2 n0 = vec2(-v0.y, v0.x);\n"
+                             "    vec2 n2 = vec2(-v2.y, v2.x);\n"
+                             "    bool capStart = join1.w > MITER_SCALE_LIMIT;\n"
+                             "    bool capEnd = join2.w > MITER_SCALE_LIMIT;\n"
+                             "#else\n"
+                             "    vec2 p0 = screen_space( clipPosition(segment.x) );\n"
+                             "    vec2 p3 = screen_space( clipPosition(segment.w) );\n"
+                             "    vec2 v0 = normalize(p1-p0);\n"
+                             "    vec2 v1 = normalize(p2-p1);\n"
+                             "    vec2 v2 = normalize(p3-p2);\n"
+                             "\n"
+                             "    vec2 n1 = vec2(-v1.y, v1.x);\n"
+                             "    float p_n0 = dot(v0,v0) < 0.1 ? 0.0 : 1.0;\n"
+                             "    vec2 n0 = mix(n1, vec2(-v0.y, v0.x), p_n0);\n"
+                             "    float p_n2 = dot(v2,v2) < 0.1 ? 0.0 : 1.0;\n"
+                             "    vec2 n2 = mix(n1, vec2(-v2.y, v2.x), 1.0 - p_n2);\n"
+                             // same as the FIXME in the geometry shader
+                             "    n0 = n1;\n"
+                             "    n2 = n1;\n"
+                             "    bool capStart = dot(v0,v1) < -MITER_LIMIT;\n"
+                             "    bool capEnd = dot(v1,v2) < -MITER_LIMIT;\n"
+                             "#endif\n"
+                             "\n"
+                             "    vec2 miter_a = normalize(n0 + n1);\n"
+                             "    vec2 miter_b = normalize(n1 + n2);\n"
+                             "    float length_a = thicknessA / dot(miter_a, n1);\n"
+                             "    float length_b = thicknessB / dot(miter_b, n1);\n"
+                             "\n"
+                             "    if( capStart ) {\n"
+                             "        miter_a = n1;\n"
+                             "        length_a = thicknessA;\n"
+                             "    }\n"
+                             "    if( capEnd ) {\n"
+                             "        miter_b = n1;\n"
+                             "        length_b = thicknessB;\n"
+                             "    }\n"
+                             "\n"
+                             "    int corner = gl_VertexID;\n"
+                             "    if( corner < 3 ) {\n" // the triangle at sharp corners, collapsed onto p1 when not needed
+                             "        fColorVarying = color1;\n"
+                             "        vec2 p = p1;\n"
+                             "        if( capStart ) {\n"
+                             "            float f = sign(dot(v0,n1));\n"
+                             "            float g = 1.0 - abs(f);\n"
+                             "            if( corner == 0 ) { flocalTexCoord = vec2(0, g); p = p1 + thicknessA * mix(n0,n1,g) * f; }\n"
+                             "            if( corner == 1 ) { flocalTexCoord = vec2(0, g); p = p1 + thicknessA * mix(n1,n0,g) * f; }\n"
+                             "        }\n"
+                             "        gl_Position = vec4( p / viewportSize, 0.0, 1.0 );\n"
+                             "        return;\n"
+                             "    }\n"
+                             "\n"
+                             "    int q = quadCorner[corner - 3];\n" // the strip of the geometry shader as two triangles
+                             "    bool end = q >= 2;\n"
+                             "    float side = (q == 1 || q == 3) ? -1.0 : 1.0;\n"
+                             "    fTexCoordVarying = end ? texCoord2 : texCoord1;\n"
+                             "    flocalTexCoord = vec2(end ? 1.0 : 0.0, side < 0.0 ? 1.0 : 0.0);\n"
+                             "    fColorVarying = end ? color2 : color1;\n"
+                             "    vec2 p = end ? p2 + side * length_b * miter_b : p1 + side * length_a * miter_a;\n"
+                             "    gl_Position = vec4( p / viewportSize, 0.0, 1.0 );\n"
+                             "}\n"
+            );
+
         if(customFragShader.length() != 0)
             fragShader = customFragShader;
 
-        if(m_curvesShader.isLoaded())
-            m_curvesShader.unload();
-        m_curvesShader.setupShaderFromSource(GL_GEOMETRY_SHADER, geomShader);
-        m_curvesShader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShader);
-        m_curvesShader.setupShaderFromSource(GL_VERTEX_SHADER, vertShader);
-        m_curvesShader.bindDefaults();
-        m_curvesShader.linkProgram();
+        if(shader.isLoaded())
+            shader.unload();
+        if(backend == BACKEND_INSTANCED) {
+            shader.setupShaderFromSource(GL_VERTEX_SHADER, withDefines(instancedVertShader, defines));
+            shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShader);
+        }
+        else {
+            shader.setupShaderFromSource(GL_GEOMETRY_SHADER, withDefines(geomShader, defines));
+            shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragShader);
+            shader.setupShaderFromSource(GL_VERTEX_SHADER, withDefines(vertShader, defines));
+        }
+        shader.bindDefaults();
+        shader.linkProgram();
     }
-    
-    reset(positions, colors, texcoords, curves);
+}
+
+namespace {
+    // what a shared program is made from
+    struct ShaderSource {
+        ofxGpuThicklines::RenderBackend backend;
+        string defines;
+        string customFragShader;
+        bool operator==(const ShaderSource &other) const {
+            return backend == other.backend && defines == other.defines && customFragShader == other.customFragShader;
+        }
+    };
+
+    ofxGpuThicklinesPrograms::Registry<ofShader, ShaderSource> &shaderRegistry() {
+        static ofxGpuThicklinesPrograms::Registry<ofShader, ShaderSource> registry;
+        return registry;
+    }
+
+    uint64_t hashString(const string &s, uint64_t h) {
+        uint64_t n = s.size();
+        h = ofxGpuThicklinesCache::hashBytes(&n, sizeof(n), h);
+        return ofxGpuThicklinesCache::hashBytes(s.data(), s.size(), h);
+    }
+}
+
+shared_ptr<ofShader> ofxGpuThicklines::sharedShader(RenderBackend backend, const string &defines,
+                                                    const string &customFragShader) {
+    // the sources are made from these and nothing else
+    uint64_t b = backend;
+    uint64_t hash = ofxGpuThicklinesCache::hashBytes(&b, sizeof(b));
+    hash = hashString(defines, hash);
+    hash = hashString(customFragShader, hash);
+    const ShaderSource source = { backend, defines, customFragShader };
+    return shaderRegistry().get(hash, source, [&](ofShader &shader) {
+        loadShader(shader, backend, defines, customFragShader);
+    });
+}
+
+size_t ofxGpuThicklines::numSharedShaders() {
+    return shaderRegistry().size();
+}
+
+size_t ofxGpuThicklines::numShaderBuilds() {
+    return shaderRegistry().builds();
+}
+
+void ofxGpuThicklines::setup(vector<ofVec3f> positions,
+                             vector<ofVec4f> colors,
+                             vector<ofVec2f> texcoords,
+                             vector< vector<size_t> > curves,
+                             string customFragShader) {
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    setupShader(customFragShader);
+    m_frameStats.setupMs += (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+    reset(std::move(positions), std::move(colors), std::move(texcoords), std::move(curves));
 }
 
 void ofxGpuThicklines::setup(vector<ofVec3f> positions,
@@ -202,85 +578,211 @@ void ofxGpuThicklines::setup(vector<ofVec3f> positions,
                              vector< vector<size_t> > curves,
                              string customFragShader) {
     vector<ofVec2f> texcoords; // intentionally empty
-    setup(positions, colors, texcoords, curves, customFragShader);
+    setup(std::move(positions), std::move(colors), std::move(texcoords), std::move(curves), customFragShader);
 }
 
-void ofxGpuThicklines::setup(const ofMesh &mesh, string customFragShader, bool onlylines) {
-    vector<ofVec4f> colors; colors.reserve(mesh.getNumVertices());
-    if(mesh.getNumColors() == mesh.getNumVertices()) {
-        for(const ofFloatColor &c : mesh.getColors()) {
-            colors.push_back(ofVec4f(c.r,c.g,c.b,c.a));
-        }
+void ofxGpuThicklines::setup(StridedView<ofVec3f> positions,
+                             StridedView<ofVec4f> colors,
+                             StridedView<ofVec2f> texcoords,
+                             FlatCurves curves,
+                             string customFragShader) {
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    setupShader(customFragShader);
+    m_frameStats.setupMs += (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+    reset(positions, colors, texcoords, curves);
+}
+
+namespace {
+    // an undirected edge (i,j) packed into one key with the smaller index in the upper half.
+    // sorting these keys groups the edges by their first vertex.
+    inline uint64_t packEdge(uint32_t i, uint32_t j) {
+        if(i > j) std::swap(i, j);
+        return (uint64_t(i) << 32) | uint64_t(j);
     }
-    else {
-        for(size_t i=0; i<mesh.getNumVertices(); ++i)
-            colors.push_back(ofVec4f(1,1,1,1.0));
+    inline uint32_t edgeFirst(uint64_t key) { return uint32_t(key >> 32); }
+    inline uint32_t edgeSecond(uint64_t key) { return uint32_t(key & 0xffffffffu); }
+
+    // collects the unique edges of the mesh as sorted packed keys.
+    //
+    // every triangle (or line) writes its edges into its own slots of one preallocated key array,
+    // so extraction runs in parallel without any synchronisation. Degenerate edges become
+    // `noKey`, one past the last vertex in both halves, which sorts to the end and is dropped
+    // together with the duplicates.
+    void collectMeshEdges(const ofMesh &mesh, bool onlylines, vector<uint64_t> &edges) {
+        const uint64_t noKey = packEdge(uint32_t(mesh.getNumVertices()), uint32_t(mesh.getNumVertices()));
+        const vector<ofIndexType> &idx = mesh.getIndices();
+        const size_t perPrimitive = onlylines ? 2 : 3;
+        const size_t numPrimitives = idx.size() / perPrimitive;
+        const size_t keysPerPrimitive = onlylines ? 1 : 3;
+
+        edges.resize(numPrimitives * keysPerPrimitive);
+        ofxGpuThicklinesParallel::forRange(numPrimitives, [&](size_t begin, size_t end) {
+            for(size_t t=begin; t<end; ++t) {
+                const ofIndexType *p = &idx[t * perPrimitive];
+                uint64_t *out = &edges[t * keysPerPrimitive];
+                if(onlylines) {
+                    out[0] = p[0] != p[1] ? packEdge(p[0], p[1]) : noKey;
+                }
+                else {
+                    out[0] = p[0] != p[1] ? packEdge(p[0], p[1]) : noKey;
+                    out[1] = p[0] != p[2] ? packEdge(p[0], p[2]) : noKey;
+                    out[2] = p[1] != p[2] ? packEdge(p[1], p[2]) : noKey;
+                }
+            }
+        });
+
+        ofxGpuThicklinesParallel::radixSort(edges, noKey);
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        if(! edges.empty() && edges.back() == noKey)
+            edges.pop_back();
     }
-    // ofLogNotice("ofxGpuThicklines", "setup mesh with %lu vertices, %lu colors (resolved to %lu)",
-    // mesh.getNumVertices(), mesh.getNumColors(), colors.size());
 
-    vector< vector<size_t> > curves;
-    {
-        // each edge needs to be part of exactly one curve
-        // we'd like to add multiple edges in each curve.
+    // splits the edge graph into trails via Hierholzer's algorithm.
+    //
+    // odd-degree vertices are paired up with virtual edges so that every vertex has even degree,
+    // then an Euler circuit is walked per connected component and cut wherever it crosses a
+    // virtual edge. This yields max(1, odd/2) curves per component, which is the minimum possible.
+    // the graph is kept in CSR form (`adjStart`, `adjEdges`) with one visited bit per edge.
+    size_t curvesBytes(const vector< vector<size_t> > &curves) {
+        size_t b = curves.capacity() * sizeof(vector<size_t>);
+        for(const vector<size_t> &c : curves) b += c.capacity() * sizeof(size_t);
+        return b;
+    }
 
-        // build adjacency list. For edge (i,j), adjacency[i] contains j and adjacency[j] contains i
-        map< size_t, set<size_t> > adjacency;
-        set< size_t > liveVertices;
+    // `peakBytes`: what it held at the end, when all of it is alive, without `edges`
+    void eulerTrails(const vector<uint64_t> &edges, size_t numVertices, vector< vector<size_t> > &curves,
+                     size_t &peakBytes) {
+        const uint32_t noEdge = 0xffffffffu;
+
+        vector<uint32_t> degree(numVertices, 0);
+        for(uint64_t e : edges) {
+            degree[edgeFirst(e)]++;
+            degree[edgeSecond(e)]++;
+        }
+
+        // pair up odd vertices with virtual edges, which are numbered after the real ones
+        vector<uint32_t> edgeA, edgeB; // endpoints
+        edgeA.reserve(edges.size()); edgeB.reserve(edges.size());
+        for(uint64_t e : edges) {
+            edgeA.push_back(edgeFirst(e));
+            edgeB.push_back(edgeSecond(e));
+        }
+        const size_t numRealEdges = edges.size();
+        {
+            uint32_t pending = noEdge;
+            for(size_t v=0; v<numVertices; ++v) {
+                if(degree[v] % 2 == 0) continue;
+                if(pending == noEdge) {
+                    pending = uint32_t(v);
+                }
+                else {
+                    edgeA.push_back(pending);
+                    edgeB.push_back(uint32_t(v));
+                    degree[pending]++;
+                    degree[v]++;
+                    pending = noEdge;
+                }
+            }
+        }
+        const size_t numEdges = edgeA.size();
+
+        // CSR adjacency: the edges incident to v are adjEdges[adjStart[v] .. adjStart[v+1])
+        vector<size_t> adjStart(numVertices + 1, 0);
+        for(size_t v=0; v<numVertices; ++v)
+            adjStart[v + 1] = adjStart[v] + degree[v];
+        vector<uint32_t> adjEdges(adjStart[numVertices]);
         {
-            if(! onlylines) { // triangles
-                for(int i0=0; i0<(int)mesh.getIndices().size() - 2; i0+=3) {
-                    size_t i = mesh.getIndex(i0);
-                    size_t j = mesh.getIndex(i0 + 1);
-                    size_t k = mesh.getIndex(i0 + 2);
-            
-                    adjacency[i].insert(j);
-                    adjacency[j].insert(i);
-                    adjacency[i].insert(k);
-                    adjacency[k].insert(i);
-                    adjacency[j].insert(k);
-                    adjacency[k].insert(j);
-
-                    liveVertices.insert(i);
-                    liveVertices.insert(j);
-                    liveVertices.insert(k);
+            vector<size_t> fill(adjStart.begin(), adjStart.end() - 1);
+            for(size_t e=0; e<numEdges; ++e) {
+                adjEdges[fill[edgeA[e]]++] = uint32_t(e);
+                adjEdges[fill[edgeB[e]]++] = uint32_t(e);
+            }
+        }
+        vector<size_t> cursor(adjStart.begin(), adjStart.end() - 1); // next unvisited candidate per vertex
+        vector<uint64_t> visited((numEdges + 63) / 64, 0);
+
+        vector<uint32_t> stackV, stackE, circuitV, circuitE;
+        for(size_t start=0; start<numVertices; ++start) {
+            if(cursor[start] == adjStart[start + 1]) continue;
+
+            // iterative Hierholzer. popped vertices form the circuit (in reverse, which does not matter),
+            // circuitE[i] is the edge connecting circuitV[i] and circuitV[i+1].
+            stackV.clear(); stackE.clear(); circuitV.clear(); circuitE.clear();
+            stackV.push_back(uint32_t(start)); stackE.push_back(noEdge);
+            while(! stackV.empty()) {
+                uint32_t v = stackV.back();
+                size_t &c = cursor[v];
+                while(c < adjStart[v + 1] && (visited[adjEdges[c] / 64] >> (adjEdges[c] % 64)) & 1)
+                    ++c;
+                if(c < adjStart[v + 1]) {
+                    uint32_t e = adjEdges[c++];
+                    visited[e / 64] |= uint64_t(1) << (e % 64);
+                    stackV.push_back(edgeA[e] ^ edgeB[e] ^ v);
+                    stackE.push_back(e);
+                }
+                else {
+                    circuitV.push_back(v);
+                    circuitE.push_back(stackE.back());
+                    stackV.pop_back(); stackE.pop_back();
                 }
             }
-            else {
-                for(int i0=0; i0<(int)mesh.getIndices().size() - 1; i0+=2) {
-                    size_t i = mesh.getIndex(i0);
-                    size_t j = mesh.getIndex(i0 + 1);
-            
-                    adjacency[i].insert(j);
-                    adjacency[j].insert(i);
 
-                    liveVertices.insert(i);
-                    liveVertices.insert(j);
+            const size_t m = circuitE.size() - 1; // number of edges in the closed circuit
+            if(m == 0) continue;
 
+            // cut the circuit at virtual edges, starting right after the first one
+            size_t firstVirtual = m;
+            for(size_t i=0; i<m; ++i) {
+                if(circuitE[i] >= numRealEdges) { firstVirtual = i; break; }
+            }
+            if(firstVirtual == m) { // closed curve
+                curves.push_back(vector<size_t>(circuitV.begin(), circuitV.end()));
+                continue;
+            }
+            vector<size_t> curve;
+            curve.push_back(circuitV[(firstVirtual + 1) % m]);
+            for(size_t k=1; k<=m; ++k) {
+                size_t i = (firstVirtual + k) % m;
+                if(circuitE[i] >= numRealEdges) {
+                    if(curve.size() > 1) curves.push_back(curve);
+                    curve.clear();
                 }
+                curve.push_back(circuitV[i + 1]);
             }
+            // the last step crossed `firstVirtual` again, leaving a single vertex behind
+        }
+        peakBytes = (degree.capacity() + edgeA.capacity() + edgeB.capacity() + adjEdges.capacity()
+                     + stackV.capacity() + stackE.capacity() + circuitV.capacity() + circuitE.capacity()) * sizeof(uint32_t)
+            + (adjStart.capacity() + cursor.capacity()) * sizeof(size_t) + visited.capacity() * sizeof(uint64_t)
+            + curvesBytes(curves);
+    }
+
+    // the original greedy walk, kept around for comparison. It produces many more (and shorter) curves.
+    void greedyWalk(const vector<uint64_t> &edges, vector< vector<size_t> > &curves) {
+        // build adjacency list. For edge (i,j), adjacency[i] contains j and adjacency[j] contains i
+        map< size_t, set<size_t> > adjacency;
+        set< size_t > liveVertices;
+        for(uint64_t e : edges) {
+            size_t i = edgeFirst(e), j = edgeSecond(e);
+            adjacency[i].insert(j);
+            adjacency[j].insert(i);
+            liveVertices.insert(i);
+            liveVertices.insert(j);
         }
-        // ofLogNotice("ofxGpuThicklines", "adjacency has %lu elements, live vertices are %lu", adjacency.size(), liveVertices.size());
 
         vector<size_t> currentCurve;
         map<size_t, set<size_t>> addedEdges;
         while(! liveVertices.empty()) {
             size_t curVertex = *liveVertices.begin(); // take any vertex
-                
             bool firstVertex = true;
-            
-            // ofLogNotice("ofxGpuThicklines", "curve add iter %lu", curVertex);
             while(true) {
                 bool foundNone = true;
                 for(const size_t &neighbor : adjacency[curVertex]) { // find any neighbor whose edge is not yet added
                     size_t a = curVertex;
                     size_t b = neighbor;
                     if(a > b) std::swap(a, b);
-                            
+
                     if(addedEdges[a].find(b) == addedEdges[a].end()) { // if the edge to neighbor was not yet added...
-                        // add that edge to the current curve and the added edges
-                        
-                        // current edge not yet added
                         if(firstVertex) { // add first vertex as well => avoid 1-vertex curves
                             firstVertex = false;
                             currentCurve.push_back(curVertex);
@@ -311,110 +813,2171 @@ void ofxGpuThicklines::setup(const ofMesh &mesh, string customFragShader, bool o
         if(currentCurve.size() > 0) {
             curves.push_back(currentCurve);
         }
-    } // end add curves
-    
-    // ofLogNotice("ofxGpuThicklines", "setup mesh with %lu curves", curves.size());
-    // int x = 0;
-    // for(vector<size_t> &c : curves) {
-    // ofLogNotice("ofxGpuThicklines", "\tcurve %d: %s", x, ofToString(c).c_str());
-    // x++;
-    // }        
-        
-    setup(mesh.getVertices(), colors, mesh.getTexCoords(), curves, customFragShader);
+    }
 }
 
-void ofxGpuThicklines::reset(vector<ofVec3f> positions,
-                             vector<ofVec4f> colors,
-                             vector<ofVec2f> texcoords,
-                             vector< vector<size_t> > curves) {
-    m_shaderBegun = false;
-    
-    assert(positions.size() == colors.size());
+vector< vector<size_t> > ofxGpuThicklines::meshToCurves(const ofMesh &mesh, bool onlylines,
+                                                         CurveDecomposition method,
+                                                         DecompositionStats *stats) {
+    uint64_t t0 = ofGetElapsedTimeMicros();
 
-    m_positions = positions;
-    m_colors = colors;
-    m_texcoords = texcoords;
+    // each edge needs to be part of exactly one curve
+    // we'd like to add multiple edges in each curve.
+    vector<uint64_t> edges;
+    collectMeshEdges(mesh, onlylines, edges);
+    // the radix sort holds a second array of the keys
+    size_t peakBytes = 2 * edges.capacity() * sizeof(uint64_t);
 
-    {
-        m_curvesVbo.clear();
-        m_curvesVbo.setVertexData(&m_positions[0], m_positions.size(), GL_DYNAMIC_DRAW);
+    size_t numVertices = mesh.getNumVertices();
+    if(! edges.empty())
+        numVertices = std::max(numVertices, size_t(edgeFirst(edges.back())) + 1);
+    for(uint64_t e : edges)
+        numVertices = std::max(numVertices, size_t(edgeSecond(e)) + 1);
+
+    vector< vector<size_t> > curves;
+    size_t trailBytes = 0;
+    if(method == DECOMPOSE_GREEDY) {
+        greedyWalk(edges, curves);
+        trailBytes = curvesBytes(curves); // without its maps and sets
+    }
+    else {
+        eulerTrails(edges, numVertices, curves, trailBytes);
+    }
+    peakBytes = std::max(peakBytes, edges.capacity() * sizeof(uint64_t) + trailBytes);
+
+    if(stats) {
+        stats->numEdges = edges.size();
+        stats->numCurves = curves.size();
+        stats->milliseconds = (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+        stats->peakBytes = peakBytes;
+    }
+    return curves;
+}
+
+void ofxGpuThicklines::setup(const ofMesh &mesh, string customFragShader, bool onlylines) {
+    vector<ofVec4f> colors;
+    if(mesh.getNumColors() == mesh.getNumVertices()) {
+        // ofFloatColor is four packed floats, just like ofVec4f
+        colors.assign(reinterpret_cast<const ofVec4f*>(mesh.getColors().data()),
+                      reinterpret_cast<const ofVec4f*>(mesh.getColors().data()) + mesh.getNumColors());
+    }
+    else {
+        colors.assign(mesh.getNumVertices(), ofVec4f(1,1,1,1.0));
+    }
+
+    vector< vector<size_t> > curves = meshToCurves(mesh, onlylines, DECOMPOSE_EULER, &m_decompositionStats);
+    // the decomposition comes before the load, next to what we held before and the colors
+    const size_t decompositionPeak = cpuMemoryBytes() + colors.capacity() * sizeof(ofVec4f) + m_decompositionStats.peakBytes;
+    m_frameStats.setupMs += m_decompositionStats.milliseconds;
+    ofLogVerbose("ofxGpuThicklines") << "decomposed " << m_decompositionStats.numEdges << " edges into "
+                                     << m_decompositionStats.numCurves << " curves in "
+                                     << m_decompositionStats.milliseconds << " ms";
+
+    // vertices and texcoords are copied once here, everything else is moved
+    setup(mesh.getVertices(), std::move(colors), mesh.getTexCoords(), std::move(curves), customFragShader);
+    m_peakLoadBytes = std::max(m_peakLoadBytes, decompositionPeak);
+}
+
+namespace {
+    // marks unused space in the index buffer and separates strips. Primitive restart is enabled
+    // while drawing, so primitives made of these are skipped. The CPU copy always holds 32 bit
+    // indices, 16 bit index buffers get 0xffff instead.
+    const unsigned int restartIndex = 0xffffffffu;
+    const unsigned short restartIndex16 = 0xffff;
+}
 
-        // construct adjacency indices suitable for OpenGL from curve data
-        vector<unsigned int> indices;
+size_t ofxGpuThicklines::curveIndexCount(IndexMode mode, size_t n) {
+    if(n < 2) return 0;
+    if(mode == INDEX_LINE_STRIP_ADJACENCY)
+        return n + 3;
+    if(mode == INDEX_LINES)
+        return 2 * (n - 1);
+    return 4 * (n - 1);
+}
+
+// beginning and end of the curve are used twice so that the curve goes through them
+// TODO: maybe not do this to be more like ofCurveVertices()?
+void ofxGpuThicklines::writeCurveIndices(IndexMode mode, const size_t *conn, size_t n, unsigned int *out) {
+    if(mode == INDEX_LINE_STRIP_ADJACENCY) {
+        // one strip, which yields the same adjacency quadruples as below
+        *out++ = conn[0];
+        for(size_t i=0; i<n; ++i)
+            *out++ = conn[i];
+        *out++ = conn[n - 1];
+        *out++ = restartIndex;
+        return;
+    }
+    if(mode == INDEX_LINES) {
+        // plain segments, the neighbours come from the join attribute
+        for(size_t i=0; i+1<n; ++i) {
+            *out++ = conn[i];
+            *out++ = conn[i + 1];
+        }
+        return;
+    }
+    for(size_t i=0; i+1<n; ++i) {
+        *out++ = conn[i == 0 ? 0 : i - 1];
+        *out++ = conn[i];
+        *out++ = conn[i + 1];
+        *out++ = conn[i + 2 < n ? i + 2 : n - 1];
+    }
+}
+
+namespace {
+    // uniform access to the curves passed to `reset()`, either nested vectors or flat arrays
+    struct NestedCurveSource {
+        const vector< vector<size_t> > &curves;
+        size_t size() const { return curves.size(); }
+        size_t length(size_t i) const { return curves[i].size(); }
+        const size_t *data(size_t i) const { return curves[i].data(); }
+        size_t bytes() const { return curvesBytes(curves); }
+    };
+    struct FlatCurveSource {
+        const ofxGpuThicklines::FlatCurves &curves;
+        size_t size() const { return curves.numCurves; }
+        size_t length(size_t i) const { return curves.offsets[i + 1] - curves.offsets[i]; }
+        const size_t *data(size_t i) const { return curves.indices + curves.offsets[i]; }
+        size_t bytes() const { return 0; } // owned by the caller
+    };
+
+    // spreads the lower 10 bits of `v` to every third bit
+    inline uint32_t expandBits(uint32_t v) {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    // the curves in the order of the Morton codes of their bounding box centers, so that curves
+    // next to each other in the index buffer are close in space as well
+    template<typename CurveSource>
+    vector<size_t> spatialOrder(const CurveSource &curves, const vector<ofVec3f> &positions) {
+        vector<ofVec3f> centers(curves.size());
+        ofxGpuThicklinesParallel::forRange(curves.size(), [&](size_t begin, size_t end) {
+            for(size_t i=begin; i<end; ++i) {
+                ofxGpuThicklinesCulling::Box box;
+                const size_t *c = curves.data(i);
+                for(size_t k=0; k<curves.length(i); ++k)
+                    box.add(positions[c[k]]);
+                centers[i] = box.center();
+            }
+        }, 256);
+        ofxGpuThicklinesCulling::Box scene;
+        for(const ofVec3f &c : centers)
+            scene.add(c);
+        ofVec3f extent = scene.max - scene.min;
+        vector< std::pair<uint32_t, size_t> > keys(curves.size());
         for(size_t i=0; i<curves.size(); ++i) {
-            vector<size_t> &conn = curves[i];
-            // printf("connection %d\n", conn.size());
-            if(conn.empty()) continue;
-
-            // pack beginning and end of `conn` twice into `connIndices`
-            // so that the curve goes through them
-            // TODO: maybe not do this to be more like ofCurveVertices()?
-            vector<size_t> connIndices;
-            connIndices.push_back(conn[0]);
-            connIndices.insert(connIndices.begin() + 1, conn.begin(), conn.end());
-            connIndices.push_back(conn[conn.size() - 1]);
-            /*
-              printf("connx: ");
-              for(size_t i = 0; i<connIndices.size(); ++i) 
-              printf("%lu ", connIndices[i]);
-              printf("\n");
-            */
-            
-            if(connIndices.size() < 4) continue;
-
-            // transform connIndices to be like GL lines adjacency
-            for(size_t i=0; i+3<connIndices.size(); ++i) {
-                indices.push_back(connIndices[i]);
-                indices.push_back(connIndices[i+1]);
-                indices.push_back(connIndices[i+2]);
-                indices.push_back(connIndices[i+3]);
+            uint32_t code = 0;
+            for(int axis=0; axis<3; ++axis) {
+                float t = extent[axis] > 0 ? (centers[i][axis] - scene.min[axis]) / extent[axis] : 0.0f;
+                code |= expandBits(uint32_t(std::min(t * 1024.0f, 1023.0f))) << axis;
             }
+            keys[i] = std::make_pair(code, i);
         }
-        
-        m_curvesVbo.setIndexData(&indices[0], indices.size(), GL_STATIC_DRAW);
-        m_indexCount = indices.size();
-        
-        m_curvesVbo.setAttributeData(m_curvesShader.getAttributeLocation("color"),
-                                     &m_colors[0].x, 4, m_colors.size(), GL_DYNAMIC_DRAW);
-        
-        m_curvesVbo.setTexCoordData(&m_texcoords[0], m_texcoords.size(), GL_DYNAMIC_DRAW);
+        std::sort(keys.begin(), keys.end());
+        vector<size_t> order(curves.size());
+        for(size_t i=0; i<keys.size(); ++i)
+            order[i] = keys[i].second;
+        return order;
+    }
 
-        // using `setTexCoordData` here doesn't work, probably because our attributes are in a different order from the default shader (from which that function takes the attribute location to set)
-        m_curvesVbo.setAttributeData(m_curvesShader.getAttributeLocation("texcoord"),
-                                     &m_texcoords[0].x, 2, m_texcoords.size(), GL_DYNAMIC_DRAW);
+    // copies a possibly strided view into a vector, with a single memcpy when it is packed
+    template<typename T>
+    void copyView(const ofxGpuThicklines::StridedView<T> &view, vector<T> &out) {
+        out.resize(view.count);
+        if(view.count == 0) return;
+        if(view.contiguous()) {
+            memcpy(&out[0], view.data, view.count * sizeof(T));
+        }
+        else {
+            for(size_t i=0; i<view.count; ++i)
+                out[i] = view[i];
+        }
     }
 }
 
+void ofxGpuThicklines::reset(vector<ofVec3f> positions,
+                             vector<ofVec4f> colors,
+                             vector<ofVec2f> texcoords,
+                             vector< vector<size_t> > curves) {
+    assert(positions.size() == colors.size());
+    NestedCurveSource source = { curves };
+    beginLoad(source.bytes());
+    // the new vertices next to the old ones
+    notePeakLoad(positions.capacity() * sizeof(ofVec3f) + colors.capacity() * sizeof(ofVec4f)
+                 + texcoords.capacity() * sizeof(ofVec2f));
 
-void ofxGpuThicklines::beginUpdates() {
-    ; // we do nothing. this method is, for now, only to provide a more logical API.
+    // the arguments are sinks: callers passing temporaries (or using std::move) hand over
+    // their buffers without any copy.
+    m_positions = std::move(positions);
+    m_colors = std::move(colors);
+    m_texcoords = std::move(texcoords);
+
+    resetCurves(source);
 }
 
+void ofxGpuThicklines::reset(StridedView<ofVec3f> positions,
+                             StridedView<ofVec4f> colors,
+                             StridedView<ofVec2f> texcoords,
+                             FlatCurves curves) {
+    assert(positions.count == colors.count);
+    FlatCurveSource source = { curves };
+    beginLoad(source.bytes());
 
-void ofxGpuThicklines::endUpdates() {
-    m_curvesVbo.updateVertexData(&m_positions[0], m_positions.size());
-    m_curvesVbo.updateAttributeData(m_curvesShader.getAttributeLocation("color"),
-                                    &m_colors[0].x, m_colors.size());
+    // the one copy into our own buffers, which later updates are applied to
+    copyView(positions, m_positions);
+    copyView(colors, m_colors);
+    copyView(texcoords, m_texcoords);
+
+    resetCurves(source);
 }
 
-ofShader &ofxGpuThicklines::prepareDraw() {
-    m_curvesShader.begin();
-    m_shaderBegun = true;
-    return m_curvesShader;
+size_t ofxGpuThicklines::cpuMemoryBytes() const {
+    size_t bytes = m_positions.capacity() * sizeof(ofVec3f) + m_colors.capacity() * sizeof(ofVec4f)
+        + m_texcoords.capacity() * sizeof(ofVec2f) + m_indices.capacity() * sizeof(unsigned int)
+        + m_curveSlots.capacity() * sizeof(CurveSlot) + m_joins.capacity() * sizeof(ofVec4f)
+        + (m_joinAdjacencyStart.capacity() + m_joinAdjacency.capacity()) * sizeof(unsigned int)
+        + m_chunkBoxes.capacity() * sizeof(ofxGpuThicklinesCulling::Box)
+        + (m_vertexChunkStart.capacity() + m_vertexChunks.capacity()) * sizeof(unsigned int)
+        + m_lodErrors.capacity() * sizeof(float) + m_packScratch.capacity()
+        + m_edgeTable.capacity() * sizeof(unsigned int)
+        + m_picker.memoryBytes() + m_pickCurveStart.capacity() * sizeof(size_t)
+        + m_curveHidden.capacity() + m_groupHidden.capacity()
+        + (m_curveGroups.capacity() + m_groupCurveStart.capacity() + m_groupCurves.capacity()) * sizeof(unsigned int)
+        + (m_hiddenRanges.capacity() + m_rangeScratch.capacity()) * sizeof(std::pair<size_t, size_t>);
+    for(const LodLevel &level : m_lodLevels)
+        bytes += level.indices.capacity() * sizeof(unsigned int)
+            + (level.chunkOffsets.capacity() + level.pieceOffsets.capacity()) * sizeof(size_t)
+            + level.pieceCurves.capacity() * sizeof(CurveHandle)
+            + level.hiddenRanges.capacity() * sizeof(std::pair<size_t, size_t>)
+            + (level.curvePieceStart.capacity() + level.curvePieces.capacity()) * sizeof(size_t);
+    return bytes;
 }
 
-void ofxGpuThicklines::draw(float lineWidth, bool perspective, ofVec2f viewportSize) {
-    ofFill();
-    if(! m_shaderBegun)
-        m_curvesShader.begin();
-    if(viewportSize.x == 0)
-        viewportSize = ofVec2f(ofGetWidth(), ofGetHeight());
-    m_curvesShader.setUniform2f("viewportSize", viewportSize);
-    m_curvesShader.setUniform1i("perspective", (int)perspective);
-    m_curvesShader.setUniform1f("thickness", lineWidth);
-    m_curvesVbo.drawElements(GL_LINES_ADJACENCY, m_indexCount);
-    m_curvesShader.end();
+template<typename CurveSource>
+void ofxGpuThicklines::resetCurves(const CurveSource &curves) {
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    // construct adjacency indices suitable for OpenGL from curve data.
+    // curve i gets handle i and the i-th block of the index buffer, or, with chunks, the
+    // block at its place in the spatial order.
+    //
+    // two passes without any allocation per curve: the block sizes and their prefix sum,
+    // then every part of the index buffer is filled in parallel from its curves.
+    const size_t numCurves = curves.size();
+    m_curveSlots.resize(numCurves);
+    ofxGpuThicklinesParallel::forRange(numCurves, [&](size_t begin, size_t end) {
+        for(size_t i=begin; i<end; ++i) {
+            CurveSlot &slot = m_curveSlots[i];
+            slot.count = curveIndexCount(m_indexMode, curves.length(i));
+            slot.live = true;
+        }
+    });
+    vector<size_t> order;
+    if(usesChunks()) {
+        order = spatialOrder(curves, m_positions);
+        // which held the centers and sort keys of the curves next to the order
+        notePeakLoad(numCurves * (sizeof(ofVec3f) + sizeof(std::pair<uint32_t, size_t>) + sizeof(size_t)));
+    }
 
-    m_shaderBegun = false;
+    // blockStart[k]: offset of the k-th block in buffer order
+    vector<size_t> blockStart(numCurves + 1);
+    const size_t parts = ofxGpuThicklinesParallel::numParts(numCurves);
+    vector<size_t> partTotals(parts + 1, 0);
+    ofxGpuThicklinesParallel::forParts(numCurves, parts, [&](size_t begin, size_t end, size_t p) {
+        for(size_t k=begin; k<end; ++k)
+            partTotals[p + 1] += m_curveSlots[order.empty() ? k : order[k]].count;
+    });
+    for(size_t p=0; p<parts; ++p)
+        partTotals[p + 1] += partTotals[p];
+    ofxGpuThicklinesParallel::forParts(numCurves, parts, [&](size_t begin, size_t end, size_t p) {
+        size_t offset = partTotals[p];
+        for(size_t k=begin; k<end; ++k) {
+            CurveSlot &slot = m_curveSlots[order.empty() ? k : order[k]];
+            blockStart[k] = slot.offset = offset;
+            offset += slot.count;
+        }
+    });
+    const size_t total = blockStart[numCurves] = partTotals[parts];
+
+    // the blocks cover the whole buffer, every element is written exactly once below
+    m_indices.clear();
+    m_indices.resize(total);
+    notePeakLoad((order.capacity() + blockStart.capacity() + partTotals.capacity()) * sizeof(size_t));
+    ofxGpuThicklinesParallel::forRange(total, [&](size_t begin, size_t end) {
+        // the blocks starting in [begin, end)
+        size_t k = std::lower_bound(blockStart.begin(), blockStart.end() - 1, begin) - blockStart.begin();
+        for(; k<numCurves && blockStart[k] < end; ++k) {
+            size_t i = order.empty() ? k : order[k];
+            if(m_curveSlots[i].count > 0)
+                writeCurveIndices(m_indexMode, curves.data(i), curves.length(i), &m_indices[blockStart[k]]);
+        }
+    }, 1 << 16);
+
+    finishReset(t0);
+}
+
+void ofxGpuThicklines::beginLoad(size_t inputBytes) {
+    m_loading = true;
+    m_loadInputBytes = inputBytes;
+    m_peakLoadBytes = 0;
+    notePeakLoad();
+}
+
+void ofxGpuThicklines::notePeakLoad(size_t temporaryBytes) {
+    if(m_loading)
+        m_peakLoadBytes = std::max(m_peakLoadBytes, cpuMemoryBytes() + m_loadInputBytes + temporaryBytes);
 }
 
+void ofxGpuThicklines::finishReset(uint64_t t0) {
+    m_shaderBegun = false;
+    m_dirtyPositions.clear();
+    m_dirtyColors.clear();
+    m_producer.reset(); // its frames are of the old vertices
+    m_dirtyJoins.clear();
+    m_freeHandles.clear();
+    m_picker.clear();
+    vector<size_t>().swap(m_pickCurveStart);
+    m_pickStale = true;
+    m_curveHidden.assign(m_curveSlots.size(), 0);
+    m_curveGroups.assign(m_curveSlots.size(), 0);
+    m_groupHidden.clear();
+    m_groupsStale = m_hiddenStale = true;
+
+    // the index mode or vertex format changed since `setup()` built the shader
+    if(shaderDefines() != m_shaderDefines)
+        setupShader(m_customFragShader);
+
+    const bool gl = m_renderBackend != BACKEND_NONE;
+    {
+        // the bounds POSITIONS_UNORM16 spreads its values over, and the ranges for the error bounds
+        m_positionRange = ofxGpuThicklinesCulling::Box();
+        m_texcoordMaxAbs = 0;
+        if(m_vertexFormat.positions != POSITIONS_FLOAT) {
+            for(const ofVec3f &p : m_positions)
+                m_positionRange.add(p);
+            float maxAbs = 0;
+            for(int c=0; c<3 && ! m_positionRange.empty(); ++c)
+                maxAbs = std::max(maxAbs, std::max(std::abs(m_positionRange.min[c]), std::abs(m_positionRange.max[c])));
+            if(m_vertexFormat.positions == POSITIONS_HALF && maxAbs > ofxGpuThicklinesQuantize::halfMax)
+                ofLogWarning("ofxGpuThicklines") << "positions beyond " << ofxGpuThicklinesQuantize::halfMax
+                                                 << " don't fit POSITIONS_HALF, use POSITIONS_UNORM16";
+        }
+        if(m_vertexFormat.texcoords != TEXCOORDS_FLOAT) {
+            for(const ofVec2f &t : m_texcoords)
+                m_texcoordMaxAbs = std::max(m_texcoordMaxAbs, std::max(std::abs(t.x), std::abs(t.y)));
+        }
+
+        const size_t n = m_positions.size();
+        if(gl) {
+            m_curvesVbo.clear();
+            if(interleaved()) {
+                if(! m_interleavedVertices.isAllocated())
+                    m_interleavedVertices.allocate();
+                m_interleavedVertices.setData(n * vertexStride(), packInterleaved(0, n), GL_DYNAMIC_DRAW);
+            }
+            else if(m_vertexFormat.positions == POSITIONS_FLOAT)
+                m_curvesVbo.setVertexData(&m_positions[0], n, GL_DYNAMIC_DRAW);
+            else {
+                if(! m_packedPositions.isAllocated())
+                    m_packedPositions.allocate();
+                m_packedPositions.setData(n * positionBytes(), packPositions(0, n), GL_DYNAMIC_DRAW);
+            }
+        }
+
+        m_segmentCount = 0;
+        for(const CurveSlot &slot : m_curveSlots)
+            m_segmentCount += slot.count > 0 ? curvePoints(slot) - 1 : 0;
+        m_indexAllocator.reset(m_indices.size());
+        m_indexCount = m_indices.size();
+        m_dirtyIndices.clear();
+        m_indexBufferResized = false;
+
+        // vertex 0xffff is reserved for restarts
+        m_shortIndices = m_positions.size() <= 0xffff;
+        if(gl && ! m_indexBuffer.isAllocated())
+            m_indexBuffer.allocate();
+        m_indexBufferResized = true;
+        uploadIndices();
+        
+        if(gl && ! interleaved()) {
+            if(m_vertexFormat.colors == COLORS_FLOAT)
+                m_curvesVbo.setAttributeData(m_colorLocation,
+                                             &m_colors[0].x, 4, m_colors.size(), GL_DYNAMIC_DRAW);
+            else {
+                if(! m_packedColors.isAllocated())
+                    m_packedColors.allocate();
+                m_packedColors.setData(m_colors.size() * colorBytes(), packColors(0, m_colors.size()), GL_DYNAMIC_DRAW);
+            }
+
+            if(m_vertexFormat.texcoords == TEXCOORDS_FLOAT) {
+                m_curvesVbo.setTexCoordData(&m_texcoords[0], m_texcoords.size(), GL_DYNAMIC_DRAW);
+
+                // using `setTexCoordData` here doesn't work, probably because our attributes are in a different order from the default shader (from which that function takes the attribute location to set)
+                m_curvesVbo.setAttributeData(m_texcoordLocation,
+                                             &m_texcoords[0].x, 2, m_texcoords.size(), GL_DYNAMIC_DRAW);
+            }
+            else {
+                if(! m_packedTexcoords.isAllocated())
+                    m_packedTexcoords.allocate();
+                m_packedTexcoords.setData(m_texcoords.size() * texcoordBytes(), packTexcoords(0, m_texcoords.size()), GL_DYNAMIC_DRAW);
+            }
+        }
+        else if(! gl) {
+            // no upload, but the same conversions as above
+            if(interleaved()) {
+                packInterleaved(0, n);
+            }
+            else {
+                packPositions(0, n);
+                packColors(0, m_colors.size());
+                packTexcoords(0, m_texcoords.size());
+            }
+        }
+        // the scratch space of the conversions is only needed in full on a reset
+        notePeakLoad();
+        vector<unsigned char>().swap(m_packScratch);
+
+        if(m_indexMode == INDEX_LINES) {
+            rebuildJoinAdjacency();
+            m_joins.resize(m_positions.size());
+            computeJoins(0, m_joins.size());
+            if(gl)
+                m_curvesVbo.setAttributeData(m_joinLocation, &m_joins[0].x, 4, m_joins.size(), GL_DYNAMIC_DRAW);
+        }
+        else {
+            vector<ofVec4f>().swap(m_joins);
+            vector<unsigned int>().swap(m_joinAdjacencyStart);
+            vector<unsigned int>().swap(m_joinAdjacency);
+        }
+        m_joinTopologyChanged = false;
+
+        rebuildEdgeTable();
+
+        m_lodStale = true;
+        if(usesChunks()) {
+            rebuildChunks();
+        }
+        else {
+            vector<ofxGpuThicklinesCulling::Box>().swap(m_chunkBoxes);
+            vector<unsigned int>().swap(m_vertexChunkStart);
+            vector<unsigned int>().swap(m_vertexChunks);
+            m_chunksStale = true;
+        }
+
+        if(m_renderBackend == BACKEND_INSTANCED)
+            bindInstancedBuffers();
+    }
+    // split float texcoords go to two attributes, see above
+    if(interleaved())
+        m_bytesUploaded = m_positions.size() * vertexStride();
+    else
+        m_bytesUploaded = m_positions.size() * positionBytes() + m_colors.size() * colorBytes()
+            + (m_vertexFormat.texcoords == TEXCOORDS_FLOAT ? 2 : 1) * m_texcoords.size() * texcoordBytes();
+    m_bytesUploaded += m_joins.size() * sizeof(ofVec4f) + m_indices.size() * indexSize()
+        + m_edgeTable.size() * sizeof(unsigned int);
+    m_totalBytesUploaded += m_bytesUploaded;
+    m_frameStats.setupMs += (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+    notePeakLoad();
+    m_loading = false;
+    m_loadInputBytes = 0;
+    ofLogVerbose("ofxGpuThicklines") << "loaded " << m_positions.size() << " vertices and "
+                                     << m_indexCount << " indices, peak CPU memory "
+                                     << m_peakLoadBytes / 1024 << " KiB";
+}
+
+bool ofxGpuThicklines::checkCurve(const vector<size_t> &curve, const char *caller) const {
+    // the edge table, the join adjacency and the picker index their tables by vertex, so an
+    // index out of range must not get that far, release builds included
+    for(size_t i : curve) {
+        if(i >= m_positions.size()) {
+            ofLogError("ofxGpuThicklines") << caller << "(): vertex " << i << " is out of range, there are "
+                                           << m_positions.size() << " vertices";
+            return false;
+        }
+    }
+    return true;
+}
+
+ofxGpuThicklines::CurveHandle ofxGpuThicklines::addCurve(const vector<size_t> &curve) {
+    if(! checkCurve(curve, "addCurve")) return noCurve;
+    CurveHandle h;
+    if(! m_freeHandles.empty()) {
+        h = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    }
+    else {
+        h = m_curveSlots.size();
+        m_curveSlots.push_back(CurveSlot());
+        m_curveHidden.push_back(0);
+        m_curveGroups.push_back(0);
+    }
+    m_curveSlots[h].live = true;
+    m_edgeCurves.push_back(h);
+    m_curveHidden[h] = 0;
+    m_curveGroups[h] = 0;
+    m_groupsStale = true;
+    placeCurve(h, curve);
+    return h;
+}
+
+void ofxGpuThicklines::removeCurve(CurveHandle h) {
+    if(! hasCurve(h)) return;
+    releaseCurve(h);
+    m_curveSlots[h].live = false;
+    m_freeHandles.push_back(h);
+}
+
+void ofxGpuThicklines::replaceCurve(CurveHandle h, const vector<size_t> &curve) {
+    if(! hasCurve(h) || ! checkCurve(curve, "replaceCurve")) return;
+    CurveSlot &slot = m_curveSlots[h];
+    if(slot.count == curveIndexCount(m_indexMode, curve.size())) { // same size, overwrite in place
+        if(slot.count > 0) {
+            writeCurveIndices(m_indexMode, &curve[0], curve.size(), &m_indices[slot.offset]);
+            m_dirtyIndices.add(slot.offset, slot.offset + slot.count);
+            m_joinTopologyChanged = m_indexMode == INDEX_LINES;
+            m_edgeCurves.push_back(h);
+        }
+        return;
+    }
+    releaseCurve(h);
+    placeCurve(h, curve);
+    m_edgeCurves.push_back(h);
+}
+
+void ofxGpuThicklines::placeCurve(CurveHandle h, const vector<size_t> &curve) {
+    CurveSlot &slot = m_curveSlots[h];
+    slot.count = curveIndexCount(m_indexMode, curve.size());
+    slot.offset = m_indexAllocator.allocate(slot.count);
+    if(slot.count == 0) return;
+
+    if(m_indexAllocator.end() > m_indices.size()) {
+        // grow geometrically, so that appending curves one by one stays cheap
+        m_indices.resize(std::max(m_indexAllocator.end(), m_indices.size() + m_indices.size() / 2), restartIndex);
+        m_indexBufferResized = true;
+    }
+    writeCurveIndices(m_indexMode, &curve[0], curve.size(), &m_indices[slot.offset]);
+    m_dirtyIndices.add(slot.offset, slot.offset + slot.count);
+    m_segmentCount += curve.size() - 1;
+    m_indexCount = m_indexAllocator.end();
+    m_hiddenStale = true;
+    if(m_indexMode == INDEX_LINES)
+        m_joinTopologyChanged = true;
+}
+
+void ofxGpuThicklines::releaseCurve(CurveHandle h) {
+    CurveSlot &slot = m_curveSlots[h];
+    if(slot.count > 0) {
+        m_segmentCount -= curvePoints(slot) - 1;
+        std::fill(m_indices.begin() + slot.offset, m_indices.begin() + slot.offset + slot.count, restartIndex);
+        m_dirtyIndices.add(slot.offset, slot.offset + slot.count);
+        m_indexAllocator.release(slot.offset, slot.count);
+        if(m_indexMode == INDEX_LINES)
+            m_joinTopologyChanged = true;
+    }
+    slot.count = 0;
+    m_indexCount = m_indexAllocator.end();
+    m_hiddenStale = true;
+}
+
+void ofxGpuThicklines::setCurveVisible(CurveHandle h, bool visible) {
+    if(! hasCurve(h) || m_curveHidden[h] == ! visible) return;
+    m_curveHidden[h] = ! visible;
+    if(! groupHidden(m_curveGroups[h]))
+        visibilityChanged(vector<CurveHandle>(1, h));
+}
+
+void ofxGpuThicklines::setCurveGroup(CurveHandle h, unsigned int group) {
+    if(group >= maxGroups) {
+        ofLogError("ofxGpuThicklines") << "setCurveGroup(): group " << group << " is not below maxGroups " << maxGroups;
+        return;
+    }
+    if(! hasCurve(h) || m_curveGroups[h] == group) return;
+    const bool shown = curveShown(h);
+    m_curveGroups[h] = group;
+    m_groupsStale = true;
+    if(curveShown(h) != shown)
+        visibilityChanged(vector<CurveHandle>(1, h));
+}
+
+void ofxGpuThicklines::setGroupVisible(unsigned int group, bool visible) {
+    if(group >= maxGroups) {
+        ofLogError("ofxGpuThicklines") << "setGroupVisible(): group " << group << " is not below maxGroups " << maxGroups;
+        return;
+    }
+    if(groupHidden(group) == ! visible) return;
+    if(group >= m_groupHidden.size())
+        m_groupHidden.resize(group + 1, 0);
+    m_groupHidden[group] = ! visible;
+    if(m_groupsStale)
+        rebuildGroups();
+    vector<CurveHandle> changed;
+    if(group + 1 < m_groupCurveStart.size()) {
+        for(unsigned int k=m_groupCurveStart[group]; k<m_groupCurveStart[group + 1]; ++k) {
+            if(! m_curveHidden[m_groupCurves[k]])
+                changed.push_back(m_groupCurves[k]);
+        }
+    }
+    visibilityChanged(changed);
+}
+
+void ofxGpuThicklines::rebuildGroups() {
+    m_groupsStale = false;
+    // counting sort of the live curves by group
+    const unsigned int groups = m_curveGroups.empty() ? 0 : *std::max_element(m_curveGroups.begin(), m_curveGroups.end()) + 1;
+    m_groupCurveStart.assign(groups + 1, 0);
+    for(CurveHandle h=0; h<m_curveSlots.size(); ++h) {
+        if(m_curveSlots[h].live)
+            ++m_groupCurveStart[m_curveGroups[h] + 1];
+    }
+    for(unsigned int g=0; g<groups; ++g)
+        m_groupCurveStart[g + 1] += m_groupCurveStart[g];
+    m_groupCurves.resize(m_groupCurveStart[groups]);
+    vector<unsigned int> fill(m_groupCurveStart.begin(), m_groupCurveStart.end() - 1);
+    for(CurveHandle h=0; h<m_curveSlots.size(); ++h) {
+        if(m_curveSlots[h].live)
+            m_groupCurves[fill[m_curveGroups[h]]++] = unsigned(h);
+    }
+}
+
+void ofxGpuThicklines::rebuildHiddenRanges() {
+    m_hiddenStale = false;
+    m_hiddenRanges.clear();
+    for(CurveHandle h=0; h<m_curveSlots.size(); ++h) {
+        const CurveSlot &slot = m_curveSlots[h];
+        if(slot.live && slot.count > 0 && ! curveShown(h))
+            m_hiddenRanges.push_back(std::make_pair(slot.offset, slot.offset + slot.count));
+    }
+    std::sort(m_hiddenRanges.begin(), m_hiddenRanges.end());
+}
+
+namespace {
+    // one pass over the sorted `ranges`, dropping those in `shown` and adding those in `hidden` in order
+    void mergeHiddenRanges(vector< std::pair<size_t, size_t> > &ranges, vector< std::pair<size_t, size_t> > &hidden,
+                           vector< std::pair<size_t, size_t> > &shown, vector< std::pair<size_t, size_t> > &scratch) {
+        std::sort(hidden.begin(), hidden.end());
+        std::sort(shown.begin(), shown.end());
+        scratch.clear();
+        vector< std::pair<size_t, size_t> >::const_iterator add = hidden.begin(), drop = shown.begin();
+        for(const std::pair<size_t, size_t> &r : ranges) {
+            while(drop != shown.end() && *drop < r) ++drop;
+            if(drop != shown.end() && *drop == r) {
+                ++drop;
+                continue;
+            }
+            for(; add != hidden.end() && *add < r; ++add)
+                scratch.push_back(*add);
+            scratch.push_back(r);
+        }
+        scratch.insert(scratch.end(), add, hidden.cend());
+        ranges.swap(scratch);
+    }
+}
+
+// toggling visibility never touches the index buffer: it merges the blocks of `curves` into the
+// sorted list of hidden blocks, and their pieces into that of every simplified level, in time
+// linear in the pieces of `curves` and the hidden ones. Curve edits instead mark the lists stale,
+// rebuilt on the next `draw()`, and moved positions those of the simplified levels.
+void ofxGpuThicklines::visibilityChanged(const vector<CurveHandle> &curves) {
+    if(curves.empty()) return;
+    // the segments listed for picking are up to date unless the curves were edited since
+    const bool pickable = ! m_pickStale && m_dirtyIndices.empty() && ! m_indexBufferResized;
+    vector< std::pair<size_t, size_t> > hidden, shown;
+    for(CurveHandle h : curves) {
+        if(pickable && h + 1 < m_pickCurveStart.size())
+            m_picker.setEnabled(m_pickCurveStart[h], m_pickCurveStart[h + 1], curveShown(h));
+        const CurveSlot &slot = m_curveSlots[h];
+        if(slot.live && slot.count > 0)
+            (curveShown(h) ? shown : hidden).push_back(std::make_pair(slot.offset, slot.offset + slot.count));
+    }
+    if(m_hiddenStale) {
+        // the curves were edited, their pieces in the simplified levels may be of other curves
+        for(LodLevel &level : m_lodLevels)
+            level.hiddenStale = true;
+        return;
+    }
+    mergeHiddenRanges(m_hiddenRanges, hidden, shown, m_rangeScratch);
+
+    // the same for the pieces of the curves in every simplified level listed since it last changed
+    for(LodLevel &level : m_lodLevels) {
+        if(level.hiddenStale) continue;
+        hidden.clear();
+        shown.clear();
+        for(CurveHandle h : curves) {
+            if(h + 1 >= level.curvePieceStart.size()) continue;
+            vector< std::pair<size_t, size_t> > &ranges = curveShown(h) ? shown : hidden;
+            for(size_t i=level.curvePieceStart[h]; i<level.curvePieceStart[h + 1]; ++i) {
+                const size_t k = level.curvePieces[i];
+                ranges.push_back(std::make_pair(level.pieceOffsets[k], level.pieceOffsets[k + 1]));
+            }
+        }
+        mergeHiddenRanges(level.hiddenRanges, hidden, shown, m_rangeScratch);
+    }
+}
+
+size_t ofxGpuThicklines::uploadIndices() {
+    size_t bytes = 0;
+    if(m_indexBufferResized) {
+        bytes = m_indices.size() * indexSize();
+        if(m_renderBackend != BACKEND_NONE)
+            m_indexBuffer.setData(bytes, nullptr, GL_DYNAMIC_DRAW);
+        uploadIndexRange(m_indexBuffer, m_indices, 0, m_indices.size());
+        m_indexBufferResized = false;
+    }
+    else {
+        for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : m_dirtyIndices.coalesce()) {
+            uploadIndexRange(m_indexBuffer, m_indices, r.first, r.second);
+            bytes += (r.second - r.first) * indexSize();
+        }
+    }
+    if(bytes > 0)
+        m_chunksStale = m_lodStale = m_edgeTableStale = m_pickStale = true;
+    m_dirtyIndices.clear();
+    return bytes;
+}
+
+void ofxGpuThicklines::uploadIndexRange(ofBufferObject &buffer, const vector<unsigned int> &indices,
+                                        size_t begin, size_t end) {
+    if(begin >= end || m_renderBackend == BACKEND_NONE) return;
+    if(! m_shortIndices) {
+        buffer.updateData(begin * sizeof(unsigned int), (end - begin) * sizeof(unsigned int), &indices[begin]);
+        return;
+    }
+    // narrow in pieces, so that a full upload does not need a second copy of the whole buffer
+    const size_t piece = 1 << 16;
+    m_shortScratch.resize(std::min(piece, end - begin));
+    for(size_t b=begin; b<end; b+=piece) {
+        size_t e = std::min(end, b + piece);
+        for(size_t i=b; i<e; ++i)
+            m_shortScratch[i - b] = indices[i] == restartIndex ? restartIndex16 : (unsigned short)indices[i];
+        buffer.updateData(b * sizeof(unsigned short), (e - b) * sizeof(unsigned short), m_shortScratch.data());
+    }
+}
+
+void ofxGpuThicklines::setIndexMode(IndexMode mode) {
+    m_indexMode = mode;
+}
+
+namespace {
+    // ranges closer than this are uploaded as one, trading a few redundant bytes for fewer calls
+    const size_t uploadGap = 16;
+
+    // uploads the dirty ones of `count` elements of `elementBytes` each to `buffer`, or all of
+    // them if most are dirty anyway. `pack(begin, end)` gives the data of elements [begin, end)
+    // in the format of the buffer. Returns the number of bytes sent. Without a buffer
+    // (BACKEND_NONE) only packs and counts them.
+    template<typename Pack>
+    size_t uploadDirty(ofBufferObject *buffer, size_t count, size_t elementBytes,
+                       ofxGpuThicklinesRanges::DirtyRanges &dirty, Pack pack) {
+        if(dirty.empty() || count == 0) {
+            dirty.clear();
+            return 0;
+        }
+        const vector<ofxGpuThicklinesRanges::DirtyRanges::Range> &ranges = dirty.coalesce(uploadGap);
+        size_t bytes = 0;
+        if(dirty.count() * 2 > count) {
+            bytes = count * elementBytes;
+            const void *data = pack(0, count);
+            if(buffer)
+                buffer->updateData(0, bytes, data);
+        }
+        else {
+            for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : ranges) {
+                size_t end = std::min(r.second, count);
+                if(end <= r.first) continue;
+                const void *data = pack(r.first, end);
+                if(buffer)
+                    buffer->updateData(r.first * elementBytes, (end - r.first) * elementBytes, data);
+                bytes += (end - r.first) * elementBytes;
+            }
+        }
+        dirty.clear();
+        return bytes;
+    }
+
+    // the same for float attributes, which are uploaded as they are
+    template<typename T>
+    size_t uploadDirty(ofBufferObject *buffer, const vector<T> &data, ofxGpuThicklinesRanges::DirtyRanges &dirty) {
+        return uploadDirty(buffer, data.size(), sizeof(T), dirty,
+                           [&data](size_t begin, size_t) { return static_cast<const void*>(&data[begin]); });
+    }
+
+    // the conversions of large ranges are spread over the cores
+    const size_t packChunk = 1 << 14;
+}
+
+size_t ofxGpuThicklines::positionBytes() const {
+    return m_vertexFormat.positions == POSITIONS_FLOAT ? sizeof(ofVec3f) : 4 * sizeof(uint16_t);
+}
+
+size_t ofxGpuThicklines::colorBytes() const {
+    return m_vertexFormat.colors == COLORS_FLOAT ? sizeof(ofVec4f) : 4 * sizeof(uint8_t);
+}
+
+size_t ofxGpuThicklines::texcoordBytes() const {
+    return m_vertexFormat.texcoords == TEXCOORDS_FLOAT ? sizeof(ofVec2f) : 2 * sizeof(uint16_t);
+}
+
+const void *ofxGpuThicklines::packPositions(size_t begin, size_t end) {
+    if(end <= begin) return nullptr;
+    if(m_vertexFormat.positions == POSITIONS_FLOAT)
+        return &m_positions[begin];
+    m_packScratch.resize(std::max(m_packScratch.size(), (end - begin) * positionBytes()));
+    uint16_t *out = reinterpret_cast<uint16_t*>(&m_packScratch[0]);
+    const float *in = &m_positions[begin].x;
+    if(m_vertexFormat.positions == POSITIONS_HALF) {
+        ofxGpuThicklinesParallel::forRange(end - begin, [&](size_t b, size_t e) {
+            ofxGpuThicklinesQuantize::packHalfPoints(in + 3 * b, e - b, out + 4 * b);
+        }, packChunk);
+    }
+    else {
+        const float offset[3] = { m_positionRange.min.x, m_positionRange.min.y, m_positionRange.min.z };
+        const float scale[3] = { m_positionRange.max.x - offset[0], m_positionRange.max.y - offset[1],
+                                 m_positionRange.max.z - offset[2] };
+        ofxGpuThicklinesParallel::forRange(end - begin, [&](size_t b, size_t e) {
+            ofxGpuThicklinesQuantize::packUnorm16Points(in + 3 * b, e - b, offset, scale, out + 4 * b);
+        }, packChunk);
+    }
+    return out;
+}
+
+const void *ofxGpuThicklines::packColors(size_t begin, size_t end) {
+    if(end <= begin) return nullptr;
+    if(m_vertexFormat.colors == COLORS_FLOAT)
+        return &m_colors[begin];
+    m_packScratch.resize(std::max(m_packScratch.size(), (end - begin) * colorBytes()));
+    uint8_t *out = &m_packScratch[0];
+    const float *in = &m_colors[begin].x;
+    ofxGpuThicklinesParallel::forRange(end - begin, [&](size_t b, size_t e) {
+        ofxGpuThicklinesQuantize::packUnorm8(in + 4 * b, 4 * (e - b), out + 4 * b);
+    }, packChunk);
+    return out;
+}
+
+const void *ofxGpuThicklines::packTexcoords(size_t begin, size_t end) {
+    if(end <= begin) return nullptr;
+    if(m_vertexFormat.texcoords == TEXCOORDS_FLOAT)
+        return &m_texcoords[begin];
+    m_packScratch.resize(std::max(m_packScratch.size(), (end - begin) * texcoordBytes()));
+    uint16_t *out = reinterpret_cast<uint16_t*>(&m_packScratch[0]);
+    const float *in = &m_texcoords[begin].x;
+    ofxGpuThicklinesParallel::forRange(end - begin, [&](size_t b, size_t e) {
+        ofxGpuThicklinesQuantize::packHalf(in + 2 * b, 2 * (e - b), out + 2 * b);
+    }, packChunk);
+    return out;
+}
+
+size_t ofxGpuThicklines::vertexStride() const {
+    return positionBytes() + colorBytes() + (hasTexcoords() ? texcoordBytes() : 0);
+}
+
+const void *ofxGpuThicklines::packInterleaved(size_t begin, size_t end) {
+    if(end <= begin) return nullptr;
+    // position, color, texcoord, each a multiple of 4 bytes, so everything stays aligned
+    const size_t stride = vertexStride();
+    const size_t colorOffset = positionBytes();
+    const size_t texcoordOffset = colorOffset + colorBytes();
+    const bool texcoords = hasTexcoords();
+    m_packScratch.resize(std::max(m_packScratch.size(), (end - begin) * stride));
+    unsigned char *out = &m_packScratch[0];
+    const float offset[3] = { m_positionRange.min.x, m_positionRange.min.y, m_positionRange.min.z };
+    const float scale[3] = { m_positionRange.max.x - offset[0], m_positionRange.max.y - offset[1],
+                             m_positionRange.max.z - offset[2] };
+    ofxGpuThicklinesParallel::forRange(end - begin, [&](size_t b, size_t e) {
+        unsigned char *v = out + b * stride;
+        const float *p = &m_positions[begin + b].x;
+        if(m_vertexFormat.positions == POSITIONS_HALF)
+            ofxGpuThicklinesQuantize::packHalfPoints(p, e - b, reinterpret_cast<uint16_t*>(v), stride / 2);
+        else if(m_vertexFormat.positions == POSITIONS_UNORM16)
+            ofxGpuThicklinesQuantize::packUnorm16Points(p, e - b, offset, scale, reinterpret_cast<uint16_t*>(v), stride / 2);
+        for(size_t i=b; i<e; ++i, v+=stride) {
+            const size_t k = begin + i;
+            if(m_vertexFormat.positions == POSITIONS_FLOAT)
+                memcpy(v, &m_positions[k], sizeof(ofVec3f));
+            if(m_vertexFormat.colors == COLORS_FLOAT)
+                memcpy(v + colorOffset, &m_colors[k], sizeof(ofVec4f));
+            else
+                ofxGpuThicklinesQuantize::packUnorm8(&m_colors[k].x, 4, v + colorOffset);
+            if(! texcoords)
+                continue;
+            if(m_vertexFormat.texcoords == TEXCOORDS_FLOAT)
+                memcpy(v + texcoordOffset, &m_texcoords[k], sizeof(ofVec2f));
+            else
+                ofxGpuThicklinesQuantize::packHalf(&m_texcoords[k].x, 2, reinterpret_cast<uint16_t*>(v + texcoordOffset));
+        }
+    }, packChunk);
+    return out;
+}
+
+void ofxGpuThicklines::growPositionRange() {
+    ofxGpuThicklinesCulling::Box range = m_positionRange;
+    for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : m_dirtyPositions.coalesce()) {
+        for(size_t i=r.first; i<r.second && i<m_positions.size(); ++i)
+            range.add(m_positions[i]);
+    }
+    if(range.min == m_positionRange.min && range.max == m_positionRange.max)
+        return;
+    // grown by half on every side that was left, so that a drifting curve doesn't do this every frame
+    const ofVec3f margin = (range.max - range.min) * 0.5f;
+    for(int c=0; c<3; ++c) {
+        if(range.min[c] < m_positionRange.min[c]) range.min[c] -= margin[c];
+        if(range.max[c] > m_positionRange.max[c]) range.max[c] += margin[c];
+    }
+    m_positionRange = range;
+    if(m_vertexFormat.positions == POSITIONS_UNORM16) {
+        ofLogVerbose("ofxGpuThicklines") << "positions left their bounds, converting all of them again";
+        m_dirtyPositions.add(0, m_positions.size());
+    }
+}
+
+ofxGpuThicklines::QuantizationError ofxGpuThicklines::quantizationError() const {
+    QuantizationError error;
+    error.position = ofVec3f(0, 0, 0);
+    if(! m_positionRange.empty()) {
+        for(int c=0; c<3; ++c) {
+            if(m_vertexFormat.positions == POSITIONS_HALF)
+                error.position[c] = ofxGpuThicklinesQuantize::halfError(std::max(std::abs(m_positionRange.min[c]),
+                                                                                 std::abs(m_positionRange.max[c])));
+            else if(m_vertexFormat.positions == POSITIONS_UNORM16)
+                error.position[c] = ofxGpuThicklinesQuantize::unorm16Error(m_positionRange.max[c] - m_positionRange.min[c]);
+        }
+    }
+    error.color = m_vertexFormat.colors == COLORS_RGBA8 ? ofxGpuThicklinesQuantize::unorm8Error : 0;
+    error.texcoord = m_vertexFormat.texcoords == TEXCOORDS_HALF ? ofxGpuThicklinesQuantize::halfError(m_texcoordMaxAbs) : 0;
+    return error;
+}
+
+
+void ofxGpuThicklines::rebuildJoinAdjacency() {
+    // counting sort of the segment ends by vertex
+    const size_t n = m_positions.size();
+    m_joinAdjacencyStart.assign(n + 1, 0);
+    for(size_t i=0; i+1<m_indexCount; i+=2) {
+        unsigned int a = m_indices[i], b = m_indices[i + 1];
+        if(a == restartIndex || a == b) continue;
+        ++m_joinAdjacencyStart[a + 1];
+        ++m_joinAdjacencyStart[b + 1];
+    }
+    for(size_t v=0; v<n; ++v)
+        m_joinAdjacencyStart[v + 1] += m_joinAdjacencyStart[v];
+    m_joinAdjacency.resize(m_joinAdjacencyStart[n]);
+    vector<unsigned int> fill(m_joinAdjacencyStart.begin(), m_joinAdjacencyStart.end() - 1);
+    for(size_t i=0; i+1<m_indexCount; i+=2) {
+        unsigned int a = m_indices[i], b = m_indices[i + 1];
+        if(a == restartIndex || a == b) continue;
+        m_joinAdjacency[fill[a]++] = b;
+        m_joinAdjacency[fill[b]++] = a;
+    }
+}
+
+void ofxGpuThicklines::computeJoins(size_t begin, size_t end) {
+    // the reversal of a curve gets a miter scale that is sharp against any limit
+    const float reversalScale = 1e6f;
+    ofxGpuThicklinesParallel::forRange(end - begin, [&](size_t b, size_t e) {
+        for(size_t v=begin+b; v<begin+e; ++v) {
+            m_joins[v] = ofVec4f(0, 0, 0, 0);
+            if(m_joinAdjacencyStart[v + 1] - m_joinAdjacencyStart[v] != 2) continue;
+            const unsigned int *neighbours = &m_joinAdjacency[m_joinAdjacencyStart[v]];
+            ofVec3f in = m_positions[v] - m_positions[neighbours[0]];
+            ofVec3f out = m_positions[neighbours[1]] - m_positions[v];
+            float inLength = in.length(), outLength = out.length();
+            if(inLength == 0 || outLength == 0) continue;
+            in /= inLength;
+            out /= outLength;
+
+            // |in + out| = 2 cos(turn / 2), the miter is 1 / cos(turn / 2) times the line width
+            ofVec3f tangent = in + out;
+            float tangentLength = tangent.length();
+            if(tangentLength < 2 / reversalScale)
+                m_joins[v] = ofVec4f(in.x, in.y, in.z, reversalScale);
+            else
+                m_joins[v] = ofVec4f(tangent.x / tangentLength, tangent.y / tangentLength, tangent.z / tangentLength,
+                                     2 / tangentLength);
+        }
+    });
+}
+
+size_t ofxGpuThicklines::updateJoins() {
+    if(m_indexMode != INDEX_LINES || m_joins.empty()) {
+        m_joinTopologyChanged = false;
+        return 0;
+    }
+    if(m_joinTopologyChanged) {
+        rebuildJoinAdjacency();
+        m_dirtyJoins.clear();
+        m_dirtyJoins.add(0, m_joins.size());
+        m_joinTopologyChanged = false;
+    }
+    else {
+        // a join depends on its vertex and on both neighbours
+        for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : m_dirtyPositions.coalesce()) {
+            m_dirtyJoins.add(r.first, r.second);
+            for(size_t v=r.first; v<r.second; ++v) {
+                for(unsigned int a=m_joinAdjacencyStart[v]; a<m_joinAdjacencyStart[v + 1]; ++a)
+                    m_dirtyJoins.add(m_joinAdjacency[a]);
+            }
+        }
+    }
+    for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : m_dirtyJoins.coalesce())
+        computeJoins(r.first, r.second);
+    return uploadDirty(vboBuffer(m_joinLocation), m_joins, m_dirtyJoins);
+}
+
+ofBufferObject *ofxGpuThicklines::vboBuffer(GLint location) {
+    if(m_renderBackend == BACKEND_NONE)
+        return nullptr;
+    if(interleaved() && (location == ofShader::POSITION_ATTRIBUTE || location == m_colorLocation || location == m_texcoordLocation))
+        return &m_interleavedVertices;
+    if(location == ofShader::POSITION_ATTRIBUTE)
+        return m_vertexFormat.positions == POSITIONS_FLOAT ? &m_curvesVbo.getVertexBuffer() : &m_packedPositions;
+    if(location == m_colorLocation && m_vertexFormat.colors != COLORS_FLOAT)
+        return &m_packedColors;
+    if(location == m_texcoordLocation && m_vertexFormat.texcoords != TEXCOORDS_FLOAT)
+        return &m_packedTexcoords;
+    return &m_curvesVbo.getAttributeBuffer(location);
+}
+
+void ofxGpuThicklines::beginUpdates() {
+    ; // we do nothing. this method is, for now, only to provide a more logical API.
+}
+
+
+void ofxGpuThicklines::endUpdates() {
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    m_bytesUploaded = 0;
+    // all before the dirty positions are cleared
+    m_bytesUploaded += updateJoins();
+    m_bytesUploaded += refitChunks();
+    for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : m_dirtyPositions.coalesce())
+        m_picker.moved(r.first, r.second);
+    if(m_vertexFormat.positions != POSITIONS_FLOAT && ! m_dirtyPositions.empty())
+        growPositionRange();
+    if(interleaved()) {
+        // whole vertices, whichever of their attributes changed
+        for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : m_dirtyColors.coalesce())
+            m_dirtyPositions.add(r.first, r.second);
+        m_dirtyColors.clear();
+        m_bytesUploaded += uploadDirty(vboBuffer(ofShader::POSITION_ATTRIBUTE), m_positions.size(), vertexStride(), m_dirtyPositions,
+                                       [this](size_t begin, size_t end) { return packInterleaved(begin, end); });
+    }
+    else {
+        m_bytesUploaded += uploadDirty(vboBuffer(ofShader::POSITION_ATTRIBUTE), m_positions.size(), positionBytes(), m_dirtyPositions,
+                                       [this](size_t begin, size_t end) { return packPositions(begin, end); });
+        m_bytesUploaded += uploadDirty(vboBuffer(m_colorLocation), m_colors.size(), colorBytes(), m_dirtyColors,
+                                       [this](size_t begin, size_t end) { return packColors(begin, end); });
+    }
+    m_bytesUploaded += uploadIndices();
+    if(m_edgeTableStale)
+        m_bytesUploaded += updateEdgeTable();
+    m_totalBytesUploaded += m_bytesUploaded;
+    m_frameStats.updateMs += (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+}
+
+namespace {
+    void addRanges(ofxGpuThicklinesRanges::DirtyRanges &to, ofxGpuThicklinesRanges::DirtyRanges &from) {
+        for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : from.coalesce())
+            to.add(r.first, r.second);
+        to.coalesce();
+    }
+
+    template<typename T>
+    void copyRanges(vector<T> &to, const vector<T> &from, const vector<ofxGpuThicklinesRanges::DirtyRanges::Range> &ranges) {
+        for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : ranges)
+            std::copy(from.begin() + r.first, from.begin() + r.second, to.begin() + r.first);
+    }
+}
+
+ofxGpuThicklines::Producer::Producer(const vector<ofVec3f> &positions, const vector<ofVec4f> &colors) : m_published(0) {
+    for(int i=0; i<3; ++i) {
+        m_frames.slot(i).positions = positions;
+        m_frames.slot(i).colors = colors;
+    }
+}
+
+void ofxGpuThicklines::Producer::publish() {
+    // the render thread may still be on any frame since the last one it is known to have taken.
+    // Whether it took the previous one only shows when handing this one over, so this may
+    // name a few ranges too many, never too few.
+    Frame &f = frame();
+    f.changedPositions = m_pendingPositions;
+    f.changedColors = m_pendingColors;
+    addRanges(f.changedPositions, m_dirtyPositions);
+    addRanges(f.changedColors, m_dirtyColors);
+
+    const int published = m_frames.writeIndex();
+    if(m_frames.publish()) {
+        m_pendingPositions.clear();
+        m_pendingColors.clear();
+    }
+    ++m_published;
+    addRanges(m_pendingPositions, m_dirtyPositions);
+    addRanges(m_pendingColors, m_dirtyColors);
+
+    // the other buffers lack the changes of this frame. The one we got back catches up on all it
+    // lacks from the one just published, which is only read until it comes back to us.
+    for(int i=0; i<3; ++i) {
+        if(i == published) continue;
+        addRanges(m_stalePositions[i], m_dirtyPositions);
+        addRanges(m_staleColors[i], m_dirtyColors);
+    }
+    const int next = m_frames.writeIndex();
+    const Frame &latest = m_frames.slot(published);
+    copyRanges(frame().positions, latest.positions, m_stalePositions[next].ranges());
+    copyRanges(frame().colors, latest.colors, m_staleColors[next].ranges());
+    m_stalePositions[next].clear();
+    m_staleColors[next].clear();
+    m_dirtyPositions.clear();
+    m_dirtyColors.clear();
+}
+
+shared_ptr<ofxGpuThicklines::Producer> ofxGpuThicklines::startProducer() {
+    m_producer = shared_ptr<Producer>(new Producer(m_positions, m_colors));
+    return m_producer;
+}
+
+bool ofxGpuThicklines::pullUpdates() {
+    if(! m_producer || ! m_producer->m_frames.acquire())
+        return false;
+    const Producer::Frame &f = m_producer->m_frames.readBuffer();
+    beginUpdates();
+    copyRanges(m_positions, f.positions, f.changedPositions.ranges());
+    for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : f.changedPositions.ranges())
+        m_dirtyPositions.add(r.first, r.second);
+    copyRanges(m_colors, f.colors, f.changedColors.ranges());
+    for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : f.changedColors.ranges())
+        m_dirtyColors.add(r.first, r.second);
+    endUpdates();
+    return true;
+}
+
+ofShader &ofxGpuThicklines::prepareDraw() {
+    m_curvesShader.begin();
+    m_shaderBegun = true;
+    return m_curvesShader;
+}
+
+void ofxGpuThicklines::draw(float lineWidth, bool perspective, ofVec2f viewportSize) {
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    m_totalBytesUploaded += uploadIndices();
+    if(m_joinTopologyChanged)
+        m_totalBytesUploaded += updateJoins();
+    if(m_edgeTableStale)
+        m_totalBytesUploaded += updateEdgeTable();
+    if(m_renderBackend == BACKEND_NONE) {
+        m_shaderBegun = false;
+        endFrame(t0);
+        return;
+    }
+    ofFill();
+    if(! m_shaderBegun)
+        m_curvesShader.begin();
+    if(viewportSize.x == 0)
+        viewportSize = ofVec2f(ofGetWidth(), ofGetHeight());
+    m_curvesShader.setUniform2f("viewportSize", viewportSize);
+    m_curvesShader.setUniform1i("perspective", (int)perspective);
+    m_curvesShader.setUniform1f("thickness", lineWidth);
+    if(m_vertexFormat.positions == POSITIONS_UNORM16 && ! m_positionRange.empty()) {
+        m_curvesShader.setUniform3f("positionOffset", m_positionRange.min);
+        m_curvesShader.setUniform3f("positionScale", m_positionRange.max - m_positionRange.min);
+    }
+    if(usesChunks()) {
+        selectChunks(ofGetCurrentMatrix(OF_MATRIX_MODELVIEW) * ofGetCurrentMatrix(OF_MATRIX_PROJECTION),
+                     lineWidth, perspective, viewportSize);
+    }
+    else {
+        m_drawRanges.resize(1);
+        m_drawRanges[0].assign(1, std::make_pair(size_t(0), m_indexCount));
+        removeHiddenRanges();
+    }
+    bindEdgeTable(true);
+    beginGpuTiming();
+    for(size_t level=0; level<m_drawRanges.size(); ++level) {
+        if(! m_drawRanges[level].empty())
+            drawIndexRanges(level == 0 ? m_indexBuffer : m_lodLevels[level].buffer, m_drawRanges[level]);
+        for(const std::pair<size_t, size_t> &r : m_drawRanges[level])
+            m_frameStats.drawnIndices += r.second - r.first;
+    }
+    endGpuTiming();
+    bindEdgeTable(false);
+    m_curvesShader.end();
+
+    m_shaderBegun = false;
+    endFrame(t0);
+}
+
+// GL objects of the instanced backend, shared between copies like ofVbo's buffers
+struct ofxGpuThicklines::InstancedResources {
+    GLuint vao;
+    GLuint textures[4]; // positions, colors, texcoords, joins
+    InstancedResources() {
+        glGenVertexArrays(1, &vao);
+        glGenTextures(4, textures);
+    }
+    ~InstancedResources() {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteTextures(4, textures);
+    }
+};
+
+namespace {
+    // texture units for the buffer textures of the instanced backend, above the ones
+    // a custom fragment shader is likely to use, and the edge table after them
+    const int firstBufferTextureUnit = 8;
+    const int edgeTableTextureUnit = firstBufferTextureUnit + 4;
+}
+
+void ofxGpuThicklines::setRenderBackend(RenderBackend backend) {
+    m_renderBackend = backend;
+}
+
+void ofxGpuThicklines::bindInstancedBuffers() {
+    if(! m_instanced)
+        m_instanced = std::make_shared<InstancedResources>();
+
+    // the instanced shader reads the same buffers the geometry shader path has as attributes.
+    // float positions are 3 texels of one channel each, packed ones a single texel.
+    GLenum positionFormat = GL_R32F;
+    if(m_vertexFormat.positions == POSITIONS_HALF) positionFormat = GL_RGBA16F;
+    else if(m_vertexFormat.positions == POSITIONS_UNORM16) positionFormat = GL_RGBA16;
+    glBindTexture(GL_TEXTURE_BUFFER, m_instanced->textures[0]);
+    glTexBuffer(GL_TEXTURE_BUFFER, positionFormat, vboBuffer(ofShader::POSITION_ATTRIBUTE)->getId());
+    glBindTexture(GL_TEXTURE_BUFFER, m_instanced->textures[1]);
+    glTexBuffer(GL_TEXTURE_BUFFER, m_vertexFormat.colors == COLORS_FLOAT ? GL_RGBA32F : GL_RGBA8,
+                vboBuffer(m_colorLocation)->getId());
+    if(! m_texcoords.empty()) {
+        glBindTexture(GL_TEXTURE_BUFFER, m_instanced->textures[2]);
+        glTexBuffer(GL_TEXTURE_BUFFER, m_vertexFormat.texcoords == TEXCOORDS_FLOAT ? GL_RG32F : GL_RG16F,
+                    vboBuffer(m_texcoordLocation)->getId());
+    }
+    if(! m_joins.empty()) {
+        glBindTexture(GL_TEXTURE_BUFFER, m_instanced->textures[3]);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_curvesVbo.getAttributeBuffer(m_joinLocation).getId());
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // the index buffer doubles as per-instance attribute, one window of 4 (INDEX_LINES: 2) indices per segment
+    GLint segment = m_curvesShader.getAttributeLocation("segment");
+    glBindVertexArray(m_instanced->vao);
+    glEnableVertexAttribArray(segment);
+    glVertexAttribDivisor(segment, 1);
+    glBindVertexArray(0);
+}
+
+void ofxGpuThicklines::drawInstancedRange(ofBufferObject &buffer, size_t first, size_t count) {
+    // adjacency primitives are 4 apart, strips advance by one index per segment, lines are 2 apart
+    const bool strip = m_indexMode == INDEX_LINE_STRIP_ADJACENCY;
+    const int window = m_indexMode == INDEX_LINES ? 2 : 4;
+    if(count < size_t(window)) return;
+    const size_t instances = strip ? count - 3 : count / window;
+
+    for(int i=0; i<4; ++i) {
+        glActiveTexture(GL_TEXTURE0 + firstBufferTextureUnit + i);
+        glBindTexture(GL_TEXTURE_BUFFER, m_instanced->textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    m_curvesShader.setUniform1i("positionBuffer", firstBufferTextureUnit);
+    m_curvesShader.setUniform1i("colorBuffer", firstBufferTextureUnit + 1);
+    m_curvesShader.setUniform1i("texcoordBuffer", firstBufferTextureUnit + 2);
+    if(m_indexMode == INDEX_LINES)
+        m_curvesShader.setUniform1i("joinBuffer", firstBufferTextureUnit + 3);
+    m_curvesShader.setUniform1i("hasTexcoords", m_texcoords.empty() ? 0 : 1);
+    m_curvesShader.setUniform1i("restartIndex", m_shortIndices ? restartIndex16 : -1);
+
+    GLint segment = m_curvesShader.getAttributeLocation("segment");
+    glBindVertexArray(m_instanced->vao);
+    buffer.bind(GL_ARRAY_BUFFER);
+    glVertexAttribIPointer(segment, window, m_shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                           GLsizei((strip ? 1 : window) * indexSize()),
+                           reinterpret_cast<const void*>(first * indexSize()));
+    buffer.unbind(GL_ARRAY_BUFFER);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, ofxGpuThicklinesMath::verticesPerSegment, GLsizei(instances));
+    ++m_frameStats.drawCalls;
+    glBindVertexArray(0);
+
+    for(int i=0; i<4; ++i) {
+        glActiveTexture(GL_TEXTURE0 + firstBufferTextureUnit + i);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void ofxGpuThicklines::drawIndexRanges(ofBufferObject &buffer, const vector< std::pair<size_t, size_t> > &ranges) {
+    if(m_renderBackend == BACKEND_INSTANCED) {
+        for(const std::pair<size_t, size_t> &r : ranges)
+            drawInstancedRange(buffer, r.first, r.second - r.first);
+        return;
+    }
+    m_drawCounts.clear();
+    m_drawOffsets.clear();
+    for(const std::pair<size_t, size_t> &r : ranges) {
+        if(r.second <= r.first) continue;
+        m_drawCounts.push_back(GLsizei(r.second - r.first));
+        m_drawOffsets.push_back(reinterpret_cast<const void*>(r.first * indexSize()));
+    }
+    if(m_drawCounts.empty()) return;
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(m_shortIndices ? restartIndex16 : restartIndex);
+    m_curvesVbo.bind();
+    bindPackedAttributes(true);
+    buffer.bind(GL_ELEMENT_ARRAY_BUFFER);
+    GLenum primitive = GL_LINES_ADJACENCY;
+    if(m_indexMode == INDEX_LINE_STRIP_ADJACENCY) primitive = GL_LINE_STRIP_ADJACENCY;
+    else if(m_indexMode == INDEX_LINES) primitive = GL_LINES;
+    glMultiDrawElements(primitive, &m_drawCounts[0], m_shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                        &m_drawOffsets[0], GLsizei(m_drawCounts.size()));
+    ++m_frameStats.drawCalls;
+    bindPackedAttributes(false);
+    m_curvesVbo.unbind();
+    glDisable(GL_PRIMITIVE_RESTART);
+}
+
+void ofxGpuThicklines::bindPackedAttributes(bool enable) {
+    // on top of the attributes ofVbo bound, and taken away again before it unbinds, so that its
+    // vertex array object stays the way it knows it
+    struct Attribute {
+        bool own; // in one of our buffers
+        GLint location;
+        ofBufferObject &buffer;
+        size_t offset;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+    };
+    const bool inter = interleaved();
+    GLenum positionType = GL_FLOAT;
+    if(m_vertexFormat.positions == POSITIONS_HALF) positionType = GL_HALF_FLOAT;
+    else if(m_vertexFormat.positions == POSITIONS_UNORM16) positionType = GL_UNSIGNED_SHORT;
+    const bool floatColors = m_vertexFormat.colors == COLORS_FLOAT;
+    const bool floatTexcoords = m_vertexFormat.texcoords == TEXCOORDS_FLOAT;
+    const Attribute attributes[] = {
+        { inter || positionType != GL_FLOAT, ofShader::POSITION_ATTRIBUTE, inter ? m_interleavedVertices : m_packedPositions,
+          0, GLint(positionType == GL_FLOAT ? 3 : 4), positionType, GLboolean(m_vertexFormat.positions == POSITIONS_UNORM16) },
+        { inter || ! floatColors, m_colorLocation, inter ? m_interleavedVertices : m_packedColors,
+          inter ? positionBytes() : 0, 4, GLenum(floatColors ? GL_FLOAT : GL_UNSIGNED_BYTE), GLboolean(! floatColors) },
+        { (inter || ! floatTexcoords) && hasTexcoords(), m_texcoordLocation, inter ? m_interleavedVertices : m_packedTexcoords,
+          inter ? positionBytes() + colorBytes() : 0, 2, GLenum(floatTexcoords ? GL_FLOAT : GL_HALF_FLOAT), GL_FALSE }
+    };
+    const GLsizei stride = inter ? GLsizei(vertexStride()) : 0;
+    for(const Attribute &a : attributes) {
+        if(! a.own) continue;
+        if(enable) {
+            a.buffer.bind(GL_ARRAY_BUFFER);
+            glEnableVertexAttribArray(a.location);
+            glVertexAttribPointer(a.location, a.size, a.type, a.normalized, stride, reinterpret_cast<const void*>(a.offset));
+            a.buffer.unbind(GL_ARRAY_BUFFER);
+        }
+        else {
+            glDisableVertexAttribArray(a.location);
+        }
+    }
+}
+
+// the buffer texture of the edge table, shared between copies like the VBO
+struct ofxGpuThicklines::EdgeTexture {
+    GLuint id;
+    EdgeTexture() { glGenTextures(1, &id); }
+    ~EdgeTexture() { glDeleteTextures(1, &id); }
+};
+
+size_t ofxGpuThicklines::rebuildEdgeTable() {
+    m_edgeTableStale = false;
+    m_edgeCurves.clear();
+
+    // the segments of the live curves as packed keys, every curve writes its own part
+    const uint64_t noKey = packEdge(uint32_t(m_positions.size()), uint32_t(m_positions.size()));
+    vector<size_t> keyStart(m_curveSlots.size() + 1, 0);
+    for(CurveHandle h=0; h<m_curveSlots.size(); ++h) {
+        const CurveSlot &slot = m_curveSlots[h];
+        keyStart[h + 1] = keyStart[h] + (slot.live && slot.count > 0 ? curvePoints(slot) - 1 : 0);
+    }
+    vector<uint64_t> keys(keyStart.back());
+    ofxGpuThicklinesParallel::forRange(m_curveSlots.size(), [&](size_t begin, size_t end) {
+        for(size_t h=begin; h<end; ++h) {
+            const CurveSlot &slot = m_curveSlots[h];
+            for(size_t k=keyStart[h]; k<keyStart[h + 1]; ++k) {
+                unsigned int a = curvePoint(slot, k - keyStart[h]), b = curvePoint(slot, k - keyStart[h] + 1);
+                keys[k] = a != b ? packEdge(a, b) : noKey;
+            }
+        }
+    });
+    // the radix sort holds a second array of the keys
+    notePeakLoad(2 * keys.capacity() * sizeof(uint64_t) + keyStart.capacity() * sizeof(size_t));
+    ofxGpuThicklinesParallel::radixSort(keys, noKey);
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    if(! keys.empty() && keys.back() == noKey)
+        keys.pop_back();
+
+    // CSR by the smaller vertex, the keys are already in that order and their ranks are the ids
+    const size_t n = m_positions.size();
+    m_edgeTable.assign(n + 1 + 2 * keys.size(), 0);
+    unsigned int *starts = &m_edgeTable[0], *targets = starts + n + 1, *ids = targets + keys.size();
+    for(size_t e=0; e<keys.size(); ++e) {
+        ++starts[edgeFirst(keys[e]) + 1];
+        targets[e] = edgeSecond(keys[e]);
+        ids[e] = unsigned(e);
+    }
+    for(size_t v=0; v<n; ++v)
+        starts[v + 1] += starts[v];
+    notePeakLoad(keys.capacity() * sizeof(uint64_t) + keyStart.capacity() * sizeof(size_t));
+    return uploadEdgeTable();
+}
+
+size_t ofxGpuThicklines::updateEdgeTable() {
+    m_edgeTableStale = false;
+    const size_t n = m_positions.size();
+    if(m_edgeTable.size() <= n)
+        return rebuildEdgeTable();
+
+    // the segments of the curves placed since that the table doesn't have yet. Those of removed
+    // curves stay in it, their ids are left unused until `reset()`
+    vector<uint64_t> keys;
+    for(CurveHandle h : m_edgeCurves) {
+        const CurveSlot &slot = m_curveSlots[h];
+        if(! slot.live || slot.count == 0) continue;
+        for(size_t j=0; j+1<curvePoints(slot); ++j) {
+            unsigned int a = curvePoint(slot, j), b = curvePoint(slot, j + 1);
+            if(a != b && ofxGpuThicklinesMath::edgeID(m_edgeTable.data(), n, a, b) < 0)
+                keys.push_back(packEdge(a, b));
+        }
+    }
+    m_edgeCurves.clear();
+    if(keys.empty()) return 0;
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // merged into the segments of their smaller vertex, with the ids after the last one. The
+    // segments of the vertices in between move as a block
+    const unsigned int *starts = &m_edgeTable[0];
+    const size_t entries = starts[n], total = entries + keys.size();
+    const unsigned int *targets = starts + n + 1, *ids = targets + entries;
+    vector<unsigned int> table(n + 1 + 2 * total);
+    unsigned int *newStarts = &table[0], *newTargets = newStarts + n + 1, *newIds = newTargets + total;
+    size_t shift = 0, v = 0, copied = 0; // segments added so far, next start to write, old segments moved
+    for(size_t k=0; k<keys.size();) {
+        const uint32_t lo = edgeFirst(keys[k]);
+        for(; v<=lo; ++v)
+            newStarts[v] = unsigned(starts[v] + shift);
+        std::copy(targets + copied, targets + starts[lo], newTargets + copied + shift);
+        std::copy(ids + copied, ids + starts[lo], newIds + copied + shift);
+        size_t e = starts[lo], out = starts[lo] + shift;
+        for(; k<keys.size() && edgeFirst(keys[k]) == lo; ++out) {
+            if(e < starts[lo + 1] && targets[e] < edgeSecond(keys[k])) {
+                newTargets[out] = targets[e];
+                newIds[out] = ids[e++];
+            }
+            else {
+                newTargets[out] = edgeSecond(keys[k]);
+                newIds[out] = unsigned(entries + k++);
+                ++shift;
+            }
+        }
+        for(; e<starts[lo + 1]; ++e, ++out) {
+            newTargets[out] = targets[e];
+            newIds[out] = ids[e];
+        }
+        copied = starts[lo + 1];
+    }
+    for(; v<=n; ++v)
+        newStarts[v] = unsigned(starts[v] + shift);
+    std::copy(targets + copied, targets + entries, newTargets + copied + shift);
+    std::copy(ids + copied, ids + entries, newIds + copied + shift);
+    m_edgeTable.swap(table);
+    return uploadEdgeTable();
+}
+
+size_t ofxGpuThicklines::uploadEdgeTable() {
+    const size_t bytes = m_edgeTable.size() * sizeof(unsigned int);
+    if(m_renderBackend == BACKEND_NONE)
+        return bytes;
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if(maxTexels > 0 && m_edgeTable.size() > size_t(maxTexels))
+        ofLogWarning("ofxGpuThicklines") << "the edge table of " << m_edgeTable.size() << " entries exceeds the "
+                                         << maxTexels << " texels of a buffer texture, use ofxGpuThicklinesPaged";
+    if(! m_edgeTexture)
+        m_edgeTexture = std::make_shared<EdgeTexture>();
+    if(! m_edgeBuffer.isAllocated())
+        m_edgeBuffer.allocate();
+    m_edgeBuffer.setData(bytes, m_edgeTable.data(), GL_STATIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, m_edgeTexture->id);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_edgeBuffer.getId());
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return bytes;
+}
+
+void ofxGpuThicklines::rebuildPickSegments() {
+    m_pickStale = false;
+    m_pickCurveStart.assign(m_curveSlots.size() + 1, 0);
+    for(CurveHandle h=0; h<m_curveSlots.size(); ++h) {
+        const CurveSlot &slot = m_curveSlots[h];
+        m_pickCurveStart[h + 1] = m_pickCurveStart[h] + (slot.live && slot.count > 0 ? curvePoints(slot) - 1 : 0);
+    }
+    vector<unsigned int> segments(2 * m_pickCurveStart.back());
+    ofxGpuThicklinesParallel::forRange(m_curveSlots.size(), [&](size_t begin, size_t end) {
+        for(size_t h=begin; h<end; ++h) {
+            const CurveSlot &slot = m_curveSlots[h];
+            for(size_t s=m_pickCurveStart[h]; s<m_pickCurveStart[h + 1]; ++s) {
+                segments[2 * s] = curvePoint(slot, s - m_pickCurveStart[h]);
+                segments[2 * s + 1] = curvePoint(slot, s - m_pickCurveStart[h] + 1);
+            }
+        }
+    });
+    m_picker.setSegments(std::move(segments), m_positions.size());
+    for(CurveHandle h=0; h<m_curveSlots.size(); ++h) {
+        if(m_curveSlots[h].live && ! curveShown(h))
+            m_picker.setEnabled(m_pickCurveStart[h], m_pickCurveStart[h + 1], false);
+    }
+}
+
+ofxGpuThicklines::Pick ofxGpuThicklines::pick(ofVec2f screenPoint, const ofMatrix4x4 &modelViewProjection,
+                                              ofRectangle viewport, float radius) {
+    // curve edits and moves not yet through `endUpdates()` count too
+    if(m_pickStale || ! m_dirtyIndices.empty() || m_indexBufferResized)
+        rebuildPickSegments();
+    for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : m_dirtyPositions.coalesce())
+        m_picker.moved(r.first, r.second);
+    if(viewport.width <= 0 || viewport.height <= 0)
+        viewport = ofRectangle(0, 0, ofGetWidth(), ofGetHeight());
+
+    ofxGpuThicklinesPicker::Hit hit = m_picker.pick(m_positions.data(), screenPoint, modelViewProjection, viewport, radius);
+    Pick p = Pick();
+    p.hit = hit.hit;
+    if(hit.hit) {
+        // the last curve starting at or before the segment, skipping the empty ones in between
+        p.curve = std::upper_bound(m_pickCurveStart.begin(), m_pickCurveStart.end(), hit.segment) - m_pickCurveStart.begin() - 1;
+        p.segment = hit.segment - m_pickCurveStart[p.curve];
+        p.t = hit.t;
+        p.distance = hit.distance;
+    }
+    return p;
+}
+
+void ofxGpuThicklines::bindEdgeTable(bool bind) {
+    if(! m_edgeTexture) return;
+    glActiveTexture(GL_TEXTURE0 + edgeTableTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, bind ? m_edgeTexture->id : 0);
+    glActiveTexture(GL_TEXTURE0);
+    if(bind) {
+        m_curvesShader.setUniform1i("edgeTable", edgeTableTextureUnit);
+        m_curvesShader.setUniform1i("edgeTargets", int(m_positions.size() + 1));
+        m_curvesShader.setUniform1i("edgeIds", int(m_positions.size() + 1 + numEdges()));
+        m_curvesShader.setUniform1i("edgeIdBase", int(m_edgeIdBase));
+    }
+}
+
+int ofxGpuThicklines::edgeId(size_t a, size_t b) const {
+    if(a >= m_positions.size() || b >= m_positions.size() || m_edgeTable.size() <= m_positions.size())
+        return -1;
+    return ofxGpuThicklinesMath::edgeID(m_edgeTable.data(), m_positions.size(), unsigned(a), unsigned(b), m_edgeIdBase);
+}
+
+void ofxGpuThicklines::setCulling(bool enabled) {
+    m_culling = enabled;
+    m_chunksStale = true;
+}
+
+size_t ofxGpuThicklines::chunkIndices() const {
+    // one segment per 4 indices, per index in strips, per 2 indices in INDEX_LINES
+    size_t stride = 4;
+    if(m_indexMode == INDEX_LINE_STRIP_ADJACENCY) stride = 1;
+    else if(m_indexMode == INDEX_LINES) stride = 2;
+    return cullingChunkSegments * stride;
+}
+
+void ofxGpuThicklines::chunkRange(size_t chunk, size_t &begin, size_t &end) const {
+    begin = chunk * chunkIndices();
+    // the segments starting near the end of a strip chunk need the 3 indices after it
+    size_t overlap = m_indexMode == INDEX_LINE_STRIP_ADJACENCY ? 3 : 0;
+    end = std::min(begin + chunkIndices() + overlap, m_indexCount);
+}
+
+ofxGpuThicklinesCulling::Box ofxGpuThicklines::chunkBounds(size_t chunk) const {
+    size_t begin, end;
+    chunkRange(chunk, begin, end);
+    ofxGpuThicklinesCulling::Box box;
+    for(size_t i=begin; i<end; ++i) {
+        if(m_indices[i] != restartIndex)
+            box.add(m_positions[m_indices[i]]);
+    }
+    return box;
+}
+
+void ofxGpuThicklines::rebuildChunks() {
+    m_chunksStale = false;
+    m_lodStale = true;
+    const size_t numChunks = (m_indexCount + chunkIndices() - 1) / chunkIndices();
+    m_chunkBoxes.resize(numChunks);
+    ofxGpuThicklinesParallel::forRange(numChunks, [&](size_t begin, size_t end) {
+        for(size_t c=begin; c<end; ++c)
+            m_chunkBoxes[c] = chunkBounds(c);
+    }, 16);
+
+    // vertex -> chunks, counting sort with every chunk counted once per vertex
+    const size_t n = m_positions.size();
+    const unsigned int none = 0xffffffffu;
+    vector<unsigned int> lastChunk(n, none);
+    m_vertexChunkStart.assign(n + 1, 0);
+    for(size_t c=0; c<numChunks; ++c) {
+        size_t begin, end;
+        chunkRange(c, begin, end);
+        for(size_t i=begin; i<end; ++i) {
+            unsigned int v = m_indices[i];
+            if(v == restartIndex || lastChunk[v] == c) continue;
+            lastChunk[v] = c;
+            ++m_vertexChunkStart[v + 1];
+        }
+    }
+    for(size_t v=0; v<n; ++v)
+        m_vertexChunkStart[v + 1] += m_vertexChunkStart[v];
+    m_vertexChunks.resize(m_vertexChunkStart[n]);
+    vector<unsigned int> fill(m_vertexChunkStart.begin(), m_vertexChunkStart.end() - 1);
+    notePeakLoad((lastChunk.capacity() + fill.capacity()) * sizeof(unsigned int));
+    lastChunk.assign(n, none);
+    for(size_t c=0; c<numChunks; ++c) {
+        size_t begin, end;
+        chunkRange(c, begin, end);
+        for(size_t i=begin; i<end; ++i) {
+            unsigned int v = m_indices[i];
+            if(v == restartIndex || lastChunk[v] == c) continue;
+            lastChunk[v] = c;
+            m_vertexChunks[fill[v]++] = c;
+        }
+    }
+
+    m_chunkBvh.build(m_chunkBoxes);
+    ofLogVerbose("ofxGpuThicklines") << "culling " << numChunks << " chunks with " << m_chunkBvh.numNodes() << " nodes";
+}
+
+size_t ofxGpuThicklines::refitChunks() {
+    if(m_dirtyPositions.empty()) return 0;
+    if(! usesChunks() || m_chunksStale || m_chunkBoxes.empty() || ! m_dirtyIndices.empty() || m_indexBufferResized) {
+        // the chunks are rebuilt on `draw()`, or were never built, the levels of detail with them
+        m_lodStale = true;
+        return 0;
+    }
+    vector<size_t> changed;
+    for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : m_dirtyPositions.coalesce()) {
+        for(size_t v=r.first; v<r.second; ++v)
+            changed.insert(changed.end(), m_vertexChunks.begin() + m_vertexChunkStart[v],
+                           m_vertexChunks.begin() + m_vertexChunkStart[v + 1]);
+    }
+    if(changed.empty()) return 0;
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    ofxGpuThicklinesParallel::forRange(changed.size(), [&](size_t begin, size_t end) {
+        for(size_t k=begin; k<end; ++k)
+            m_chunkBoxes[changed[k]] = chunkBounds(changed[k]);
+    }, 16);
+    m_chunkBvh.refit(m_chunkBoxes);
+    return refitLod(changed);
+}
+
+void ofxGpuThicklines::selectChunks(const ofMatrix4x4 &modelViewProjection, float lineWidth, bool perspective,
+                                    ofVec2f viewportSize) {
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    if(m_chunksStale)
+        rebuildChunks();
+
+    m_visibleChunks.clear();
+    if(m_culling) {
+        m_chunkBvh.query(ofxGpuThicklinesCulling::Frustum(modelViewProjection, lineWidth, perspective, viewportSize),
+                         m_visibleChunks);
+    }
+    else {
+        for(size_t c=0; c<m_chunkBoxes.size(); ++c)
+            m_visibleChunks.push_back(c);
+    }
+
+    const bool lod = m_lodTolerance > 0 && m_indexMode != INDEX_LINES;
+    if(lod && m_lodStale)
+        rebuildLodErrors();
+    m_drawRanges.resize(lod ? lodLevels : 1);
+    for(vector< std::pair<size_t, size_t> > &ranges : m_drawRanges)
+        ranges.clear();
+    size_t drawn = 0, simplified = 0, numRanges = 0;
+    for(size_t c : m_visibleChunks) {
+        // the coarsest level whose error stays below the tolerance
+        int level = 0;
+        if(lod) {
+            float scale = ofxGpuThicklinesLod::screenScale(modelViewProjection, viewportSize, m_chunkBoxes[c]);
+            float error = m_lodBaseError;
+            while(level + 1 < lodLevels && error * scale <= m_lodTolerance) {
+                ++level;
+                error *= 4;
+            }
+        }
+        size_t begin, end;
+        if(level == 0) {
+            chunkRange(c, begin, end);
+        }
+        else {
+            if(! m_lodLevels[level].built)
+                buildLodLevel(level);
+            begin = m_lodLevels[level].chunkOffsets[c];
+            end = m_lodLevels[level].chunkOffsets[c + 1];
+            ++simplified;
+        }
+        // neighbouring chunks of a level become one range
+        vector< std::pair<size_t, size_t> > &ranges = m_drawRanges[level];
+        if(! ranges.empty() && ranges.back().second >= begin) {
+            ranges.back().second = std::max(ranges.back().second, end);
+        }
+        else {
+            ranges.push_back(std::make_pair(begin, end));
+        }
+    }
+    removeHiddenRanges();
+    for(const vector< std::pair<size_t, size_t> > &ranges : m_drawRanges) {
+        for(const std::pair<size_t, size_t> &r : ranges)
+            drawn += r.second - r.first;
+        numRanges += ranges.size();
+    }
+
+    m_cullingStats.chunks = m_chunkBoxes.size();
+    m_cullingStats.visibleChunks = m_visibleChunks.size();
+    m_cullingStats.simplifiedChunks = simplified;
+    m_cullingStats.drawnIndices = drawn;
+    m_cullingStats.drawRanges = numRanges;
+    m_cullingStats.milliseconds = (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+}
+
+namespace {
+    // `ranges` without the parts in `hidden`, which is sorted and free of overlaps
+    void subtractRanges(vector< std::pair<size_t, size_t> > &ranges, const vector< std::pair<size_t, size_t> > &hidden,
+                        vector< std::pair<size_t, size_t> > &scratch) {
+        scratch.clear();
+        for(const std::pair<size_t, size_t> &r : ranges) {
+            size_t begin = r.first;
+            // the first hidden range ending after `begin`
+            vector< std::pair<size_t, size_t> >::const_iterator it = std::upper_bound(hidden.begin(), hidden.end(), begin,
+                [](size_t i, const std::pair<size_t, size_t> &h) { return i < h.second; });
+            for(; it != hidden.end() && it->first < r.second; ++it) {
+                if(it->first > begin)
+                    scratch.push_back(std::make_pair(begin, it->first));
+                begin = std::max(begin, it->second);
+            }
+            if(begin < r.second)
+                scratch.push_back(std::make_pair(begin, r.second));
+        }
+        ranges.swap(scratch);
+    }
+}
+
+void ofxGpuThicklines::removeHiddenRanges() {
+    if(m_hiddenStale)
+        rebuildHiddenRanges();
+    if(m_hiddenRanges.empty()) return;
+    for(size_t level=0; level<m_drawRanges.size(); ++level) {
+        if(m_drawRanges[level].empty()) continue;
+        if(level == 0) {
+            subtractRanges(m_drawRanges[0], m_hiddenRanges, m_rangeScratch);
+            continue;
+        }
+        // simplified levels list their hidden pieces when first drawn after their pieces changed,
+        // visibilityChanged() keeps the list up to date after that
+        if(m_lodLevels[level].hiddenStale)
+            listHiddenPieces(level);
+        subtractRanges(m_drawRanges[level], m_lodLevels[level].hiddenRanges, m_rangeScratch);
+    }
+}
+
+void ofxGpuThicklines::listHiddenPieces(size_t level) {
+    LodLevel &lod = m_lodLevels[level];
+    lod.hiddenStale = false;
+    // one range per nonempty piece rather than runs of them, so that visibilityChanged() can
+    // drop the pieces of a curve shown again one by one
+    lod.hiddenRanges.clear();
+    lod.curvePieceStart.assign(m_curveSlots.size() + 1, 0);
+    for(size_t k=0; k<lod.pieceCurves.size(); ++k) {
+        if(lod.pieceOffsets[k] == lod.pieceOffsets[k + 1]) continue;
+        ++lod.curvePieceStart[lod.pieceCurves[k] + 1];
+        if(! curveShown(lod.pieceCurves[k]))
+            lod.hiddenRanges.push_back(std::make_pair(lod.pieceOffsets[k], lod.pieceOffsets[k + 1]));
+    }
+    // curve -> pieces, counting sort
+    for(size_t h=0; h<m_curveSlots.size(); ++h)
+        lod.curvePieceStart[h + 1] += lod.curvePieceStart[h];
+    lod.curvePieces.resize(lod.curvePieceStart.back());
+    vector<size_t> fill(lod.curvePieceStart.begin(), lod.curvePieceStart.end() - 1);
+    for(size_t k=0; k<lod.pieceCurves.size(); ++k) {
+        if(lod.pieceOffsets[k] < lod.pieceOffsets[k + 1])
+            lod.curvePieces[fill[lod.pieceCurves[k]]++] = k;
+    }
+}
+
+void ofxGpuThicklines::setLevelOfDetail(float pixelTolerance) {
+    if(pixelTolerance > 0 && ! usesChunks())
+        m_chunksStale = true;
+    m_lodTolerance = std::max(0.0f, pixelTolerance);
+}
+
+size_t ofxGpuThicklines::curvePoints(const CurveSlot &slot) const {
+    if(slot.count == 0) return 0;
+    if(m_indexMode == INDEX_LINE_STRIP_ADJACENCY) return slot.count - 3;
+    if(m_indexMode == INDEX_LINES) return slot.count / 2 + 1;
+    return slot.count / 4 + 1;
+}
+
+unsigned int ofxGpuThicklines::curvePoint(const CurveSlot &slot, size_t j) const {
+    const unsigned int *block = &m_indices[slot.offset];
+    if(m_indexMode == INDEX_LINE_STRIP_ADJACENCY)
+        return block[1 + j];
+    // every segment starts at point j, the last one also ends at the last point
+    size_t stride = m_indexMode == INDEX_LINES ? 2 : 4;
+    size_t first = m_indexMode == INDEX_LINES ? 0 : 1;
+    if(j + 1 < curvePoints(slot))
+        return block[stride * j + first];
+    return block[stride * (j - 1) + first + 1];
+}
+
+void ofxGpuThicklines::rebuildLodErrors() {
+    m_lodStale = false;
+    m_lodLevels.clear();
+    m_lodLevels.resize(lodLevels);
+    for(LodLevel &level : m_lodLevels) {
+        level.built = false;
+        level.hiddenStale = true;
+    }
+
+    // live curves in index buffer order, for finding the curves of a chunk
+    m_slotsByOffset.clear();
+    for(CurveHandle h=0; h<m_curveSlots.size(); ++h) {
+        if(m_curveSlots[h].live && m_curveSlots[h].count > 0)
+            m_slotsByOffset.push_back(h);
+    }
+    std::sort(m_slotsByOffset.begin(), m_slotsByOffset.end(), [&](CurveHandle a, CurveHandle b) {
+        return m_curveSlots[a].offset < m_curveSlots[b].offset;
+    });
+    m_lodErrorOffsets.assign(m_curveSlots.size(), 0);
+    size_t total = 0;
+    for(CurveHandle h : m_slotsByOffset) {
+        m_lodErrorOffsets[h] = total;
+        total += curvePoints(m_curveSlots[h]);
+    }
+    m_lodErrors.resize(total);
+    ofxGpuThicklinesParallel::forRange(m_slotsByOffset.size(), [&](size_t begin, size_t end) {
+        vector<unsigned int> points;
+        for(size_t k=begin; k<end; ++k)
+            lodCurveErrors(m_slotsByOffset[k], points);
+    }, 64);
+
+    // level 1 is a small fraction of the scene, the coarsest a sixteenth of it
+    ofxGpuThicklinesCulling::Box scene;
+    for(const ofxGpuThicklinesCulling::Box &box : m_chunkBoxes)
+        scene.add(box);
+    m_lodBaseError = scene.empty() ? 0.0f : (scene.max - scene.min).length() / 65536.0f;
+}
+
+void ofxGpuThicklines::lodCurveErrors(CurveHandle h, vector<unsigned int> &points) {
+    const CurveSlot &slot = m_curveSlots[h];
+    points.resize(curvePoints(slot));
+    for(size_t j=0; j<points.size(); ++j)
+        points[j] = curvePoint(slot, j);
+    ofxGpuThicklinesLod::douglasPeuckerErrors(&m_positions[0], &points[0], points.size(),
+                                              &m_lodErrors[m_lodErrorOffsets[h]]);
+}
+
+size_t ofxGpuThicklines::refitLod(const vector<size_t> &chunks) {
+    if(m_lodStale || m_lodLevels.empty()) return 0; // built from scratch when next used
+    const size_t chunkSize = chunkIndices();
+    // the curves in the chunks: the errors of all their points depend on the moved ones
+    vector<CurveHandle> curves;
+    for(size_t c : chunks) {
+        const size_t chunkBegin = c * chunkSize, chunkEnd = chunkBegin + chunkSize;
+        vector<CurveHandle>::const_iterator it = std::upper_bound(m_slotsByOffset.begin(), m_slotsByOffset.end(),
+            chunkBegin, [&](size_t i, CurveHandle h) { return i < m_curveSlots[h].offset + m_curveSlots[h].count; });
+        for(; it != m_slotsByOffset.end() && m_curveSlots[*it].offset < chunkEnd; ++it)
+            curves.push_back(*it);
+    }
+    std::sort(curves.begin(), curves.end());
+    curves.erase(std::unique(curves.begin(), curves.end()), curves.end());
+    ofxGpuThicklinesParallel::forRange(curves.size(), [&](size_t begin, size_t end) {
+        vector<unsigned int> points;
+        for(size_t k=begin; k<end; ++k)
+            lodCurveErrors(curves[k], points);
+    }, 64);
+
+    // and the chunks those curves reach into. The base error stays that of the last rebuild
+    vector<size_t> rebuilt;
+    for(CurveHandle h : curves) {
+        const CurveSlot &slot = m_curveSlots[h];
+        for(size_t c=slot.offset / chunkSize; c<=(slot.offset + slot.count - 1) / chunkSize; ++c)
+            rebuilt.push_back(c);
+    }
+    std::sort(rebuilt.begin(), rebuilt.end());
+    rebuilt.erase(std::unique(rebuilt.begin(), rebuilt.end()), rebuilt.end());
+    size_t bytes = 0;
+    for(int level=1; level<lodLevels; ++level) {
+        if(m_lodLevels[level].built)
+            bytes += rebuildLodChunks(level, rebuilt);
+    }
+    return bytes;
+}
+
+namespace {
+    // a piece of a simplified curve in the index layout of `mode`, with `prev` and `next` as
+    // the neighbours of its ends
+    void writeCurvePiece(ofxGpuThicklines::IndexMode mode, const vector<unsigned int> &points,
+                         unsigned int prev, unsigned int next, vector<unsigned int> &out) {
+        const size_t n = points.size();
+        if(mode == ofxGpuThicklines::INDEX_LINE_STRIP_ADJACENCY) {
+            out.push_back(prev);
+            out.insert(out.end(), points.begin(), points.end());
+            out.push_back(next);
+            out.push_back(restartIndex);
+            return;
+        }
+        for(size_t i=0; i+1<n; ++i) {
+            out.push_back(i == 0 ? prev : points[i - 1]);
+            out.push_back(points[i]);
+            out.push_back(points[i + 1]);
+            out.push_back(i + 2 < n ? points[i + 2] : next);
+        }
+    }
+}
+
+void ofxGpuThicklines::buildLodLevel(int level) {
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    LodLevel &lod = m_lodLevels[level];
+    const float tolerance = m_lodBaseError * float(1 << (2 * (level - 1)));
+    const size_t numChunks = m_chunkBoxes.size();
+
+    vector< vector<unsigned int> > pieces(numChunks);
+    vector< vector< std::pair<CurveHandle, size_t> > > pieceStarts(numChunks); // per chunk: curve, offset in pieces[c]
+    ofxGpuThicklinesParallel::forRange(numChunks, [&](size_t begin, size_t end) {
+        vector<unsigned int> kept;
+        for(size_t c=begin; c<end; ++c)
+            buildLodChunk(tolerance, c, pieces[c], pieceStarts[c], kept);
+    }, 1);
+
+    lod.chunkOffsets.resize(numChunks + 1);
+    lod.chunkOffsets[0] = 0;
+    for(size_t c=0; c<numChunks; ++c)
+        lod.chunkOffsets[c + 1] = lod.chunkOffsets[c] + pieces[c].size();
+    lod.indices.resize(lod.chunkOffsets[numChunks]);
+    ofxGpuThicklinesParallel::forRange(numChunks, [&](size_t begin, size_t end) {
+        for(size_t c=begin; c<end; ++c) {
+            if(! pieces[c].empty())
+                memcpy(&lod.indices[lod.chunkOffsets[c]], &pieces[c][0], pieces[c].size() * sizeof(unsigned int));
+        }
+    }, 16);
+    lod.pieceOffsets.clear();
+    lod.pieceCurves.clear();
+    for(size_t c=0; c<numChunks; ++c) {
+        for(const std::pair<CurveHandle, size_t> &p : pieceStarts[c]) {
+            lod.pieceCurves.push_back(p.first);
+            lod.pieceOffsets.push_back(lod.chunkOffsets[c] + p.second);
+        }
+    }
+    lod.pieceOffsets.push_back(lod.indices.size());
+    lod.hiddenStale = true;
+
+    if(! lod.buffer.isAllocated())
+        lod.buffer.allocate();
+    if(! lod.indices.empty()) {
+        lod.buffer.setData(lod.indices.size() * indexSize(), nullptr, GL_STATIC_DRAW);
+        uploadIndexRange(lod.buffer, lod.indices, 0, lod.indices.size());
+        m_totalBytesUploaded += lod.indices.size() * indexSize();
+    }
+    lod.built = true;
+    ofLogVerbose("ofxGpuThicklines") << "built level of detail " << level << ": " << lod.indices.size() << " of "
+                                     << m_indexCount << " indices in " << (ofGetElapsedTimeMicros() - t0) / 1000.0f << " ms";
+}
+
+void ofxGpuThicklines::buildLodChunk(float tolerance, size_t c, vector<unsigned int> &out,
+                                     vector< std::pair<CurveHandle, size_t> > &starts, vector<unsigned int> &kept) const {
+    // the segments starting in a chunk are simplified on their own, with the chunk borders kept
+    // so that the pieces of a curve still meet
+    const size_t chunkSize = chunkIndices();
+    const size_t stride = chunkSize / cullingChunkSegments;
+    const size_t chunkBegin = c * chunkSize, chunkEnd = chunkBegin + chunkSize;
+    // the first curve ending after the start of the chunk
+    vector<CurveHandle>::const_iterator it = std::upper_bound(m_slotsByOffset.begin(), m_slotsByOffset.end(),
+        chunkBegin, [&](size_t i, CurveHandle h) { return i < m_curveSlots[h].offset + m_curveSlots[h].count; });
+    for(; it != m_slotsByOffset.end() && m_curveSlots[*it].offset < chunkEnd; ++it) {
+        const CurveSlot &slot = m_curveSlots[*it];
+        const float *errors = &m_lodErrors[m_lodErrorOffsets[*it]];
+        const size_t n = curvePoints(slot);
+        size_t first = slot.offset >= chunkBegin ? 0 : (chunkBegin - slot.offset + stride - 1) / stride;
+        size_t last = std::min(n - 1, (chunkEnd - slot.offset + stride - 1) / stride);
+        if(first >= last) continue;
+        kept.clear();
+        kept.push_back(curvePoint(slot, first));
+        for(size_t j=first+1; j<last; ++j) {
+            if(errors[j] > tolerance)
+                kept.push_back(curvePoint(slot, j));
+        }
+        kept.push_back(curvePoint(slot, last));
+        starts.push_back(std::make_pair(*it, out.size()));
+        writeCurvePiece(m_indexMode, kept, curvePoint(slot, first > 0 ? first - 1 : 0),
+                        curvePoint(slot, last + 1 < n ? last + 1 : n - 1), out);
+    }
+}
+
+size_t ofxGpuThicklines::rebuildLodChunks(int level, const vector<size_t> &chunks) {
+    if(chunks.empty()) return 0;
+    LodLevel &lod = m_lodLevels[level];
+    const float tolerance = m_lodBaseError * float(1 << (2 * (level - 1)));
+    const size_t numChunks = m_chunkBoxes.size();
+    vector< vector<unsigned int> > pieces(chunks.size());
+    vector< vector< std::pair<CurveHandle, size_t> > > pieceStarts(chunks.size());
+    ofxGpuThicklinesParallel::forRange(chunks.size(), [&](size_t begin, size_t end) {
+        vector<unsigned int> kept;
+        for(size_t k=begin; k<end; ++k)
+            buildLodChunk(tolerance, chunks[k], pieces[k], pieceStarts[k], kept);
+    }, 1);
+
+    // the new pieces in place of the old ones, the other chunks move along
+    vector<unsigned int> indices;
+    vector<size_t> chunkOffsets(numChunks + 1), pieceOffsets;
+    vector<CurveHandle> pieceCurves;
+    indices.reserve(lod.indices.size());
+    pieceOffsets.reserve(lod.pieceOffsets.size());
+    pieceCurves.reserve(lod.pieceCurves.size());
+    size_t next = 0, piece = 0;
+    for(size_t c=0; c<numChunks; ++c) {
+        chunkOffsets[c] = indices.size();
+        const size_t oldBegin = lod.chunkOffsets[c], oldEnd = lod.chunkOffsets[c + 1];
+        if(next < chunks.size() && chunks[next] == c) {
+            for(const std::pair<CurveHandle, size_t> &p : pieceStarts[next]) {
+                pieceCurves.push_back(p.first);
+                pieceOffsets.push_back(chunkOffsets[c] + p.second);
+            }
+            indices.insert(indices.end(), pieces[next].begin(), pieces[next].end());
+            ++next;
+            for(; lod.pieceOffsets[piece] < oldEnd; ++piece) ;
+            continue;
+        }
+        for(; lod.pieceOffsets[piece] < oldEnd; ++piece) {
+            pieceCurves.push_back(lod.pieceCurves[piece]);
+            pieceOffsets.push_back(lod.pieceOffsets[piece] - oldBegin + chunkOffsets[c]);
+        }
+        indices.insert(indices.end(), lod.indices.begin() + oldBegin, lod.indices.begin() + oldEnd);
+    }
+    chunkOffsets[numChunks] = indices.size();
+    pieceOffsets.push_back(indices.size());
+
+    // everything from the first rebuilt chunk on moved unless the level kept its size, then only
+    // the rebuilt chunks changed and the ones between them
+    const size_t first = chunkOffsets[chunks.front()];
+    const bool sameSize = indices.size() == lod.indices.size();
+    const size_t last = sameSize ? chunkOffsets[chunks.back() + 1] : indices.size();
+    lod.indices.swap(indices);
+    lod.chunkOffsets.swap(chunkOffsets);
+    lod.pieceOffsets.swap(pieceOffsets);
+    lod.pieceCurves.swap(pieceCurves);
+    lod.hiddenStale = true;
+    if(lod.indices.empty()) return 0;
+    if(! sameSize && m_renderBackend != BACKEND_NONE)
+        lod.buffer.setData(lod.indices.size() * indexSize(), nullptr, GL_STATIC_DRAW);
+    uploadIndexRange(lod.buffer, lod.indices, sameSize ? first : 0, last);
+    return (sameSize ? last - first : lod.indices.size()) * indexSize();
+}
+
+// GL_TIME_ELAPSED queries of the last frames. They belong to one instance: the frame numbers
+// and the history they are written to are its own, a copy starts its own queries when it first
+// draws
+struct ofxGpuThicklines::TimerQueries {
+    static const int count = 4; // frames the GPU may fall behind before one goes untimed
+    const ofxGpuThicklines *owner;
+    GLuint ids[count];
+    uint64_t frames[count];
+    bool pending[count];
+    bool running;
+    TimerQueries(const ofxGpuThicklines *owner) : owner(owner), running(false) {
+        glGenQueries(count, ids);
+        std::fill(pending, pending + count, false);
+    }
+    ~TimerQueries() {
+        glDeleteQueries(count, ids);
+    }
+};
+
+void ofxGpuThicklines::beginGpuTiming() {
+    if(! m_gpuTiming) return;
+    if(! m_timerQueries || m_timerQueries->owner != this) {
+        // timer queries are core since GL 3.3, older contexts before 3.0 leave the version at 0
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        bool core = major > 3 || (major == 3 && minor >= 3);
+        if(! core && ! ofGLCheckExtension("GL_ARB_timer_query")) {
+            ofLogVerbose("ofxGpuThicklines") << "no timer queries, GPU time is not measured";
+            m_gpuTiming = false;
+            return;
+        }
+        m_timerQueries = std::make_shared<TimerQueries>(this);
+    }
+    TimerQueries &q = *m_timerQueries;
+    for(int i=0; i<TimerQueries::count; ++i) {
+        if(! q.pending[i]) continue;
+        GLint available = 0;
+        glGetQueryObjectiv(q.ids[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(! available) continue;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(q.ids[i], GL_QUERY_RESULT, &nanoseconds);
+        q.pending[i] = false;
+        // the frames since are all in the history, unless it was cleared or has wrapped around
+        uint64_t age = m_frameStats.frame - q.frames[i];
+        if(age >= 1 && age <= m_statsHistory.size())
+            m_statsHistory[m_statsHistory.size() - age].gpuMs = nanoseconds / 1000000.0f;
+    }
+    int i = m_frameStats.frame % TimerQueries::count;
+    if(q.pending[i]) return; // rather than waiting for the GPU
+    glBeginQuery(GL_TIME_ELAPSED, q.ids[i]);
+    q.frames[i] = m_frameStats.frame;
+    q.pending[i] = q.running = true;
+}
+
+void ofxGpuThicklines::endGpuTiming() {
+    if(m_timerQueries && m_timerQueries->owner == this && m_timerQueries->running) {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_timerQueries->running = false;
+    }
+}
+
+void ofxGpuThicklines::endFrame(uint64_t drawStart) {
+    m_frameStats.bytesUploaded = m_totalBytesUploaded - m_frameStartBytes;
+    m_frameStats.indices = m_indexCount;
+    m_frameStats.segments = m_segmentCount;
+    m_frameStats.drawMs = (ofGetElapsedTimeMicros() - drawStart) / 1000.0f;
+    m_statsHistory.push(m_frameStats);
+
+    uint64_t next = m_frameStats.frame + 1;
+    m_frameStats = FrameStats();
+    m_frameStats.frame = next;
+    m_frameStats.gpuMs = -1;
+    m_frameStartBytes = m_totalBytesUploaded;
+}
+
+const ofxGpuThicklines::FrameStats &ofxGpuThicklines::lastFrameStats() const {
+    static const FrameStats none = FrameStats();
+    return m_statsHistory.empty() ? none : m_statsHistory.back();
+}
+
+ofxGpuThicklines::StatsSummary ofxGpuThicklines::statsSummary() const {
+    vector<float> bytes, setup, update, draw, gpu;
+    for(size_t i=0; i<m_statsHistory.size(); ++i) {
+        const FrameStats &f = m_statsHistory[i];
+        bytes.push_back(float(f.bytesUploaded));
+        setup.push_back(f.setupMs);
+        update.push_back(f.updateMs);
+        draw.push_back(f.drawMs);
+        if(f.gpuMs >= 0)
+            gpu.push_back(f.gpuMs);
+    }
+    StatsSummary summary;
+    summary.frames = m_statsHistory.size();
+    summary.gpuFrames = gpu.size();
+    summary.bytesUploaded = ofxGpuThicklinesStats::summarize(std::move(bytes));
+    summary.setupMs = ofxGpuThicklinesStats::summarize(std::move(setup));
+    summary.updateMs = ofxGpuThicklinesStats::summarize(std::move(update));
+    summary.drawMs = ofxGpuThicklinesStats::summarize(std::move(draw));
+    summary.gpuMs = ofxGpuThicklinesStats::summarize(std::move(gpu));
+    return summary;
+}
+
+void ofxGpuThicklines::clearStats() {
+    m_statsHistory.clear();
+}
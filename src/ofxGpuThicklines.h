@@ -1,11 +1,33 @@
 #pragma once
 
 #include "ofMain.h"
+#include "ofxGpuThicklinesRanges.h"
+#include "ofxGpuThicklinesCulling.h"
+#include "ofxGpuThicklinesLod.h"
+#include "ofxGpuThicklinesStats.h"
+#include "ofxGpuThicklinesQuantize.h"
+#include "ofxGpuThicklinesHandoff.h"
+#include "ofxGpuThicklinesPicker.h"
 
 class ofxGpuThicklines
 {
 public:
-    ofxGpuThicklines() : m_shaderBegun(false) {  }
+    ofxGpuThicklines() : m_bytesUploaded(0), m_totalBytesUploaded(0), m_peakLoadBytes(0), m_loadInputBytes(0), m_loading(false),
+                         m_indexCount(0), m_indexBufferResized(false),
+                         m_indexMode(INDEX_LINES_ADJACENCY), m_shortIndices(false),
+                         m_joinTopologyChanged(false), m_culling(false), m_chunksStale(true),
+                         m_lodTolerance(0), m_lodStale(true), m_lodBaseError(0),
+                         m_renderBackend(BACKEND_GEOMETRY_SHADER),
+                         m_colorLocation(ofShader::COLOR_ATTRIBUTE), m_texcoordLocation(ofShader::TEXCOORD_ATTRIBUTE),
+                         m_joinLocation(ofShader::NORMAL_ATTRIBUTE), m_vertexLayout(LAYOUT_SPLIT), m_texcoordMaxAbs(0),
+                         m_edgeTableStale(true), m_edgeIdBase(0), m_pickStale(true), m_groupsStale(true), m_hiddenStale(true),
+                         m_segmentCount(0), m_statsHistory(statsHistory), m_frameStartBytes(0),
+                         m_gpuTiming(true), m_shaderBegun(false) {
+        m_decompositionStats = DecompositionStats();
+        m_cullingStats = CullingStats();
+        m_frameStats = FrameStats();
+        m_frameStats.gpuMs = -1;
+    }
     virtual ~ofxGpuThicklines() { ; }
 
     /// `positions` and `colors` should be vectors of equal length containing the data
@@ -24,15 +46,81 @@ public:
     void setup(vector<ofVec3f> positions, vector<ofVec4f> colors, vector<ofVec2f> texcoords,
                vector< vector<size_t> > curves, string customFragShader = "");
 
+    // a read-only view on `count` elements of type T, `stride` bytes apart.
+    // lets you pass e.g. the position member of an array of your own vertex structs
+    // without repacking it first:
+    //     StridedView<ofVec3f>(&verts[0].pos, verts.size(), sizeof(MyVertex))
+    template<typename T>
+    struct StridedView {
+        StridedView() : data(nullptr), count(0), stride(sizeof(T)) {}
+        StridedView(const T *p, size_t n, size_t strideBytes = sizeof(T)) : data(p), count(n), stride(strideBytes) {}
+        StridedView(const vector<T> &v) : data(v.data()), count(v.size()), stride(sizeof(T)) {}
+        const T &operator[](size_t i) const {
+            return *reinterpret_cast<const T*>(reinterpret_cast<const char*>(data) + i * stride);
+        }
+        bool contiguous() const { return stride == sizeof(T); }
+
+        const T *data;
+        size_t count;
+        size_t stride;
+    };
+    // curves as one flat index array: curve i consists of `indices[offsets[i] .. offsets[i+1])`,
+    // so `offsets` has `numCurves + 1` elements.
+    struct FlatCurves {
+        const size_t *indices;
+        const size_t *offsets;
+        size_t numCurves;
+    };
+    // loads the data straight from the caller's memory: each array is copied exactly once,
+    // into the buffers that later updates go to and that are uploaded from.
+    void setup(StridedView<ofVec3f> positions, StridedView<ofVec4f> colors, StridedView<ofVec2f> texcoords,
+               FlatCurves curves, string customFragShader = "");
+
     // builds a thick wireframe from a mesh
     // `onlylines`: interpret the mesh as consisting only of lines instead of triangles,
     // ie two adjacent indices form a line.
     void setup(const ofMesh &mesh, string customFragShader = "", bool onlylines=false);
+    // like the above, with the result kept in the binary file `cachePath` (relative to the data
+    // folder). The file is keyed by a hash of the mesh and of the options the index buffer
+    // depends on (`onlylines`, `indexMode()`, the spatial order of culling and level of detail),
+    // so set those first. When it matches, the vertices, curves and the finished index buffer
+    // are read from a memory mapping of the file, skipping decomposition and index generation.
+    // stale, truncated or corrupt files are rebuilt. Returns whether the cache was used.
+    bool setupCached(const ofMesh &mesh, const string &cachePath, string customFragShader = "", bool onlylines = false);
+
+    enum CurveDecomposition {
+        DECOMPOSE_EULER,  // Euler trails over a flat edge graph: linear time, fewest curves
+        DECOMPOSE_GREEDY  // the old greedy walk over ordered sets, kept for comparison
+    };
+    struct DecompositionStats {
+        size_t numEdges;
+        size_t numCurves;
+        float milliseconds;
+        size_t peakBytes; // the most memory the decomposition held at once, the curves included
+    };
+    // splits the unique edges of `mesh` into curves such that every edge is part of exactly one curve.
+    // this is what `setup(const ofMesh&)` uses. Pass `stats` to get the curve count and run time.
+    static vector< vector<size_t> > meshToCurves(const ofMesh &mesh, bool onlylines = false,
+                                                 CurveDecomposition method = DECOMPOSE_EULER,
+                                                 DecompositionStats *stats = nullptr);
+    // stats of the decomposition done by the last `setup(const ofMesh&)`
+    const DecompositionStats &decompositionStats() const { return m_decompositionStats; }
     
+    // the vector overloads of `setup()` and `reset()` take their arguments by value and move them
+    // into place, so pass temporaries or use std::move() to avoid any copy of your data.
     void reset(vector<ofVec3f> positions, vector<ofVec4f> colors, vector<ofVec2f> texcoords, vector< vector<size_t> > curves);
+    void reset(StridedView<ofVec3f> positions, StridedView<ofVec4f> colors, StridedView<ofVec2f> texcoords,
+               FlatCurves curves);
+
+    // bytes of CPU memory held right now, and the most held at once during the last
+    // `setup()`/`reset()`: our buffers, old and new, the curves passed in and the temporaries of
+    // the load, such as the decomposition of a mesh and the sort keys of the edge table
+    size_t cpuMemoryBytes() const;
+    size_t peakLoadBytes() const { return m_peakLoadBytes; }
 
     const vector<ofVec3f> &positions() const { return m_positions; }
     const vector<ofVec4f> &colors() const { return m_colors; }
+    const vector<ofVec2f> &texcoords() const { return m_texcoords; }
 
     size_t numPositions() { return m_positions.size(); }
 
@@ -40,29 +128,514 @@ public:
     void endUpdates();
 
     // always wrap all update calls with  `beginUpdates()` and `endUpdates()`
-    void updatePosition(size_t i, ofVec3f v) { m_positions[i] = v; }
-    void updateColor(size_t i, ofVec4f o) { m_colors[i] = o; }
+    // only the vertices touched in between are uploaded by `endUpdates()`
+    void updatePosition(size_t i, ofVec3f v) { m_positions[i] = v; m_dirtyPositions.add(i); }
+    void updateColor(size_t i, ofVec4f o) { m_colors[i] = o; m_dirtyColors.add(i); }
     void updateVertex(size_t i, ofVec3f v, ofVec4f o) {
         updatePosition(i, v);
         updateColor(i, o);
     }
-    // TODO: ability to update curves
-    
-    size_t numIndices() { return m_indexCount; }
+
+    // updates from another thread, e.g. a simulation running at its own rate. The worker writes
+    // frames into a Producer and publishes them, the render thread calls `pullUpdates()` once
+    // per frame, which applies the newest published frame like `beginUpdates()`/`endUpdates()`
+    // would. Frames published in between are skipped, their changes are part of the next one.
+    // The handoff is a lock-free triple buffer (ofxGpuThicklinesHandoff.h): neither thread waits
+    // for the other, and the render thread sees a frame whole or not at all.
+    class Producer {
+    public:
+        // the frame being written: the last published one and the changes since
+        size_t numPositions() const { return m_frames.writeBuffer().positions.size(); }
+        const vector<ofVec3f> &positions() const { return m_frames.writeBuffer().positions; }
+        const vector<ofVec4f> &colors() const { return m_frames.writeBuffer().colors; }
+
+        void updatePosition(size_t i, ofVec3f v) { frame().positions[i] = v; m_dirtyPositions.add(i); }
+        void updateColor(size_t i, ofVec4f o) { frame().colors[i] = o; m_dirtyColors.add(i); }
+        void updateVertex(size_t i, ofVec3f v, ofVec4f o) {
+            updatePosition(i, v);
+            updateColor(i, o);
+        }
+        void publish(); // hands the frame to the render thread and starts the next one
+        uint64_t numPublished() const { return m_published; } // from any thread
+
+    private:
+        friend class ofxGpuThicklines;
+        struct Frame {
+            vector<ofVec3f> positions;
+            vector<ofVec4f> colors;
+            // everything that changed since the frame the render thread took last, or more
+            ofxGpuThicklinesRanges::DirtyRanges changedPositions, changedColors;
+        };
+        Producer(const vector<ofVec3f> &positions, const vector<ofVec4f> &colors);
+        Frame &frame() { return m_frames.writeBuffer(); }
+
+        ofxGpuThicklinesHandoff::TripleBuffer<Frame> m_frames;
+        std::atomic<uint64_t> m_published;
+        ofxGpuThicklinesRanges::DirtyRanges m_dirtyPositions, m_dirtyColors;     // in this frame
+        ofxGpuThicklinesRanges::DirtyRanges m_pendingPositions, m_pendingColors; // since the last frame known taken
+        ofxGpuThicklinesRanges::DirtyRanges m_stalePositions[3], m_staleColors[3]; // per buffer: changes it lacks
+    };
+    // a producer starting from the current positions and colors, to be handed to the worker.
+    // It holds three copies of them. While it runs, update positions and colors only through it;
+    // `setup()`/`reset()` let go of it, start a new one after them.
+    shared_ptr<Producer> startProducer();
+    void stopProducer() { m_producer.reset(); }
+    // on the render thread: takes the newest frame published since the last call, if any, and
+    // uploads what changed. Returns whether there was one.
+    bool pullUpdates();
+
+    enum IndexMode {
+        INDEX_LINES_ADJACENCY,      // 4 indices per segment, one GL_LINES_ADJACENCY primitive each
+        INDEX_LINE_STRIP_ADJACENCY, // one GL_LINE_STRIP_ADJACENCY strip per curve, n+3 indices for n points
+        INDEX_LINES                 // 2 indices per segment, GL_LINES, joins from per-vertex tangents
+    };
+    // how curves are laid out in the index buffer. The adjacency modes look the same, the strip mode
+    // needs about a quarter of the index memory. Takes effect on the next `setup()`/`reset()`.
+    //
+    // INDEX_LINES halves the index data of INDEX_LINES_ADJACENCY and draws real miter joins
+    // instead of the segment normals the adjacency modes fall back to. For this, a join tangent
+    // and miter scale is computed for every vertex where exactly two segments meet, and
+    // refreshed by `endUpdates()` around the vertices that moved. At all other vertices (curve
+    // ends, branchings) the segments end square.
+    // independent of the mode, 16 bit indices are used whenever there are at most 65535 vertices.
+    void setIndexMode(IndexMode mode);
+    IndexMode indexMode() const { return m_indexMode; }
+
+    enum RenderBackend {
+        BACKEND_GEOMETRY_SHADER, // a geometry shader expands each segment
+        BACKEND_INSTANCED,       // no geometry shader: one instance per segment, expanded in the vertex shader
+        BACKEND_NONE             // no GL calls at all, `draw()` draws nothing
+    };
+    // which shaders draw the lines. Both look the same, the instanced backend is usually faster
+    // on integrated GPUs. Has to be set before `setup()`.
+    // BACKEND_NONE keeps the CPU side up to date as usual and counts the bytes the other backends
+    // would upload, so it runs without a window or GPU, e.g. in the benchmark.
+    void setRenderBackend(RenderBackend backend);
+    RenderBackend renderBackend() const { return m_renderBackend; }
+
+    enum PositionFormat {
+        POSITIONS_FLOAT,  // 3 floats, 12 bytes
+        POSITIONS_HALF,   // 4 half floats, 8 bytes, for coordinates up to 65504
+        POSITIONS_UNORM16 // 4 unsigned normalized shorts, 8 bytes, spread over the bounds of all positions
+    };
+    enum ColorFormat {
+        COLORS_FLOAT,     // 4 floats, 16 bytes
+        COLORS_RGBA8      // 4 unsigned normalized bytes, 4 bytes, clamped to [0, 1]
+    };
+    enum TexcoordFormat {
+        TEXCOORDS_FLOAT,  // 2 floats, 8 bytes
+        TEXCOORDS_HALF    // 2 half floats, 4 bytes
+    };
+    struct VertexFormat {
+        PositionFormat positions;
+        ColorFormat colors;
+        TexcoordFormat texcoords;
+        VertexFormat(PositionFormat p = POSITIONS_FLOAT, ColorFormat c = COLORS_FLOAT, TexcoordFormat t = TEXCOORDS_FLOAT)
+            : positions(p), colors(c), texcoords(t) {}
+    };
+    // how the vertex data is stored on the GPU. The compact formats cut the vertex memory and
+    // the bytes `endUpdates()` sends by 2-3x for colored curves, at the price of precision. The
+    // CPU copies (`positions()`, `colors()`, ...) stay floats and are converted on upload.
+    // Takes effect on the next `setup()`/`reset()`.
+    //
+    // POSITIONS_UNORM16 maps the bounds of the positions at `setup()`/`reset()` to [0, 65535]
+    // per axis, the shaders scale and offset them back. A position `endUpdates()` finds outside
+    // grows the bounds by half their size, and all positions are converted and uploaded again.
+    // it keeps the same relative precision everywhere, POSITIONS_HALF is finer near the origin.
+    void setVertexFormat(const VertexFormat &format) { m_vertexFormat = format; }
+    const VertexFormat &vertexFormat() const { return m_vertexFormat; }
+    // the largest difference between what the GPU gets and the CPU copies right now, per
+    // coordinate or channel, up to float rounding. 0 for the float formats.
+    struct QuantizationError {
+        ofVec3f position;
+        float color;     // in [0, 1], for colors in that range
+        float texcoord;
+    };
+    QuantizationError quantizationError() const;
+
+    enum VertexLayout {
+        LAYOUT_SPLIT,      // a buffer per attribute
+        LAYOUT_INTERLEAVED // position, color and texcoord of a vertex side by side in one buffer
+    };
+    // how the attributes are laid out on the GPU. Interleaved, the geometry shader backend reads
+    // a vertex from one place in memory, which may help when the indices jump around, as they do
+    // for meshes; whether it does depends on the GPU, `benchmark --gpu` times both layouts.
+    // `endUpdates()` then uploads whole vertices, so updating only positions or only colors sends
+    // the other attributes along. Works with every `VertexFormat`. The instanced backend reads
+    // buffer textures, which can't be interleaved, and stays split.
+    // Takes effect on the next `setup()`/`reset()`.
+    void setVertexLayout(VertexLayout layout) { m_vertexLayout = layout; }
+    VertexLayout vertexLayout() const { return m_vertexLayout; }
+
+    // editing single curves without `reset()`.
+    // after `reset()`, curve i of the `curves` passed in has handle i. Handles of removed curves
+    // are reused by later `addCurve()` calls. Each curve owns a block of the index buffer,
+    // freed blocks are recycled, and only the blocks that changed are uploaded, on the next
+    // `endUpdates()` or `draw()`.
+    // a curve with a vertex index out of range is refused with an error: `addCurve()` returns
+    // `noCurve` and `replaceCurve()` leaves the curve as it was.
+    typedef size_t CurveHandle;
+    static const CurveHandle noCurve = CurveHandle(-1);
+    CurveHandle addCurve(const vector<size_t> &curve);
+    void removeCurve(CurveHandle h);
+    void replaceCurve(CurveHandle h, const vector<size_t> &curve);
+    bool hasCurve(CurveHandle h) const { return h < m_curveSlots.size() && m_curveSlots[h].live; }
+    size_t numCurves() const { return m_curveSlots.size() - m_freeHandles.size(); }
+
+    // visibility: hidden curves stay in the index buffer, `draw()` and `pick()` skip them.
+    // a curve is drawn while both it and its group are visible. After `reset()` and `addCurve()`
+    // a curve is visible and in group 0. In INDEX_LINES, visible joins still bend towards hidden curves.
+    static const unsigned int maxGroups = 1 << 16; // larger groups are refused with an error
+    void setCurveVisible(CurveHandle h, bool visible);
+    bool curveVisible(CurveHandle h) const { return hasCurve(h) && ! m_curveHidden[h]; }
+    void setCurveGroup(CurveHandle h, unsigned int group); // e.g. the index of a layer or category
+    unsigned int curveGroup(CurveHandle h) const { return hasCurve(h) ? m_curveGroups[h] : 0; }
+    void setGroupVisible(unsigned int group, bool visible);
+    bool groupVisible(unsigned int group) const { return ! groupHidden(group); }
+
+    // culling: the index buffer is cut into chunks of about `cullingChunkSegments` segments, and
+    // `draw()` only submits the chunks whose bounds reach into the viewport, found through a
+    // bounding volume hierarchy over the chunks. Chunk bounds follow `updatePosition()` on
+    // `endUpdates()`, curve edits rebuild the chunks on the next `draw()`.
+    // for tight chunks, `setup()`/`reset()` lay out the curves in spatial order while culling is
+    // enabled, so enable it before. Off by default, since for scenes that are mostly on screen it
+    // only costs time.
+    static const size_t cullingChunkSegments = 1024;
+    void setCulling(bool enabled);
+    bool culling() const { return m_culling; }
+
+    // level of detail: with a tolerance > 0, `draw()` replaces the segments of every chunk by a
+    // Douglas-Peucker simplification of its curves, the coarsest whose error stays below
+    // `pixelTolerance` on screen (in the units of `lineWidth`). Simplified levels are built the
+    // first time a draw needs them and dropped when curves change; moved positions only simplify
+    // again the chunks of the curves they belong to.
+    // does nothing in INDEX_LINES, whose joins belong to the full resolution curves.
+    static const int lodLevels = 8; // including the full resolution
+    void setLevelOfDetail(float pixelTolerance);
+    float levelOfDetail() const { return m_lodTolerance; }
+
+    struct CullingStats {
+        size_t chunks;
+        size_t visibleChunks;
+        size_t simplifiedChunks; // visible chunks drawn at a simplified level
+        size_t drawnIndices;
+        size_t drawRanges;   // runs of consecutive visible chunks, split around hidden curves, one multi-draw entry each
+        float milliseconds;  // CPU time of the culling
+    };
+    // of the last `draw()`
+    const CullingStats &cullingStats() const { return m_cullingStats; }
+
+    // the number of indices of a curve of `n` points in the layout of `mode`, and writing them to `out`
+    static size_t curveIndexCount(IndexMode mode, size_t n);
+    static void writeCurveIndices(IndexMode mode, const size_t *curve, size_t n, unsigned int *out);
+
+    size_t numIndices() const { return m_indexCount; }
+    // CPU copy of the index buffer in the layout of `indexMode()`, of which the first `numIndices()`
+    // are drawn. Space freed by `removeCurve()` holds the primitive restart index 0xffffffff.
+    const vector<unsigned int> &indices() const { return m_indices; }
+
+    // stable ids of the segments, the `edgeID` the shaders hand to a custom fragment shader.
+    // every unique pair of vertices joined by a segment gets an id in [edgeIdBase(), edgeIdBase()
+    // + numEdges()), whichever way round and however often the curves use it. The ids don't
+    // depend on the index mode, backend, culling or level of detail, and stay the same while
+    // positions and colors change. `setup()`/`reset()` number the segments densely, in the order
+    // of the smaller and then the larger vertex. Curve edits keep the ids: segments new to the
+    // table get the ids after the last one on the next `endUpdates()` or `draw()`, the ids of
+    // segments no curve uses anymore are left unused, and come back if a curve uses them again,
+    // until the next `reset()` numbers the segments densely again. A pair of vertices that is no
+    // segment, e.g. in the simplified curves of the level of detail, gets -1.
+    // the shaders find an id by a binary search in `edgeTable()`, a buffer texture of 4 bytes
+    // per vertex and 8 per segment: per vertex where its segments start (numPositions() + 1
+    // values, the last is the number of segments), then per segment its larger vertex, sorted
+    // per smaller vertex, then per segment its id.
+    size_t numEdges() const { return m_edgeTable.size() > m_positions.size() ? m_edgeTable[m_positions.size()] : 0; }
+    int edgeId(size_t a, size_t b) const; // -1 for vertices out of range and pairs that are no segment
+    const vector<unsigned int> &edgeTable() const { return m_edgeTable; }
+    // added to every id, to number the edges of several instances as one, see ofxGpuThicklinesPaged
+    void setEdgeIdBase(unsigned int base) { m_edgeIdBase = base; }
+    unsigned int edgeIdBase() const { return m_edgeIdBase; }
+
+    // picking: the segment whose center line passes closest to `screenPoint`, within `radius`
+    // pixels. `screenPoint` and `viewport` are in window pixels with y pointing down, like
+    // mouseX and mouseY; an empty viewport is the whole window. `modelViewProjection` is the
+    // matrix `draw()` runs with, e.g. `ofGetCurrentMatrix(OF_MATRIX_MODELVIEW) *
+    // ofGetCurrentMatrix(OF_MATRIX_PROJECTION)` there.
+    // a query is backed by a screen space grid (ofxGpuThicklinesPicker.h), built by the first
+    // pick with a new matrix or viewport. Later picks only sort in again the segments at the
+    // vertices `updatePosition()` moved since, so they stay fast while the lines animate under a
+    // fixed camera. Curve edits list the segments anew on the next pick.
+    // every camera change rebuilds the whole grid, in O(N) of the segments: projecting every vertex
+    // and sorting every segment into its cells costs several linear scans over them (see
+    // `benchmark --picking`), so under a camera that moves every frame, pick once per frame at most.
+    struct Pick {
+        bool hit;
+        CurveHandle curve;
+        size_t segment;     // from point `segment` to point `segment + 1` of the curve
+        float t;            // where on the segment, in object space: 0 at point `segment`, 1 at the next
+        float distance;     // in pixels
+    };
+    Pick pick(ofVec2f screenPoint, const ofMatrix4x4 &modelViewProjection, ofRectangle viewport = ofRectangle(),
+              float radius = 5);
+    // of the last `pick()`
+    const ofxGpuThicklinesPicker::Stats &pickingStats() const { return m_picker.stats(); }
+
+    // bytes of vertex and index data sent to the GPU by the last `endUpdates()`, and in total since
+    // the object was created, over every `setup()` and `reset()`
+    size_t bytesUploaded() const { return m_bytesUploaded; }
+    uint64_t totalBytesUploaded() const { return m_totalBytesUploaded; }
+
+    // statistics per frame, where every `draw()` ends a frame
+    struct FrameStats {
+        uint64_t frame;        // counts the `draw()` calls
+        size_t bytesUploaded;  // by `setup()`/`reset()`, `endUpdates()` and `draw()` during the frame
+        size_t indices;        // `numIndices()`
+        size_t segments;       // of all curves
+        size_t drawnIndices;   // after culling and level of detail
+        size_t drawCalls;      // GL draw calls, a multi-draw counts as one
+        float setupMs;         // CPU time of `setup()`/`reset()`
+        float updateMs;        // CPU time of `endUpdates()`
+        float drawMs;          // CPU time of `draw()`
+        float gpuMs;           // GPU time of `draw()`, -1 while unknown
+    };
+    // the GPU time is measured with timer queries where the GL has them (GL 3.3 or
+    // ARB_timer_query), and read back a few frames later when it is ready, so nothing waits for
+    // the GPU. Turn it off when you time the GPU yourself, GL_TIME_ELAPSED queries can't nest.
+    void setGpuTiming(bool enabled) { m_gpuTiming = enabled; }
+    bool gpuTiming() const { return m_gpuTiming; }
+    // the last `statsHistory` frames, oldest first
+    static const size_t statsHistory = 240;
+    size_t numFrameStats() const { return m_statsHistory.size(); }
+    const FrameStats &frameStats(size_t i) const { return m_statsHistory[i]; }
+    const FrameStats &lastFrameStats() const; // all 0 before the first `draw()`
+    struct StatsSummary {
+        size_t frames;
+        size_t gpuFrames; // frames with a GPU time
+        ofxGpuThicklinesStats::Summary bytesUploaded, setupMs, updateMs, drawMs, gpuMs;
+    };
+    // min, average and 99th percentile over the history
+    StatsSummary statsSummary() const;
+    void clearStats();
+
+    // compiles and links the shaders of `backend` into `shader`, with `defines` inserted after the
+    // `#version` line of every stage: EDGE_IDS for the ids of `edgeTable()`, JOIN_TANGENTS for
+    // INDEX_LINES, PACKED_POSITIONS and UNORM_POSITIONS for the compact position formats, BATCH
+    // for ofxGpuThicklinesBatch.
+    static void loadShader(ofShader &shader, RenderBackend backend, const string &defines,
+                           const string &customFragShader = "");
+    // the same, as a program shared by everyone asking for the same backend, defines and fragment
+    // shader: the first call compiles and links it, later ones get the program already linked,
+    // until the last holder lets go. Instances share programs this way, so uniforms a custom
+    // fragment shader needs are best set after `prepareDraw()`, not once after `setup()`.
+    static shared_ptr<ofShader> sharedShader(RenderBackend backend, const string &defines,
+                                             const string &customFragShader = "");
+    // programs shared right now, and how many were built so far
+    static size_t numSharedShaders();
+    static size_t numShaderBuilds();
 
     ofShader &prepareDraw(); // call this once before `draw()` if using a custom fragment shader. Do not call it multiple times.
     void draw(float lineWidth = 3, bool perspective = true, ofVec2f viewportSize = ofVec2f(0,0)); // if viewportSize == 0, (ofGetWidth(), ofGetHeight()) is used.
 
 protected:
+    // where a curve lives in the index buffer
+    struct CurveSlot {
+        size_t offset;
+        size_t count;
+        bool live;
+    };
+    void setupShader(string customFragShader);
+    template<typename CurveSource>
+    void resetCurves(const CurveSource &curves);
+    // the part of a reset after m_curveSlots and m_indices are filled in
+    void finishReset(uint64_t t0);
+    // m_peakLoadBytes is tracked from `beginLoad()` to the end of `finishReset()`: every
+    // `notePeakLoad()` raises it to what we hold, plus the input and `temporaryBytes` alive then
+    void beginLoad(size_t inputBytes);
+    void notePeakLoad(size_t temporaryBytes = 0);
+    uint64_t cacheKey(const ofMesh &mesh, bool onlylines) const;
+    bool loadCache(const string &path, uint64_t key);
+    bool saveCache(const string &path, uint64_t key) const;
+    void placeCurve(CurveHandle h, const vector<size_t> &curve);
+    bool checkCurve(const vector<size_t> &curve, const char *caller) const; // logs indices out of range
+    void releaseCurve(CurveHandle h);
+    ofBufferObject *vboBuffer(GLint location); // the VBO buffer of an attribute, nullptr for BACKEND_NONE
+    size_t uploadIndices(); // uploads index ranges changed since the last call, returns the bytes sent
+    void uploadIndexRange(ofBufferObject &buffer, const vector<unsigned int> &indices, size_t begin, size_t end);
+    size_t indexSize() const { return m_shortIndices ? sizeof(unsigned short) : sizeof(unsigned int); }
+    // [first, end) each, in one multi-draw
+    void drawIndexRanges(ofBufferObject &buffer, const vector< std::pair<size_t, size_t> > &ranges);
+    void bindInstancedBuffers();
+    void drawInstancedRange(ofBufferObject &buffer, size_t first, size_t count);
+    void rebuildJoinAdjacency();
+    void computeJoins(size_t begin, size_t end);
+    size_t updateJoins(); // recomputes and uploads the joins that changed, returns the bytes sent
+    size_t chunkIndices() const; // index buffer elements per chunk
+    void chunkRange(size_t chunk, size_t &begin, size_t &end) const; // the indices drawn for a chunk
+    ofxGpuThicklinesCulling::Box chunkBounds(size_t chunk) const;
+    void rebuildChunks();
+    // updates the bounds of the chunks, and their simplified curves, using the dirty positions.
+    // Returns the bytes sent
+    size_t refitChunks();
+    bool usesChunks() const { return m_culling || m_lodTolerance > 0; }
+    // fills m_drawRanges with the visible chunks, at the level each one needs
+    void selectChunks(const ofMatrix4x4 &modelViewProjection, float lineWidth, bool perspective, ofVec2f viewportSize);
+    size_t curvePoints(const CurveSlot &slot) const;
+    unsigned int curvePoint(const CurveSlot &slot, size_t j) const; // the vertex of point j
+    void rebuildLodErrors();
+    void lodCurveErrors(CurveHandle h, vector<unsigned int> &points); // `points` is scratch space
+    size_t refitLod(const vector<size_t> &chunks); // for positions moved in `chunks`, returns the bytes sent
+    size_t rebuildEdgeTable(); // numbers the segments densely and uploads the table, returns the bytes sent
+    size_t updateEdgeTable(); // adds the segments of m_edgeCurves with new ids, returns the bytes sent
+    size_t uploadEdgeTable();
+    void rebuildPickSegments();
+    void bindEdgeTable(bool bind);
+    void buildLodLevel(int level);
+    // the simplified pieces of the curves in `chunk`: their indices and, per piece, its curve and start in `out`
+    void buildLodChunk(float tolerance, size_t chunk, vector<unsigned int> &out,
+                       vector< std::pair<CurveHandle, size_t> > &starts, vector<unsigned int> &kept) const;
+    size_t rebuildLodChunks(int level, const vector<size_t> &chunks); // returns the bytes sent
+    bool groupHidden(unsigned int group) const { return group < m_groupHidden.size() && m_groupHidden[group]; }
+    bool curveShown(CurveHandle h) const { return ! m_curveHidden[h] && ! groupHidden(m_curveGroups[h]); }
+    void rebuildGroups();
+    void rebuildHiddenRanges();
+    void visibilityChanged(const vector<CurveHandle> &curves); // curves that were shown and are hidden, or the other way round
+    void removeHiddenRanges(); // from m_drawRanges
+    void listHiddenPieces(size_t level); // of m_lodLevels[level], with its curve -> pieces
+    void beginGpuTiming(); // collects finished timer queries and starts one for this frame, if we can
+    void endGpuTiming();
+    void endFrame(uint64_t drawStart);
+    string shaderDefines() const;
+    // the GPU data of elements [begin, end) in the format of `vertexFormat()`, converted into
+    // m_packScratch unless it is float
+    const void *packPositions(size_t begin, size_t end);
+    const void *packColors(size_t begin, size_t end);
+    const void *packTexcoords(size_t begin, size_t end);
+    size_t positionBytes() const; // per vertex on the GPU
+    size_t colorBytes() const;
+    size_t texcoordBytes() const;
+    void growPositionRange(); // for positions updated outside of m_positionRange
+    bool interleaved() const { return m_vertexLayout == LAYOUT_INTERLEAVED && m_renderBackend != BACKEND_INSTANCED; }
+    bool hasTexcoords() const { return ! m_texcoords.empty() && m_texcoords.size() == m_positions.size(); }
+    size_t vertexStride() const; // bytes per interleaved vertex
+    const void *packInterleaved(size_t begin, size_t end); // like the above, whole vertices
+    void bindPackedAttributes(bool enable);
+
     ofShader m_curvesShader;
+    shared_ptr<ofShader> m_sharedShader; // keeps the program m_curvesShader refers to in the registry
     ofVbo m_curvesVbo;
 
     vector<ofVec3f> m_positions;
     vector<ofVec4f> m_colors;
     vector<ofVec2f> m_texcoords;
 
-    vector< vector<size_t> > m_structure;
-    size_t m_indexCount;
+    ofxGpuThicklinesRanges::DirtyRanges m_dirtyPositions, m_dirtyColors;
+    shared_ptr<Producer> m_producer;
+    size_t m_bytesUploaded;
+    uint64_t m_totalBytesUploaded;
+    size_t m_peakLoadBytes;
+    size_t m_loadInputBytes; // of the caller's data in use during the load
+    bool m_loading;
+
+    vector<CurveSlot> m_curveSlots; // indexed by CurveHandle
+    vector<CurveHandle> m_freeHandles;
+    ofxGpuThicklinesRanges::BlockAllocator m_indexAllocator;
+    ofxGpuThicklinesRanges::DirtyRanges m_dirtyIndices;
+    vector<unsigned int> m_indices; // CPU copy of the index buffer, unused space holds the restart index
+    ofBufferObject m_indexBuffer;
+    size_t m_indexCount; // number of indices to draw, i.e. the end of the last curve block
+    bool m_indexBufferResized; // m_indices grew, the whole buffer has to be uploaded again
+    IndexMode m_indexMode;
+    bool m_shortIndices; // the index buffer holds 16 bit indices
+    vector<unsigned short> m_shortScratch;
+
+    // INDEX_LINES only
+    vector<ofVec4f> m_joins;              // per vertex: unit tangent and miter scale, all 0 without a join
+    vector<unsigned int> m_joinAdjacencyStart, m_joinAdjacency; // vertex -> vertices it shares a segment with, CSR
+    ofxGpuThicklinesRanges::DirtyRanges m_dirtyJoins;
+    bool m_joinTopologyChanged; // curves were edited, all joins have to be recomputed
+
+    // culling
+    bool m_culling;
+    bool m_chunksStale; // the index buffer changed, chunks and tree have to be rebuilt
+    vector<ofxGpuThicklinesCulling::Box> m_chunkBoxes;
+    ofxGpuThicklinesCulling::Bvh m_chunkBvh;
+    vector<unsigned int> m_vertexChunkStart, m_vertexChunks; // vertex -> chunks using it, CSR
+    vector<size_t> m_visibleChunks;
+    vector< vector< std::pair<size_t, size_t> > > m_drawRanges; // per level of detail
+    vector<GLsizei> m_drawCounts;
+    vector<const void*> m_drawOffsets;
+    CullingStats m_cullingStats;
+
+    // level of detail
+    struct LodLevel {
+        bool built;
+        vector<unsigned int> indices; // the simplified curves, chunk by chunk
+        vector<size_t> chunkOffsets;  // chunk c is indices[chunkOffsets[c] .. chunkOffsets[c + 1])
+        vector<size_t> pieceOffsets;  // piece k of a curve is indices[pieceOffsets[k] .. pieceOffsets[k + 1])
+        vector<CurveHandle> pieceCurves; // the curve of piece k
+        vector< std::pair<size_t, size_t> > hiddenRanges; // the pieces of hidden curves, sorted
+        vector<size_t> curvePieceStart, curvePieces; // CurveHandle -> its pieces, CSR, listed with hiddenRanges
+        bool hiddenStale; // the pieces changed, hiddenRanges and curvePieces have to be listed again
+        ofBufferObject buffer;
+    };
+    float m_lodTolerance;
+    bool m_lodStale; // curves changed, errors and levels have to be rebuilt. Moved positions only rebuild their chunks
+    float m_lodBaseError; // the error of level 1, which quadruples with every level
+    vector<float> m_lodErrors; // Douglas-Peucker error per curve point
+    vector<size_t> m_lodErrorOffsets; // per CurveHandle, into m_lodErrors
+    vector<CurveHandle> m_slotsByOffset; // live curves in index buffer order
+    vector<LodLevel> m_lodLevels; // 0 is the index buffer itself and stays unused
+
+    RenderBackend m_renderBackend;
+    int m_colorLocation, m_texcoordLocation, m_joinLocation;
+    string m_customFragShader;
+    string m_shaderDefines; // the defines the shader was built with
+    struct InstancedResources;
+    shared_ptr<InstancedResources> m_instanced;
+
+    // compact vertex formats and layouts. Attributes that aren't float, and interleaved ones,
+    // live in buffers of our own, ofVbo only knows float attributes.
+    VertexFormat m_vertexFormat;
+    VertexLayout m_vertexLayout;
+    ofxGpuThicklinesCulling::Box m_positionRange; // bounds of the positions, what POSITIONS_UNORM16 maps to [0, 1]
+    float m_texcoordMaxAbs;
+    ofBufferObject m_packedPositions, m_packedColors, m_packedTexcoords;
+    ofBufferObject m_interleavedVertices; // LAYOUT_INTERLEAVED
+    vector<unsigned char> m_packScratch;
+
+    // edge ids
+    vector<unsigned int> m_edgeTable;
+    bool m_edgeTableStale; // the index buffer changed, the table has to be updated
+    vector<CurveHandle> m_edgeCurves; // placed or rewritten since the table was updated
+    unsigned int m_edgeIdBase;
+    ofBufferObject m_edgeBuffer;
+    struct EdgeTexture;
+    shared_ptr<EdgeTexture> m_edgeTexture;
+
+    // picking
+    ofxGpuThicklinesPicker m_picker;
+    vector<size_t> m_pickCurveStart; // per CurveHandle, its first segment in m_picker
+    bool m_pickStale; // the curves changed, the segments have to be listed again
+
+    // visibility
+    vector<unsigned char> m_curveHidden; // per CurveHandle
+    vector<unsigned int> m_curveGroups;  // per CurveHandle
+    vector<unsigned char> m_groupHidden; // per group, up to the largest one hidden so far
+    vector<unsigned int> m_groupCurveStart, m_groupCurves; // group -> curves, CSR
+    bool m_groupsStale;
+    vector< std::pair<size_t, size_t> > m_hiddenRanges; // index blocks of the hidden curves, sorted
+    vector< std::pair<size_t, size_t> > m_rangeScratch;
+    bool m_hiddenStale; // curves were edited, m_hiddenRanges has to be rebuilt
+
+    DecompositionStats m_decompositionStats;
+
+    // statistics
+    size_t m_segmentCount; // of the live curves
+    FrameStats m_frameStats; // of the frame in progress
+    ofxGpuThicklinesStats::Ring<FrameStats> m_statsHistory;
+    uint64_t m_frameStartBytes; // m_totalBytesUploaded when the frame began
+    bool m_gpuTiming;
+    struct TimerQueries;
+    shared_ptr<TimerQueries> m_timerQueries; // copied along with the rest, replaced when the owner isn't us
 
     bool m_shaderBegun; // was prepareDraw() already called?
 };
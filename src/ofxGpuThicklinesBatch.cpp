@@ -0,0 +1,225 @@
+#include "ofxGpuThicklinesBatch.h"
+#include <cassert>
+#include <algorithm>
+
+namespace {
+    const unsigned int restartIndex = 0xffffffffu;
+    const ofxGpuThicklines::IndexMode batchIndexMode = ofxGpuThicklines::INDEX_LINES_ADJACENCY;
+    // texture unit of the object buffer, above the ones a custom fragment shader is likely to use
+    const int objectTextureUnit = 8;
+
+    using ofxGpuThicklinesRanges::uploadRanges;
+}
+
+// the buffer texture of the object blocks, shared between copies like ofVbo's buffers
+struct ofxGpuThicklinesBatch::ObjectTexture {
+    GLuint id;
+    ObjectTexture() { glGenTextures(1, &id); }
+    ~ObjectTexture() { glDeleteTextures(1, &id); }
+};
+
+void ofxGpuThicklinesBatch::setup(string customFragShader) {
+    m_sharedShader = ofxGpuThicklines::sharedShader(ofxGpuThicklines::BACKEND_GEOMETRY_SHADER, "#define BATCH\n", customFragShader);
+    m_shader = *m_sharedShader;
+    m_colorLocation = m_shader.getAttributeLocation("color");
+    if(m_colorLocation < 0) m_colorLocation = ofShader::COLOR_ATTRIBUTE;
+    m_objectLocation = m_shader.getAttributeLocation("object");
+    if(m_objectLocation < 0) m_objectLocation = ofShader::NORMAL_ATTRIBUTE;
+
+    if(! m_indexBuffer.isAllocated())
+        m_indexBuffer.allocate();
+    if(! m_objectBuffer.isAllocated())
+        m_objectBuffer.allocate();
+    if(! m_objectTexture)
+        m_objectTexture = std::make_shared<ObjectTexture>();
+    reserve(1 << 12, 1 << 14, 64);
+}
+
+void ofxGpuThicklinesBatch::reserve(size_t vertices, size_t indices, size_t objects) {
+    // grow geometrically, so that adding objects one by one stays cheap
+    if(vertices > m_vertexCapacity) {
+        m_vertexCapacity = std::max(vertices, m_vertexCapacity + m_vertexCapacity / 2);
+        m_positions.resize(m_vertexCapacity);
+        m_colors.resize(m_vertexCapacity);
+        m_objectIds.resize(m_vertexCapacity);
+        m_buffersResized = true;
+    }
+    if(indices > m_indexCapacity) {
+        m_indexCapacity = std::max(indices, m_indexCapacity + m_indexCapacity / 2);
+        m_indices.resize(m_indexCapacity, restartIndex);
+        m_buffersResized = true;
+    }
+    if(objects * texelsPerObject > m_objectData.size()) {
+        m_objectData.resize(std::max(objects, m_objectData.size() / texelsPerObject * 3 / 2) * texelsPerObject);
+        m_buffersResized = true;
+    }
+}
+
+ofxGpuThicklinesBatch::ObjectHandle ofxGpuThicklinesBatch::add(const vector<ofVec3f> &positions,
+                                                               const vector<ofVec4f> &colors,
+                                                               const vector< vector<size_t> > &curves) {
+    assert(positions.size() == colors.size());
+    ObjectHandle h;
+    if(! m_freeHandles.empty()) {
+        h = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    }
+    else {
+        h = m_objects.size();
+        m_objects.push_back(Object());
+    }
+
+    size_t numIndices = 0;
+    for(const vector<size_t> &curve : curves)
+        numIndices += ofxGpuThicklines::curveIndexCount(batchIndexMode, curve.size());
+    Object &o = m_objects[h];
+    o.live = true;
+    o.vertexCount = positions.size();
+    o.vertexOffset = m_vertexAllocator.allocate(o.vertexCount);
+    o.indexCount = numIndices;
+    o.indexOffset = m_indexAllocator.allocate(o.indexCount);
+    reserve(m_vertexAllocator.end(), m_indexAllocator.end(), m_objects.size());
+
+    for(size_t i=0; i<o.vertexCount; ++i) {
+        m_positions[o.vertexOffset + i] = positions[i];
+        m_colors[o.vertexOffset + i] = colors[i];
+        m_objectIds[o.vertexOffset + i] = float(h);
+    }
+    // the curves with indices into the shared vertex buffer
+    vector<size_t> shifted;
+    size_t offset = o.indexOffset;
+    for(const vector<size_t> &curve : curves) {
+        size_t count = ofxGpuThicklines::curveIndexCount(batchIndexMode, curve.size());
+        if(count == 0) continue;
+        shifted.resize(curve.size());
+        for(size_t i=0; i<curve.size(); ++i) {
+            assert(curve[i] < o.vertexCount);
+            shifted[i] = curve[i] + o.vertexOffset;
+        }
+        ofxGpuThicklines::writeCurveIndices(batchIndexMode, &shifted[0], shifted.size(), &m_indices[offset]);
+        offset += count;
+    }
+    m_dirtyVertices.add(o.vertexOffset, o.vertexOffset + o.vertexCount);
+    m_dirtyIndices.add(o.indexOffset, o.indexOffset + o.indexCount);
+
+    ofVec4f *data = &m_objectData[h * texelsPerObject];
+    data[0] = ofVec4f(1, 0, 0, 0);
+    data[1] = ofVec4f(0, 1, 0, 0);
+    data[2] = ofVec4f(0, 0, 1, 0);
+    data[3] = ofVec4f(0, 0, 0, 1);
+    data[4] = ofVec4f(1, 1, 1, 1);
+    data[5] = ofVec4f(3, 0, 0, 0);
+    m_dirtyObjects.add(h * texelsPerObject, (h + 1) * texelsPerObject);
+    return h;
+}
+
+void ofxGpuThicklinesBatch::remove(ObjectHandle h) {
+    if(! has(h)) return;
+    Object &o = m_objects[h];
+    std::fill(m_indices.begin() + o.indexOffset, m_indices.begin() + o.indexOffset + o.indexCount, restartIndex);
+    m_dirtyIndices.add(o.indexOffset, o.indexOffset + o.indexCount);
+    m_indexAllocator.release(o.indexOffset, o.indexCount);
+    m_vertexAllocator.release(o.vertexOffset, o.vertexCount);
+    o.live = false;
+    m_freeHandles.push_back(h);
+}
+
+void ofxGpuThicklinesBatch::setTransform(ObjectHandle h, const ofMatrix4x4 &transform) {
+    if(! has(h)) return;
+    // the rows of ofMatrix4x4 are the columns of the GLSL matrix, as for any oF matrix uniform
+    const float *m = transform.getPtr();
+    for(size_t r=0; r<4; ++r)
+        m_objectData[h * texelsPerObject + r] = ofVec4f(m[4 * r], m[4 * r + 1], m[4 * r + 2], m[4 * r + 3]);
+    m_dirtyObjects.add(h * texelsPerObject, h * texelsPerObject + 4);
+}
+
+void ofxGpuThicklinesBatch::setColor(ObjectHandle h, const ofVec4f &color) {
+    if(! has(h)) return;
+    m_objectData[h * texelsPerObject + 4] = color;
+    m_dirtyObjects.add(h * texelsPerObject + 4);
+}
+
+void ofxGpuThicklinesBatch::setThickness(ObjectHandle h, float thickness) {
+    if(! has(h)) return;
+    m_objectData[h * texelsPerObject + 5] = ofVec4f(thickness, 0, 0, 0);
+    m_dirtyObjects.add(h * texelsPerObject + 5);
+}
+
+void ofxGpuThicklinesBatch::updatePosition(ObjectHandle h, size_t i, const ofVec3f &p) {
+    assert(has(h) && i < m_objects[h].vertexCount);
+    size_t v = m_objects[h].vertexOffset + i;
+    m_positions[v] = p;
+    m_dirtyVertices.add(v);
+}
+
+void ofxGpuThicklinesBatch::updateColor(ObjectHandle h, size_t i, const ofVec4f &c) {
+    assert(has(h) && i < m_objects[h].vertexCount);
+    size_t v = m_objects[h].vertexOffset + i;
+    m_colors[v] = c;
+    m_dirtyVertices.add(v);
+}
+
+void ofxGpuThicklinesBatch::upload() {
+    m_bytesUploaded = 0;
+    if(m_buffersResized) {
+        m_vbo.setVertexData(&m_positions[0], m_vertexCapacity, GL_DYNAMIC_DRAW);
+        m_vbo.setAttributeData(m_colorLocation, &m_colors[0].x, 4, m_vertexCapacity, GL_DYNAMIC_DRAW);
+        m_vbo.setAttributeData(m_objectLocation, &m_objectIds[0], 1, m_vertexCapacity, GL_DYNAMIC_DRAW);
+        m_indexBuffer.setData(m_indices.size() * sizeof(unsigned int), &m_indices[0], GL_DYNAMIC_DRAW);
+        m_objectBuffer.setData(m_objectData.size() * sizeof(ofVec4f), &m_objectData[0], GL_DYNAMIC_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, m_objectTexture->id);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_objectBuffer.getId());
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        m_bytesUploaded = m_vertexCapacity * (sizeof(ofVec3f) + sizeof(ofVec4f) + sizeof(float))
+            + m_indices.size() * sizeof(unsigned int) + m_objectData.size() * sizeof(ofVec4f);
+        m_buffersResized = false;
+    }
+    else {
+        const vector<ofxGpuThicklinesRanges::DirtyRanges::Range> &vertices = m_dirtyVertices.coalesce(16);
+        m_bytesUploaded += uploadRanges(m_vbo.getVertexBuffer(), m_positions, vertices);
+        m_bytesUploaded += uploadRanges(m_vbo.getAttributeBuffer(m_colorLocation), m_colors, vertices);
+        m_bytesUploaded += uploadRanges(m_vbo.getAttributeBuffer(m_objectLocation), m_objectIds, vertices);
+        m_bytesUploaded += uploadRanges(m_indexBuffer, m_indices, m_dirtyIndices.coalesce(16));
+        m_bytesUploaded += uploadRanges(m_objectBuffer, m_objectData, m_dirtyObjects.coalesce(16));
+    }
+    m_dirtyVertices.clear();
+    m_dirtyIndices.clear();
+    m_dirtyObjects.clear();
+}
+
+ofShader &ofxGpuThicklinesBatch::prepareDraw() {
+    m_shader.begin();
+    m_shaderBegun = true;
+    return m_shader;
+}
+
+void ofxGpuThicklinesBatch::draw(bool perspective, ofVec2f viewportSize) {
+    upload();
+    ofFill();
+    if(! m_shaderBegun)
+        m_shader.begin();
+    if(viewportSize.x == 0)
+        viewportSize = ofVec2f(ofGetWidth(), ofGetHeight());
+    m_shader.setUniform2f("viewportSize", viewportSize);
+    m_shader.setUniform1i("perspective", (int)perspective);
+    glActiveTexture(GL_TEXTURE0 + objectTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, m_objectTexture->id);
+    glActiveTexture(GL_TEXTURE0);
+    m_shader.setUniform1i("objectBuffer", objectTextureUnit);
+
+    if(numIndices() > 0) {
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(restartIndex);
+        m_vbo.bind();
+        m_indexBuffer.bind(GL_ELEMENT_ARRAY_BUFFER);
+        glDrawElements(GL_LINES_ADJACENCY, GLsizei(numIndices()), GL_UNSIGNED_INT, nullptr);
+        m_vbo.unbind();
+        glDisable(GL_PRIMITIVE_RESTART);
+    }
+
+    glActiveTexture(GL_TEXTURE0 + objectTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    m_shader.end();
+    m_shaderBegun = false;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxGpuThicklines.h"
+#include "ofxGpuThicklinesRanges.h"
+
+// draws many small line sets with a single draw call.
+//
+// all objects share one vertex buffer and one index buffer, handed out in blocks like the curve
+// blocks of ofxGpuThicklines, plus a buffer texture with a block per object holding its
+// transform, color and thickness. Freed index space holds the primitive restart index, so
+// `draw()` is one glDrawElements over the used part of the index buffer, no matter how many
+// objects there are. Only the blocks that changed are uploaded, on the next `draw()`.
+//
+// uses the geometry shader backend with INDEX_LINES_ADJACENCY indices.
+class ofxGpuThicklinesBatch
+{
+public:
+    ofxGpuThicklinesBatch() : m_objectLocation(-1), m_colorLocation(ofShader::COLOR_ATTRIBUTE),
+                              m_vertexCapacity(0), m_indexCapacity(0), m_buffersResized(false),
+                              m_bytesUploaded(0), m_shaderBegun(false) { ; }
+    virtual ~ofxGpuThicklinesBatch() { ; }
+
+    void setup(string customFragShader = "");
+
+    typedef size_t ObjectHandle;
+    // `curves` index into `positions` and `colors` of this object, like in `ofxGpuThicklines::setup()`.
+    // the object starts with the identity transform, white and a thickness of 3.
+    ObjectHandle add(const vector<ofVec3f> &positions, const vector<ofVec4f> &colors,
+                     const vector< vector<size_t> > &curves);
+    void remove(ObjectHandle h);
+    bool has(ObjectHandle h) const { return h < m_objects.size() && m_objects[h].live; }
+    size_t numObjects() const { return m_objects.size() - m_freeHandles.size(); }
+
+    void setTransform(ObjectHandle h, const ofMatrix4x4 &transform);
+    void setColor(ObjectHandle h, const ofVec4f &color); // multiplies the vertex colors
+    void setThickness(ObjectHandle h, float thickness);  // like `lineWidth` of `ofxGpuThicklines::draw()`
+
+    // vertex i of object h
+    void updatePosition(ObjectHandle h, size_t i, const ofVec3f &p);
+    void updateColor(ObjectHandle h, size_t i, const ofVec4f &c);
+
+    ofShader &prepareDraw(); // as in ofxGpuThicklines
+    void draw(bool perspective = true, ofVec2f viewportSize = ofVec2f(0,0));
+
+    size_t numVertices() const { return m_vertexAllocator.end(); }
+    size_t numIndices() const { return m_indexAllocator.end(); }
+    // bytes sent to the GPU by the last `draw()`
+    size_t bytesUploaded() const { return m_bytesUploaded; }
+
+protected:
+    struct Object {
+        size_t vertexOffset, vertexCount;
+        size_t indexOffset, indexCount;
+        bool live;
+    };
+    static const size_t texelsPerObject = 6; // transform, color, thickness
+    void reserve(size_t vertices, size_t indices, size_t objects);
+    void upload();
+
+    ofShader m_shader;
+    shared_ptr<ofShader> m_sharedShader;
+    GLint m_objectLocation, m_colorLocation;
+    ofVbo m_vbo;
+    ofBufferObject m_indexBuffer;
+    ofBufferObject m_objectBuffer;
+    struct ObjectTexture;
+    shared_ptr<ObjectTexture> m_objectTexture;
+
+    vector<ofVec3f> m_positions;
+    vector<ofVec4f> m_colors;
+    vector<float> m_objectIds; // per vertex, the handle of its object
+    vector<unsigned int> m_indices;
+    vector<ofVec4f> m_objectData; // texelsPerObject per handle
+    size_t m_vertexCapacity, m_indexCapacity;
+    bool m_buffersResized; // the arrays grew, everything is uploaded again
+
+    vector<Object> m_objects; // indexed by ObjectHandle
+    vector<ObjectHandle> m_freeHandles;
+    ofxGpuThicklinesRanges::BlockAllocator m_vertexAllocator, m_indexAllocator;
+    ofxGpuThicklinesRanges::DirtyRanges m_dirtyVertices, m_dirtyIndices, m_dirtyObjects;
+    size_t m_bytesUploaded;
+
+    bool m_shaderBegun;
+};
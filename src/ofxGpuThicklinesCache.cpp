@@ -0,0 +1,226 @@
+#include "ofxGpuThicklines.h"
+#include "ofxGpuThicklinesCache.h"
+#include <cstdio>
+#include <fstream>
+#ifdef TARGET_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ofxGpuThicklinesCache {
+
+bool MappedFile::open(const std::string &path) {
+    close();
+#ifdef TARGET_WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if(! GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file); // the mapping keeps the file open
+    if(! mapping) return false;
+    m_data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if(! m_data) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_handle = mapping;
+    m_size = size_t(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file open
+    if(p == MAP_FAILED) return false;
+    m_data = static_cast<const unsigned char*>(p);
+    m_size = size_t(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+    if(! m_data) return;
+#ifdef TARGET_WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_handle);
+#else
+    munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_handle = nullptr;
+}
+
+} // namespace ofxGpuThicklinesCache
+
+namespace {
+    template<typename T>
+    uint64_t hashVector(const vector<T> &v, uint64_t h) {
+        uint64_t n = v.size();
+        h = ofxGpuThicklinesCache::hashBytes(&n, sizeof(n), h);
+        return v.empty() ? h : ofxGpuThicklinesCache::hashBytes(&v[0], v.size() * sizeof(T), h);
+    }
+}
+
+uint64_t ofxGpuThicklines::cacheKey(const ofMesh &mesh, bool onlylines) const {
+    // the options that change what ends up in the file
+    const uint64_t options[] = { ofxGpuThicklinesCache::version, uint64_t(onlylines), uint64_t(m_indexMode),
+                                 uint64_t(usesChunks()), uint64_t(DECOMPOSE_EULER), uint64_t(mesh.getMode()) };
+    uint64_t h = ofxGpuThicklinesCache::hashBytes(options, sizeof(options));
+    h = hashVector(mesh.getVertices(), h);
+    // `setup(const ofMesh&)` only uses the colors when there is one per vertex
+    if(mesh.getNumColors() == mesh.getNumVertices())
+        h = hashVector(mesh.getColors(), h);
+    h = hashVector(mesh.getTexCoords(), h);
+    h = hashVector(mesh.getIndices(), h);
+    return h;
+}
+
+bool ofxGpuThicklines::setupCached(const ofMesh &mesh, const string &cachePath, string customFragShader, bool onlylines) {
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    const uint64_t key = cacheKey(mesh, onlylines);
+    beginLoad(0); // the file is mapped, not held
+    if(loadCache(ofToDataPath(cachePath), key)) {
+        setupShader(customFragShader);
+        finishReset(t0);
+        ofLogVerbose("ofxGpuThicklines") << "loaded " << cachePath << " in " << (ofGetElapsedTimeMicros() - t0) / 1000.0f << " ms";
+        return true;
+    }
+    setup(mesh, customFragShader, onlylines);
+    saveCache(ofToDataPath(cachePath), key);
+    return false;
+}
+
+bool ofxGpuThicklines::loadCache(const string &path, uint64_t key) {
+    using namespace ofxGpuThicklinesCache;
+    MappedFile file;
+    if(! file.open(path)) return false;
+
+    Header h;
+    if(file.size() < sizeof(Header)) {
+        ofLogWarning("ofxGpuThicklines") << path << " is truncated, rebuilding it";
+        return false;
+    }
+    memcpy(&h, file.data(), sizeof(Header));
+    if(memcmp(h.magic, magic, sizeof(magic)) != 0) {
+        ofLogWarning("ofxGpuThicklines") << path << " is not a cache file, rebuilding it";
+        return false;
+    }
+    if(h.version != version || h.byteOrder != byteOrder || h.key != key || h.indexMode != uint32_t(m_indexMode)) {
+        ofLogVerbose("ofxGpuThicklines") << path << " is stale, rebuilding it";
+        return false;
+    }
+    size_t bytes[NUM_SECTIONS], offsets[NUM_SECTIONS + 1];
+    layout(h, bytes, offsets);
+    uint64_t checksum = hashSeed;
+    if(h.fileSize == file.size() && offsets[NUM_SECTIONS] == file.size()) {
+        for(int s=0; s<NUM_SECTIONS; ++s)
+            checksum = hashBytes(file.data() + offsets[s], bytes[s], checksum);
+    }
+    if(h.fileSize != file.size() || offsets[NUM_SECTIONS] != file.size() || checksum != h.checksum) {
+        ofLogWarning("ofxGpuThicklines") << path << " is corrupt, rebuilding it";
+        return false;
+    }
+
+    // the curve blocks have to lie in the index buffer, the checksum can't tell a file written wrong
+    const uint64_t *curves = reinterpret_cast<const uint64_t*>(file.data() + offsets[CURVES]);
+    m_curveSlots.resize(h.numCurves);
+    for(size_t i=0; i<h.numCurves; ++i) {
+        CurveSlot &slot = m_curveSlots[i];
+        slot.offset = curves[2 * i];
+        slot.count = curves[2 * i + 1];
+        slot.live = true;
+        if(slot.offset > h.numIndices || slot.count > h.numIndices - slot.offset) {
+            ofLogWarning("ofxGpuThicklines") << path << " is corrupt, rebuilding it";
+            m_curveSlots.clear();
+            return false;
+        }
+    }
+
+    // our own copies, which later updates go to. Straight from the page cache on a warm start.
+    m_positions.resize(h.numVertices);
+    m_colors.resize(h.numVertices);
+    m_texcoords.resize(h.numTexcoords);
+    m_indices.resize(h.numIndices);
+    if(bytes[POSITIONS] > 0) memcpy(&m_positions[0], file.data() + offsets[POSITIONS], bytes[POSITIONS]);
+    if(bytes[COLORS] > 0) memcpy(&m_colors[0], file.data() + offsets[COLORS], bytes[COLORS]);
+    if(bytes[TEXCOORDS] > 0) memcpy(&m_texcoords[0], file.data() + offsets[TEXCOORDS], bytes[TEXCOORDS]);
+    if(bytes[INDICES] > 0) memcpy(&m_indices[0], file.data() + offsets[INDICES], bytes[INDICES]);
+
+    m_decompositionStats.numEdges = h.numEdges;
+    m_decompositionStats.numCurves = h.numCurves;
+    m_decompositionStats.milliseconds = 0;
+    return true;
+}
+
+bool ofxGpuThicklines::saveCache(const string &path, uint64_t key) const {
+    using namespace ofxGpuThicklinesCache;
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.byteOrder = byteOrder;
+    h.key = key;
+    h.indexMode = m_indexMode;
+    h.numVertices = m_positions.size();
+    h.numTexcoords = m_texcoords.size();
+    h.numCurves = m_curveSlots.size();
+    h.numIndices = m_indices.size();
+    h.numEdges = m_decompositionStats.numEdges;
+
+    vector<uint64_t> curves(2 * m_curveSlots.size());
+    for(size_t i=0; i<m_curveSlots.size(); ++i) {
+        curves[2 * i] = m_curveSlots[i].offset;
+        curves[2 * i + 1] = m_curveSlots[i].count;
+    }
+    const void *sections[NUM_SECTIONS] = { m_positions.data(), m_colors.data(), m_texcoords.data(),
+                                           curves.data(), m_indices.data() };
+    size_t bytes[NUM_SECTIONS], offsets[NUM_SECTIONS + 1];
+    layout(h, bytes, offsets);
+    h.checksum = hashSeed;
+    for(int s=0; s<NUM_SECTIONS; ++s)
+        h.checksum = hashBytes(sections[s], bytes[s], h.checksum);
+    h.fileSize = offsets[NUM_SECTIONS];
+
+    // written next to the old file and renamed over it, so that readers never see half a file
+    const string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+        const char zeros[alignment] = {};
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        size_t written = sizeof(h);
+        for(int s=0; s<=NUM_SECTIONS; ++s) {
+            out.write(zeros, offsets[s] - written);
+            if(s == NUM_SECTIONS) break;
+            if(bytes[s] > 0)
+                out.write(static_cast<const char*>(sections[s]), bytes[s]);
+            written = offsets[s] + bytes[s];
+        }
+        if(! out) {
+            ofLogError("ofxGpuThicklines") << "could not write " << tmp;
+            out.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    std::remove(path.c_str()); // rename doesn't replace on windows
+    if(std::rename(tmp.c_str(), path.c_str()) != 0) {
+        ofLogError("ofxGpuThicklines") << "could not write " << path;
+        return false;
+    }
+    ofLogVerbose("ofxGpuThicklines") << "wrote " << path << ", " << h.fileSize / 1024 << " KiB";
+    return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// the binary cache of `ofxGpuThicklines::setupCached()`
+namespace ofxGpuThicklinesCache {
+
+const uint64_t hashSeed = 14695981039346656037ull;
+
+// FNV-1a, a 64 bit word at a time with a shift to fold the high bits down, so that hashing
+// large meshes runs at memory speed. Chains through `h`.
+inline uint64_t hashBytes(const void *data, size_t bytes, uint64_t h = hashSeed) {
+    const uint64_t prime = 1099511628211ull;
+    const unsigned char *p = static_cast<const unsigned char*>(data);
+    const size_t words = bytes / 8;
+    for(size_t i=0; i<words; ++i) {
+        uint64_t w;
+        memcpy(&w, p + 8 * i, 8);
+        h = (h ^ w) * prime;
+        h ^= h >> 32;
+    }
+    for(size_t i=words*8; i<bytes; ++i)
+        h = (h ^ p[i]) * prime;
+    return h;
+}
+
+// the file starts with this header, followed by the sections in the order of `Section`, each
+// starting at a multiple of `alignment`. Everything is in the byte order of the machine that
+// wrote it, a different one counts as a stale file.
+//   positions: ofVec3f[numVertices]
+//   colors:    ofVec4f[numVertices]
+//   texcoords: ofVec2f[numTexcoords]
+//   curves:    uint64_t[2 * numCurves], the offset and count of the block of every curve
+//   indices:   uint32_t[numIndices], the index buffer in the layout of `indexMode`
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t key;        // hash of the input and of the options that shape the index buffer
+    uint32_t indexMode;
+    uint32_t reserved;
+    uint64_t numVertices, numTexcoords, numCurves, numIndices;
+    uint64_t numEdges;   // for the decomposition stats
+    uint64_t checksum;   // hash of the sections
+    uint64_t fileSize;
+};
+
+const char magic[8] = { 'o', 'f', 'x', 'G', 'T', 'L', 'C', '\0' };
+const uint32_t version = 1;
+const uint32_t byteOrder = 0x01020304;
+const size_t alignment = 64;
+
+enum Section { POSITIONS, COLORS, TEXCOORDS, CURVES, INDICES, NUM_SECTIONS };
+
+// bytes of each section, and the offsets at which they start
+inline void layout(const Header &h, size_t bytes[NUM_SECTIONS], size_t offsets[NUM_SECTIONS + 1]) {
+    bytes[POSITIONS] = h.numVertices * 3 * sizeof(float);
+    bytes[COLORS] = h.numVertices * 4 * sizeof(float);
+    bytes[TEXCOORDS] = h.numTexcoords * 2 * sizeof(float);
+    bytes[CURVES] = h.numCurves * 2 * sizeof(uint64_t);
+    bytes[INDICES] = h.numIndices * sizeof(uint32_t);
+    size_t offset = (sizeof(Header) + alignment - 1) / alignment * alignment;
+    for(int s=0; s<NUM_SECTIONS; ++s) {
+        offsets[s] = offset;
+        offset = (offset + bytes[s] + alignment - 1) / alignment * alignment;
+    }
+    offsets[NUM_SECTIONS] = offset;
+}
+
+// a read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() : m_data(nullptr), m_size(0), m_handle(nullptr) {}
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &path); // false if the file doesn't exist or can't be mapped
+    void close();
+
+    const unsigned char *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const unsigned char *m_data;
+    size_t m_size;
+    void *m_handle; // the file mapping object on windows
+};
+
+} // namespace ofxGpuThicklinesCache
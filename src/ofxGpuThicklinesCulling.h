@@ -0,0 +1,189 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxGpuThicklinesMath.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// view frustum culling of the index buffer chunks of ofxGpuThicklines
+namespace ofxGpuThicklinesCulling {
+
+// axis aligned bounding box, empty when default constructed
+struct Box {
+    ofVec3f min, max;
+    Box() : min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+    bool empty() const { return min.x > max.x; }
+    void add(const ofVec3f &p) {
+        min.x = std::min(min.x, p.x); min.y = std::min(min.y, p.y); min.z = std::min(min.z, p.z);
+        max.x = std::max(max.x, p.x); max.y = std::max(max.y, p.y); max.z = std::max(max.z, p.z);
+    }
+    void add(const Box &b) {
+        if(b.empty()) return;
+        add(b.min);
+        add(b.max);
+    }
+    ofVec3f center() const { return (min + max) * 0.5f; }
+};
+
+// the part of object space the shaders of ofxGpuThicklines can draw into, as planes
+// a*x + b*y + c*z + d >= 0.
+//
+// the sides are moved outwards by the widest a line can get on screen (the line width times
+// the longest miter MITER_LIMIT allows), so that a segment just outside still counts when its
+// thick outline reaches into the viewport. There is no near and far plane because the shaders
+// draw everything at depth 0, only what lies behind the eye (w <= 0) is cut away; the shaders
+// would draw it mirrored.
+class Frustum {
+public:
+    // the arguments are the ones of `ofxGpuThicklines::draw()` and the model view projection
+    // matrix of the shaders, in the row vector convention of ofMatrix4x4
+    Frustum(const ofMatrix4x4 &modelViewProjection, float lineWidth, bool perspective, ofVec2f viewportSize) {
+        const float *m = modelViewProjection.getPtr();
+        // clip space x, y and w as functions of object space
+        const float row[3][4] = {
+            { m[0], m[4], m[8], m[12] },
+            { m[1], m[5], m[9], m[13] },
+            { m[3], m[7], m[11], m[15] }
+        };
+        const float miterScale = 1.0f / std::sqrt((1.0f - OFX_GPU_THICKLINES_MITER_LIMIT) / 2.0f);
+        const float size[2] = { viewportSize.x, viewportSize.y };
+        int p = 0;
+        for(int axis=0; axis<2; ++axis) {
+            // the widest outline in normalized device coordinates: thickness / viewportSize, where the
+            // perspective thickness 500 / w cancels the w of the plane, leaving a constant
+            float margin = lineWidth * miterScale / size[axis];
+            float widen = perspective ? 0.0f : margin;
+            float offset = perspective ? 500.0f * margin : 0.0f;
+            for(int side=-1; side<=1; side+=2, ++p) {
+                // side * x + (1 + widen) * w + offset >= 0
+                for(int k=0; k<4; ++k)
+                    m_planes[p][k] = side * row[axis][k] + (1.0f + widen) * row[2][k];
+                m_planes[p][3] += offset;
+            }
+        }
+        for(int k=0; k<4; ++k)
+            m_planes[4][k] = row[2][k];
+    }
+
+    enum Result { OUTSIDE, INTERSECTS, INSIDE };
+    Result classify(const Box &b) const {
+        Result result = INSIDE;
+        for(int p=0; p<numPlanes; ++p) {
+            const float *plane = m_planes[p];
+            // the corners furthest along and against the plane normal
+            float far = plane[3], near = plane[3];
+            far += plane[0] * (plane[0] > 0 ? b.max.x : b.min.x);
+            near += plane[0] * (plane[0] > 0 ? b.min.x : b.max.x);
+            far += plane[1] * (plane[1] > 0 ? b.max.y : b.min.y);
+            near += plane[1] * (plane[1] > 0 ? b.min.y : b.max.y);
+            far += plane[2] * (plane[2] > 0 ? b.max.z : b.min.z);
+            near += plane[2] * (plane[2] > 0 ? b.min.z : b.max.z);
+            if(far < 0) return OUTSIDE;
+            if(near < 0) result = INTERSECTS;
+        }
+        return result;
+    }
+
+private:
+    static const int numPlanes = 5;
+    float m_planes[numPlanes][4];
+};
+
+// bounding volume hierarchy over a fixed set of leaf boxes.
+//
+// `build()` sorts the leaves into a binary tree by median splits along the longest axis of
+// their centers. When the leaf boxes change later, `refit()` only updates the node boxes and
+// keeps the tree, which stays good as long as the leaves do not move far.
+class Bvh {
+public:
+    void build(const std::vector<Box> &leaves) {
+        m_nodes.clear();
+        m_order.resize(leaves.size());
+        for(size_t i=0; i<leaves.size(); ++i)
+            m_order[i] = i;
+        if(leaves.empty()) return;
+        m_nodes.reserve(2 * leaves.size());
+        buildNode(leaves, 0, leaves.size());
+        refit(leaves);
+    }
+
+    void refit(const std::vector<Box> &leaves) {
+        // children are stored after their parent
+        for(size_t n=m_nodes.size(); n-- > 0;) {
+            Node &node = m_nodes[n];
+            node.box = Box();
+            if(node.right == 0) {
+                for(size_t i=node.first; i<node.first + node.count; ++i)
+                    node.box.add(leaves[m_order[i]]);
+            }
+            else {
+                node.box.add(m_nodes[n + 1].box);
+                node.box.add(m_nodes[node.right].box);
+            }
+        }
+    }
+
+    // appends the leaves that are at least partly inside `frustum` to `visible`, in ascending order
+    void query(const Frustum &frustum, std::vector<size_t> &visible) const {
+        size_t begin = visible.size();
+        if(m_nodes.empty()) return;
+        size_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while(top > 0) {
+            const Node &node = m_nodes[stack[--top]];
+            if(node.box.empty()) continue;
+            Frustum::Result r = frustum.classify(node.box);
+            if(r == Frustum::OUTSIDE) continue;
+            if(r == Frustum::INSIDE || node.right == 0) {
+                visible.insert(visible.end(), m_order.begin() + node.first, m_order.begin() + node.first + node.count);
+                continue;
+            }
+            stack[top++] = node.right;
+            stack[top++] = &node - &m_nodes[0] + 1;
+        }
+        std::sort(visible.begin() + begin, visible.end());
+    }
+
+    size_t numNodes() const { return m_nodes.size(); }
+
+private:
+    static const size_t leavesPerNode = 2;
+
+    struct Node {
+        Box box;
+        size_t first, count; // leaves m_order[first .. first + count)
+        size_t right;        // 0 for leaf nodes, the left child always follows its parent
+    };
+
+    void buildNode(const std::vector<Box> &leaves, size_t first, size_t count) {
+        size_t n = m_nodes.size();
+        m_nodes.push_back(Node());
+        m_nodes[n].first = first;
+        m_nodes[n].count = count;
+        m_nodes[n].right = 0;
+        if(count <= leavesPerNode) return;
+
+        Box centers;
+        for(size_t i=first; i<first + count; ++i)
+            centers.add(leaves[m_order[i]].center());
+        ofVec3f extent = centers.max - centers.min;
+        int axis = extent.x >= extent.y ? (extent.x >= extent.z ? 0 : 2) : (extent.y >= extent.z ? 1 : 2);
+        size_t half = count / 2;
+        std::nth_element(m_order.begin() + first, m_order.begin() + first + half, m_order.begin() + first + count,
+                         [&](size_t a, size_t b) { return leaves[a].center()[axis] < leaves[b].center()[axis]; });
+
+        // depth stays below 64 since every split halves the leaves
+        buildNode(leaves, first, half);
+        size_t right = m_nodes.size();
+        buildNode(leaves, first + half, count - half);
+        m_nodes[n].right = right;
+    }
+
+    std::vector<Node> m_nodes;
+    std::vector<size_t> m_order; // leaf ids, grouped by node
+};
+
+} // namespace ofxGpuThicklinesCulling
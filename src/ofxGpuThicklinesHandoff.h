@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// handing frames of data from one thread to another without locks
+namespace ofxGpuThicklinesHandoff {
+
+// three buffers of T: one the writer fills, one the reader reads, and one in between holding the
+// newest frame the reader hasn't taken yet. Handing over swaps a buffer with the one in between
+// through a single atomic exchange, so neither side ever waits, the reader always gets the
+// newest complete frame, and a frame is never written while it is read.
+//
+// one writer thread and one reader thread. `publish()` and `writeBuffer()` belong to the writer,
+// `acquire()` and `readBuffer()` to the reader.
+template<typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : m_state(1), m_write(0), m_read(2) {}
+
+    T &writeBuffer() { return m_slots[m_write]; }
+    const T &writeBuffer() const { return m_slots[m_write]; }
+    int writeIndex() const { return m_write; }
+
+    // hands the write buffer over and gets another one to write, which holds an older frame.
+    // Returns whether the reader took the frame published before this one.
+    bool publish() {
+        const int published = m_write;
+        uint8_t old = m_state.exchange(uint8_t(published | fresh), std::memory_order_acq_rel);
+        m_write = old & indexMask;
+        return (old & fresh) == 0;
+    }
+
+    // makes the newest published frame the read buffer, false if there is none since the last call.
+    // The reader has to be done with the old read buffer, it goes back to the writer.
+    bool acquire() {
+        if((m_state.load(std::memory_order_acquire) & fresh) == 0)
+            return false;
+        uint8_t old = m_state.exchange(uint8_t(m_read), std::memory_order_acq_rel);
+        m_read = old & indexMask;
+        return true;
+    }
+
+    const T &readBuffer() const { return m_slots[m_read]; }
+
+    // any of the buffers, for setting them up before the threads start. The writer may also read
+    // the buffer it published last while it isn't handed back to it, the reader only reads it too.
+    T &slot(int i) { return m_slots[i]; }
+
+private:
+    TripleBuffer(const TripleBuffer &);
+    TripleBuffer &operator=(const TripleBuffer &);
+
+    static const uint8_t indexMask = 3;
+    static const uint8_t fresh = 4; // the buffer in between holds a frame the reader hasn't taken
+
+    T m_slots[3];
+    std::atomic<uint8_t> m_state; // index of the buffer in between, and `fresh`
+    int m_write, m_read;          // each only touched by its own thread
+};
+
+} // namespace ofxGpuThicklinesHandoff
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxGpuThicklinesCulling.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// level of detail for the curves of ofxGpuThicklines
+namespace ofxGpuThicklinesLod {
+
+inline float distanceToSegment(const ofVec3f &p, const ofVec3f &a, const ofVec3f &b) {
+    ofVec3f ab = b - a;
+    float length2 = ab.lengthSquared();
+    float t = length2 > 0 ? std::max(0.0f, std::min(1.0f, (p - a).dot(ab) / length2)) : 0.0f;
+    return (a + ab * t - p).length();
+}
+
+// the Douglas-Peucker error of every point of the curve `points[0 .. n)`: the distance at which
+// the simplification would add it. Simplifying with a tolerance `e` keeps exactly the points
+// with `errors[i] > e`. The ends get FLT_MAX and are always kept.
+inline void douglasPeuckerErrors(const ofVec3f *positions, const unsigned int *points, size_t n, float *errors) {
+    if(n == 0) return;
+    std::fill(errors, errors + n, 0.0f);
+    errors[0] = errors[n - 1] = FLT_MAX;
+
+    struct Span { size_t first, last; float error; };
+    std::vector<Span> stack;
+    stack.push_back({ 0, n - 1, FLT_MAX });
+    while(! stack.empty()) {
+        Span s = stack.back();
+        stack.pop_back();
+        if(s.last <= s.first + 1) continue;
+        const ofVec3f &a = positions[points[s.first]];
+        const ofVec3f &b = positions[points[s.last]];
+        size_t split = s.first + 1;
+        float d = -1;
+        for(size_t i=s.first+1; i<s.last; ++i) {
+            float di = distanceToSegment(positions[points[i]], a, b);
+            if(di > d) { d = di; split = i; }
+        }
+        // a point can not come before the one that splits the span around it
+        float e = std::min(d, s.error);
+        errors[split] = e;
+        stack.push_back({ s.first, split, e });
+        stack.push_back({ split, s.last, e });
+    }
+}
+
+// an upper bound for the on-screen length of one object space unit inside `box`, in the units
+// the shaders of ofxGpuThicklines use for `thickness`. Returns FLT_MAX when the box reaches
+// behind the eye.
+inline float screenScale(const ofMatrix4x4 &modelViewProjection, ofVec2f viewportSize,
+                         const ofxGpuThicklinesCulling::Box &box) {
+    const float *m = modelViewProjection.getPtr();
+    // the smallest w of the box
+    float w = m[15];
+    w += m[3] * (m[3] > 0 ? box.min.x : box.max.x);
+    w += m[7] * (m[7] > 0 ? box.min.y : box.max.y);
+    w += m[11] * (m[11] > 0 ? box.min.z : box.max.z);
+    if(w <= 0) return FLT_MAX;
+    // d(x/w) = (dx - x/w dw) / w, with |x/w| <= 1 on screen
+    float gradientW = std::sqrt(m[3] * m[3] + m[7] * m[7] + m[11] * m[11]);
+    float gradientX = std::sqrt(m[0] * m[0] + m[4] * m[4] + m[8] * m[8]);
+    float gradientY = std::sqrt(m[1] * m[1] + m[5] * m[5] + m[9] * m[9]);
+    return std::max(viewportSize.x * (gradientX + gradientW), viewportSize.y * (gradientY + gradientW)) / w;
+}
+
+} // namespace ofxGpuThicklinesLod
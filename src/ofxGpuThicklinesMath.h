@@ -0,0 +1,197 @@
+#pragma once
+
+#include "ofMain.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// CPU versions of the per-segment math done by the shaders of ofxGpuThicklines.
+//
+// `expandSegmentVertex()` is a line-by-line port of the vertex shader of the instanced
+// backend, which in turn does exactly what the geometry shader does, one output vertex at a
+// time. Use it to check the expansion without a GPU.
+#define OFX_GPU_THICKLINES_MITER_LIMIT 0.75f
+
+namespace ofxGpuThicklinesMath {
+
+// number of vertices the instanced backend draws per segment: the triangle filling sharp
+// corners (degenerate when not needed) followed by the segment quad as two triangles
+static const int verticesPerSegment = 9;
+
+struct Vec2 {
+    float x, y;
+    Vec2() : x(0), y(0) {}
+    Vec2(float x_, float y_) : x(x_), y(y_) {}
+    Vec2 operator+(const Vec2 &o) const { return Vec2(x + o.x, y + o.y); }
+    Vec2 operator-(const Vec2 &o) const { return Vec2(x - o.x, y - o.y); }
+    Vec2 operator*(float f) const { return Vec2(x * f, y * f); }
+    Vec2 operator/(const Vec2 &o) const { return Vec2(x / o.x, y / o.y); }
+};
+inline float dot(const Vec2 &a, const Vec2 &b) { return a.x * b.x + a.y * b.y; }
+// like GLSL, normalizing a zero vector does not give a usable direction (NaN here)
+inline Vec2 normalize(const Vec2 &a) { float l = std::sqrt(dot(a, a)); return Vec2(a.x / l, a.y / l); }
+inline Vec2 mix(const Vec2 &a, const Vec2 &b, float t) { return a * (1.0f - t) + b * t; }
+inline float sign(float f) { return f > 0 ? 1.0f : (f < 0 ? -1.0f : 0.0f); }
+
+// `modelViewProjectionMatrix * position` as done in the shaders
+inline ofVec4f toClip(const ofMatrix4x4 &mvp, const ofVec3f &p) {
+    const float *m = mvp.getPtr();
+    return ofVec4f(p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12],
+                   p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13],
+                   p.x * m[2] + p.y * m[6] + p.z * m[10] + m[14],
+                   p.x * m[3] + p.y * m[7] + p.z * m[11] + m[15]);
+}
+
+struct Params {
+    float thickness;   // the `thickness` uniform, i.e. `lineWidth` of `draw()`
+    bool perspective;
+    Vec2 viewportSize;
+};
+
+// one segment: the clip space positions of the previous, start, end and next point
+// and the color and texcoord of start and end
+struct SegmentInput {
+    ofVec4f clip[4];
+    ofVec4f color[2];
+    Vec2 texcoord[2];
+};
+
+struct OutputVertex {
+    Vec2 position;       // normalized device coordinates, z is always 0
+    Vec2 texcoord;       // fTexCoordVarying
+    Vec2 localTexCoord;  // flocalTexCoord: x runs along the segment, y across it
+    ofVec4f color;       // fColorVarying
+};
+
+inline Vec2 screenSpace(const ofVec4f &v, const Vec2 &viewportSize) {
+    return Vec2(v.x / v.w * viewportSize.x, v.y / v.w * viewportSize.y);
+}
+
+// the values every output vertex of a segment depends on
+struct SegmentFrame {
+    Vec2 p1, p2;
+    Vec2 n0, n1;
+    Vec2 miterA, miterB;
+    float lengthA, lengthB, thicknessA;
+    bool capStart;  // dot(v0,v1) < -MITER_LIMIT: the start corner gets the extra triangle
+    float f, g;     // orientation of that triangle
+};
+
+inline SegmentFrame segmentFrame(const SegmentInput &in, const Params &params) {
+    SegmentFrame s;
+    Vec2 p0 = screenSpace(in.clip[0], params.viewportSize); // start of previous segment
+    s.p1 = screenSpace(in.clip[1], params.viewportSize);    // end of previous segment, start of current segment
+    s.p2 = screenSpace(in.clip[2], params.viewportSize);    // end of current segment, start of next segment
+    Vec2 p3 = screenSpace(in.clip[3], params.viewportSize); // end of next segment
+
+    s.thicknessA = params.thickness * (params.perspective ? (500.0f / in.clip[1].w) : 1.0f);
+    float thicknessB = params.thickness * (params.perspective ? (500.0f / in.clip[2].w) : 1.0f);
+
+    Vec2 v0 = normalize(s.p1 - p0);
+    Vec2 v1 = normalize(s.p2 - s.p1);
+    Vec2 v2 = normalize(p3 - s.p2);
+
+    s.n1 = Vec2(-v1.y, v1.x);
+    float p_n0 = dot(v0, v0) < 0.1f ? 0.0f : 1.0f;
+    s.n0 = mix(s.n1, Vec2(-v0.y, v0.x), p_n0);
+    float p_n2 = dot(v2, v2) < 0.1f ? 0.0f : 1.0f;
+    Vec2 n2 = mix(s.n1, Vec2(-v2.y, v2.x), 1.0f - p_n2);
+    // same as the FIXME in the geometry shader: all normals are the segment normal
+    s.n0 = s.n1;
+    n2 = s.n1;
+
+    s.miterA = normalize(s.n0 + s.n1);
+    s.miterB = normalize(s.n1 + n2);
+    s.lengthA = s.thicknessA / dot(s.miterA, s.n1);
+    s.lengthB = thicknessB / dot(s.miterB, s.n1);
+
+    s.capStart = dot(v0, v1) < -OFX_GPU_THICKLINES_MITER_LIMIT;
+    s.f = s.g = 0;
+    if(s.capStart) {
+        s.miterA = s.n1;
+        s.lengthA = s.thicknessA;
+        s.f = sign(dot(v0, s.n1));
+        s.g = 1.0f - std::fabs(s.f);
+    }
+    if(dot(v1, v2) < -OFX_GPU_THICKLINES_MITER_LIMIT) {
+        s.miterB = s.n1;
+        s.lengthB = thicknessB;
+    }
+    return s;
+}
+
+// output vertex `corner` in [0, verticesPerSegment) of the instanced backend.
+// corners 0..2 are the corner triangle, which collapses onto p1 when `capStart` is false.
+// corners 3..8 are the quad, in the order of the geometry shader's strip: 0 1 2, 2 1 3.
+// returns false for collapsed corners.
+inline bool segmentVertex(const SegmentFrame &s, const SegmentInput &in, const Params &params,
+                          int corner, OutputVertex &out) {
+    if(corner < 3) {
+        out.texcoord = in.texcoord[0];
+        out.color = in.color[0];
+        Vec2 p = s.p1;
+        if(! s.capStart) {
+            out.localTexCoord = Vec2(0, 0.5f);
+            out.position = p / params.viewportSize;
+            return false;
+        }
+        if(corner == 0) {
+            out.localTexCoord = Vec2(0, s.g);
+            p = s.p1 + mix(s.n0, s.n1, s.g) * (s.thicknessA * s.f);
+        }
+        else if(corner == 1) {
+            out.localTexCoord = Vec2(0, s.g);
+            p = s.p1 + mix(s.n1, s.n0, s.g) * (s.thicknessA * s.f);
+        }
+        else {
+            out.localTexCoord = Vec2(0, 0.5f);
+        }
+        out.position = p / params.viewportSize;
+        return true;
+    }
+
+    static const int quadCorner[6] = { 0, 1, 2, 2, 1, 3 };
+    int q = quadCorner[corner - 3];
+    bool end = q >= 2;
+    out.texcoord = in.texcoord[end ? 1 : 0];
+    out.color = in.color[end ? 1 : 0];
+    out.localTexCoord = Vec2(end ? 1.0f : 0.0f, (q % 2) ? 1.0f : 0.0f);
+    Vec2 offset = end ? s.miterB * s.lengthB : s.miterA * s.lengthA;
+    Vec2 p = end ? s.p2 : s.p1;
+    out.position = ((q % 2) ? p - offset : p + offset) / params.viewportSize;
+    return true;
+}
+
+inline bool expandSegmentVertex(const SegmentInput &in, const Params &params, int corner, OutputVertex &out) {
+    return segmentVertex(segmentFrame(in, params), in, params, corner, out);
+}
+
+// the `edgeID` output of the shaders, see `ofxGpuThicklines::edgeTable()` for `table`: the id of
+// the segment between vertices a and b, plus `base`. A pair that is no segment (the simplified
+// curves of the level of detail) gets -1.
+inline int edgeID(const unsigned int *table, size_t numVertices, unsigned int a, unsigned int b, unsigned int base = 0) {
+    if(a > b) std::swap(a, b);
+    const unsigned int *targets = table + numVertices + 1, *ids = targets + table[numVertices];
+    unsigned int first = table[a], last = table[a + 1];
+    const unsigned int end = last;
+    while(first < last) { // lower bound of b among the larger vertices of a's segments
+        unsigned int mid = first + (last - first) / 2;
+        if(targets[mid] < b) first = mid + 1;
+        else last = mid;
+    }
+    if(first == end || targets[first] != b)
+        return -1;
+    return int(base + ids[first]);
+}
+
+// the `edgeID` of shaders without a table (ofxGpuThicklinesBatch, ofxGpuThicklinesTrail): a
+// hash of the two vertex ids, the same in both directions. Stable, but not unique.
+inline int edgeHash(unsigned int a, unsigned int b) {
+    uint32_t h = uint32_t(std::min(a, b)) * 0x9e3779b1u + uint32_t(std::max(a, b));
+    h ^= h >> 16; h *= 0x7feb352du;
+    h ^= h >> 15; h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return int(h & 0x7fffffffu);
+}
+
+} // namespace ofxGpuThicklinesMath
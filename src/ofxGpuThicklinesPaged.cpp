@@ -0,0 +1,207 @@
+#include "ofxGpuThicklinesPaged.h"
+#include "ofxGpuThicklinesParallel.h"
+#include <algorithm>
+
+namespace {
+    const unsigned int noPart = 0xffffffffu;
+
+    // the most points of a curve whose indices fit into `maxIndices`, at least 2
+    size_t maxCurvePoints(ofxGpuThicklines::IndexMode mode, size_t maxVertices, size_t maxIndices) {
+        size_t lo = 2, hi = std::max(maxVertices, size_t(2));
+        while(lo < hi) {
+            size_t mid = hi - (hi - lo) / 2;
+            if(ofxGpuThicklines::curveIndexCount(mode, mid) <= maxIndices) lo = mid;
+            else hi = mid - 1;
+        }
+        return lo;
+    }
+}
+
+void ofxGpuThicklinesPaged::setPartLimits(size_t maxVertices, size_t maxIndices) {
+    m_maxVertices = std::max(maxVertices, size_t(2));
+    m_maxIndices = maxIndices;
+}
+
+template<typename F>
+void ofxGpuThicklinesPaged::forEachCopy(size_t i, F f) {
+    const Home &home = m_home[i];
+    f(*m_parts[home.part & ~copiedBit], home.local);
+    if(home.part & copiedBit) {
+        Copy key;
+        key.vertex = i;
+        for(vector<Copy>::const_iterator c = std::lower_bound(m_copies.begin(), m_copies.end(), key);
+            c != m_copies.end() && c->vertex == i; ++c)
+            f(*m_parts[c->part], c->local);
+    }
+}
+
+void ofxGpuThicklinesPaged::setup(const vector<ofVec3f> &positions, const vector<ofVec4f> &colors,
+                                  const vector< vector<size_t> > &curves, string customFragShader) {
+    vector<size_t> indices, offsets(1, 0);
+    for(const vector<size_t> &c : curves) {
+        indices.insert(indices.end(), c.begin(), c.end());
+        offsets.push_back(indices.size());
+    }
+    ofxGpuThicklines::FlatCurves flat = { indices.data(), offsets.data(), curves.size() };
+    setup(positions, colors, ofxGpuThicklines::StridedView<ofVec2f>(), flat, customFragShader);
+}
+
+void ofxGpuThicklinesPaged::setup(ofxGpuThicklines::StridedView<ofVec3f> positions,
+                                  ofxGpuThicklines::StridedView<ofVec4f> colors,
+                                  ofxGpuThicklines::StridedView<ofVec2f> texcoords,
+                                  ofxGpuThicklines::FlatCurves curves, string customFragShader) {
+    m_parts.clear();
+    m_copies.clear();
+    m_bytesUploaded = 0;
+    m_shaderBegun = false;
+    const size_t n = positions.count;
+    const Home unplaced = { noPart, 0 };
+    m_home.assign(n, unplaced);
+    const bool hasTexcoords = n > 0 && texcoords.count == n;
+    const ofxGpuThicklines::IndexMode mode = m_settings.indexMode();
+    const size_t maxPoints = maxCurvePoints(mode, m_maxVertices, m_maxIndices);
+
+    // the part being filled: its vertices by their index in `positions`, in the order of first
+    // use, and its curves in local indices
+    vector<unsigned int> seenIn(n, noPart), seenLocal(n);
+    vector<size_t> vertices, indices, offsets(1, 0);
+    size_t partIndices = 0;
+
+    const auto flush = [&]() {
+        const unsigned int p = unsigned(m_parts.size());
+        shared_ptr<ofxGpuThicklines> part = std::make_shared<ofxGpuThicklines>(m_settings);
+        ofxGpuThicklines::FlatCurves local = { indices.data(), offsets.data(), offsets.size() - 1 };
+        // curves given in order use the vertices in order, then the part is a window of the input
+        bool window = true;
+        for(size_t i=0; i<vertices.size() && window; ++i)
+            window = vertices[i] == vertices[0] + i;
+        if(window) {
+            const size_t first = vertices[0], count = vertices.size();
+            part->setup(ofxGpuThicklines::StridedView<ofVec3f>(&positions[first], count, positions.stride),
+                        ofxGpuThicklines::StridedView<ofVec4f>(&colors[first], count, colors.stride),
+                        hasTexcoords ? ofxGpuThicklines::StridedView<ofVec2f>(&texcoords[first], count, texcoords.stride)
+                                     : ofxGpuThicklines::StridedView<ofVec2f>(),
+                        local, customFragShader);
+        }
+        else {
+            vector<ofVec3f> partPositions(vertices.size());
+            vector<ofVec4f> partColors(vertices.size());
+            vector<ofVec2f> partTexcoords(hasTexcoords ? vertices.size() : 0);
+            ofxGpuThicklinesParallel::forRange(vertices.size(), [&](size_t begin, size_t end) {
+                for(size_t i=begin; i<end; ++i) {
+                    partPositions[i] = positions[vertices[i]];
+                    partColors[i] = colors[vertices[i]];
+                    if(hasTexcoords)
+                        partTexcoords[i] = texcoords[vertices[i]];
+                }
+            });
+            part->setup(partPositions, partColors, partTexcoords, local, customFragShader);
+        }
+        m_bytesUploaded += part->bytesUploaded();
+        m_parts.push_back(part);
+        ofLogVerbose("ofxGpuThicklines") << "part " << p << ": " << vertices.size() << " vertices, "
+                                         << part->numIndices() << " indices";
+        vertices.clear();
+        indices.clear();
+        offsets.assign(1, 0);
+        partIndices = 0;
+    };
+    const auto place = [&](size_t v) {
+        const unsigned int p = unsigned(m_parts.size());
+        if(seenIn[v] == p) return;
+        seenIn[v] = p;
+        seenLocal[v] = unsigned(vertices.size());
+        if(m_home[v].part == noPart) {
+            m_home[v].part = p;
+            m_home[v].local = seenLocal[v];
+        }
+        else {
+            m_home[v].part |= copiedBit;
+            Copy copy = { v, p, seenLocal[v] };
+            m_copies.push_back(copy);
+        }
+        vertices.push_back(v);
+    };
+
+    for(size_t c=0; c<curves.numCurves; ++c) {
+        const size_t *curve = curves.indices + curves.offsets[c];
+        const size_t length = curves.offsets[c + 1] - curves.offsets[c];
+        // pieces of at most `maxPoints` points, each starting where the last one ended
+        for(size_t first=0; first + 1 < length; first += maxPoints - 1) {
+            const size_t count = std::min(maxPoints, length - first);
+            const size_t pieceIndices = ofxGpuThicklines::curveIndexCount(mode, count);
+            if(! vertices.empty() && (vertices.size() + count > m_maxVertices || partIndices + pieceIndices > m_maxIndices))
+                flush();
+            for(size_t j=0; j<count; ++j) {
+                place(curve[first + j]);
+                indices.push_back(seenLocal[curve[first + j]]);
+            }
+            offsets.push_back(indices.size());
+            partIndices += pieceIndices;
+        }
+    }
+    // vertices of no curve still get a home, so that they can be updated and read back
+    for(size_t v=0; v<n; ++v) {
+        if(m_home[v].part != noPart) continue;
+        if(vertices.size() + 1 > m_maxVertices)
+            flush();
+        place(v);
+    }
+    if(! vertices.empty())
+        flush();
+    std::sort(m_copies.begin(), m_copies.end());
+
+    // number the edges of all parts one after the other
+    size_t base = 0;
+    for(shared_ptr<ofxGpuThicklines> &part : m_parts) {
+        part->setEdgeIdBase(unsigned(base));
+        base += part->numEdges();
+    }
+    if(base > 0x7fffffffu)
+        ofLogWarning("ofxGpuThicklines") << base << " edges overflow the int edge ids of the shaders";
+    ofLogVerbose("ofxGpuThicklines") << "split " << n << " vertices into " << m_parts.size() << " parts, "
+                                     << m_copies.size() << " vertices copied";
+}
+
+size_t ofxGpuThicklinesPaged::numEdges() const {
+    size_t edges = 0;
+    for(const shared_ptr<ofxGpuThicklines> &part : m_parts)
+        edges += part->numEdges();
+    return edges;
+}
+
+void ofxGpuThicklinesPaged::beginUpdates() {
+    for(shared_ptr<ofxGpuThicklines> &part : m_parts)
+        part->beginUpdates();
+}
+
+void ofxGpuThicklinesPaged::endUpdates() {
+    m_bytesUploaded = 0;
+    for(shared_ptr<ofxGpuThicklines> &part : m_parts) {
+        part->endUpdates();
+        m_bytesUploaded += part->bytesUploaded();
+    }
+}
+
+void ofxGpuThicklinesPaged::updatePosition(size_t i, ofVec3f v) {
+    forEachCopy(i, [&](ofxGpuThicklines &part, unsigned int local) { part.updatePosition(local, v); });
+}
+
+void ofxGpuThicklinesPaged::updateColor(size_t i, ofVec4f o) {
+    forEachCopy(i, [&](ofxGpuThicklines &part, unsigned int local) { part.updateColor(local, o); });
+}
+
+ofShader &ofxGpuThicklinesPaged::prepareDraw() {
+    m_shaderBegun = true;
+    return m_parts.empty() ? m_settings.prepareDraw() : m_parts[0]->prepareDraw();
+}
+
+void ofxGpuThicklinesPaged::draw(float lineWidth, bool perspective, ofVec2f viewportSize) {
+    if(m_parts.empty() && m_shaderBegun)
+        m_settings.draw(lineWidth, perspective, viewportSize); // ends the shader `prepareDraw()` began
+    // the first part draws with the shader `prepareDraw()` began, the others begin the same
+    // program again, which keeps the uniforms set on it
+    for(shared_ptr<ofxGpuThicklines> &part : m_parts)
+        part->draw(lineWidth, perspective, viewportSize);
+    m_shaderBegun = false;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxGpuThicklines.h"
+
+// a line set too large for a single ofxGpuThicklines, split into parts that are drawn one after
+// the other.
+//
+// every part is an ofxGpuThicklines of its own, with at most `maxVertices` vertices and
+// `maxIndices` indices, so that no buffer outgrows what ofVbo (int counts), buffer textures
+// (GL_MAX_TEXTURE_BUFFER_SIZE texels) or a single allocation can take, and 32 bit ids stay far
+// from overflowing. `setup()` hands the curves to the parts in order; curves longer than a part
+// are cut into pieces sharing their end points, which end square there. A vertex used by curves
+// in several parts is copied into each of them, and updates go to every copy.
+//
+// the parts number their edges one after the other, so the edge ids of the shaders are unique
+// over all parts, except for an edge whose curves landed in different parts, which has an id in
+// each of them.
+class ofxGpuThicklinesPaged
+{
+public:
+    ofxGpuThicklinesPaged() : m_maxVertices(defaultMaxVertices), m_maxIndices(defaultMaxIndices),
+                              m_bytesUploaded(0), m_shaderBegun(false) { ; }
+    virtual ~ofxGpuThicklinesPaged() { ; }
+
+    // 16M vertices and 64M indices, within the limits of current GPUs with room to spare
+    static const size_t defaultMaxVertices = size_t(1) << 24;
+    static const size_t defaultMaxIndices = size_t(1) << 26;
+    // takes effect on the next `setup()`
+    void setPartLimits(size_t maxVertices, size_t maxIndices);
+    size_t maxVertices() const { return m_maxVertices; }
+    size_t maxIndices() const { return m_maxIndices; }
+
+    // the parts are copies of this one: set the index mode, backend, vertex format, culling
+    // and so on here before `setup()`
+    ofxGpuThicklines &settings() { return m_settings; }
+
+    // like the corresponding `ofxGpuThicklines::setup()`. `texcoords` may be empty.
+    void setup(ofxGpuThicklines::StridedView<ofVec3f> positions, ofxGpuThicklines::StridedView<ofVec4f> colors,
+               ofxGpuThicklines::StridedView<ofVec2f> texcoords, ofxGpuThicklines::FlatCurves curves,
+               string customFragShader = "");
+    void setup(const vector<ofVec3f> &positions, const vector<ofVec4f> &colors,
+               const vector< vector<size_t> > &curves, string customFragShader = "");
+
+    size_t numParts() const { return m_parts.size(); }
+    ofxGpuThicklines &part(size_t i) { return *m_parts[i]; }
+    const ofxGpuThicklines &part(size_t i) const { return *m_parts[i]; }
+
+    size_t numPositions() const { return m_home.size(); }
+    const ofVec3f &position(size_t i) const { return m_parts[partOf(i)]->positions()[m_home[i].local]; }
+    const ofVec4f &color(size_t i) const { return m_parts[partOf(i)]->colors()[m_home[i].local]; }
+    size_t numEdges() const; // of all parts, copies of an edge in several parts counted in each
+
+    // as in ofxGpuThicklines, for the vertices passed to `setup()`
+    void beginUpdates();
+    void endUpdates();
+    void updatePosition(size_t i, ofVec3f v);
+    void updateColor(size_t i, ofVec4f o);
+    void updateVertex(size_t i, ofVec3f v, ofVec4f o) {
+        updatePosition(i, v);
+        updateColor(i, o);
+    }
+
+    // the parts share one shader program, so uniforms set after `prepareDraw()` hold for all of them
+    ofShader &prepareDraw();
+    void draw(float lineWidth = 3, bool perspective = true, ofVec2f viewportSize = ofVec2f(0,0));
+
+    // bytes sent to the GPU by the last `setup()` or `endUpdates()`, over all parts
+    size_t bytesUploaded() const { return m_bytesUploaded; }
+
+protected:
+    // where a vertex lives: its first part, and its index there
+    struct Home {
+        unsigned int part; // with `copiedBit` if other parts hold copies
+        unsigned int local;
+    };
+    // the other copies, sorted by vertex
+    struct Copy {
+        size_t vertex;
+        unsigned int part, local;
+        bool operator<(const Copy &other) const { return vertex < other.vertex; }
+    };
+    static const unsigned int copiedBit = 0x80000000u;
+    size_t partOf(size_t i) const { return m_home[i].part & ~copiedBit; }
+    template<typename F>
+    void forEachCopy(size_t i, F f); // calls f(part, local) for every copy of vertex i
+
+    ofxGpuThicklines m_settings;
+    size_t m_maxVertices, m_maxIndices;
+    vector< shared_ptr<ofxGpuThicklines> > m_parts;
+    vector<Home> m_home; // per vertex passed to `setup()`
+    vector<Copy> m_copies;
+    size_t m_bytesUploaded;
+    bool m_shaderBegun;
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// small helpers to spread CPU-side work of ofxGpuThicklines over all cores.
+//
+// work is handed to a lazily started pool of persistent worker threads, the calling thread
+// takes part as well. Calls made from inside a worker run serially on that worker, so
+// parallel stages can be nested without deadlocking.
+namespace ofxGpuThicklinesParallel {
+
+class Pool {
+public:
+    static Pool &instance() {
+        static Pool pool;
+        return pool;
+    }
+
+    size_t numThreads() const { return m_workers.size() + 1; }
+
+    // calls `fn(chunkIndex)` for every chunkIndex in [0, numChunks) and returns when all are done.
+    void run(size_t numChunks, const std::function<void(size_t)> &fn) {
+        if(numChunks == 0) return;
+        if(numChunks == 1 || m_workers.empty() || insideWorker()) {
+            for(size_t i=0; i<numChunks; ++i) fn(i);
+            return;
+        }
+
+        std::lock_guard<std::mutex> serialize(m_runMutex); // one parallel stage at a time
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = &fn;
+            m_numChunks = numChunks;
+            m_nextChunk = 0;
+            m_pending = numChunks;
+            ++m_generation;
+        }
+        m_wake.notify_all();
+
+        work();
+
+        // wait until every chunk is done and every worker that joined this stage has left it,
+        // so that no stale worker can pick up chunks of the next stage.
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_pending == 0; });
+        m_job = nullptr;
+        m_done.wait(lock, [this] { return m_active == 0; });
+    }
+
+private:
+    Pool() : m_job(nullptr), m_numChunks(0), m_nextChunk(0), m_pending(0), m_active(0), m_generation(0), m_quit(false) {
+        unsigned n = std::thread::hardware_concurrency();
+        for(unsigned i=1; i<n; ++i)
+            m_workers.push_back(std::thread(&Pool::loop, this));
+    }
+    ~Pool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_all();
+        for(std::thread &t : m_workers) t.join();
+    }
+
+    static bool &insideWorker() {
+        static thread_local bool inside = false;
+        return inside;
+    }
+
+    // grabs chunks until none are left
+    void work() {
+        bool &inside = insideWorker();
+        bool wasInside = inside;
+        inside = true;
+        size_t finished = 0;
+        while(true) {
+            size_t i = m_nextChunk.fetch_add(1);
+            if(i >= m_numChunks) break;
+            (*m_job)(i);
+            ++finished;
+        }
+        inside = wasInside;
+        if(finished > 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending -= finished;
+            if(m_pending == 0) m_done.notify_all();
+        }
+    }
+
+    void loop() {
+        uint64_t seen = 0;
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&] { return m_quit || (m_job && m_generation != seen); });
+                if(m_quit) return;
+                seen = m_generation;
+                ++m_active;
+            }
+            work();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                --m_active;
+            }
+            m_done.notify_all();
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_runMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake, m_done;
+    const std::function<void(size_t)> *m_job;
+    size_t m_numChunks;
+    std::atomic<size_t> m_nextChunk;
+    size_t m_pending;
+    size_t m_active; // workers currently inside work()
+    uint64_t m_generation;
+    bool m_quit;
+};
+
+inline size_t numThreads() { return Pool::instance().numThreads(); }
+
+// splits [0, n) into contiguous ranges of at least `minChunk` elements and calls
+// `fn(begin, end)` for each of them in parallel.
+template<typename F>
+void forRange(size_t n, F fn, size_t minChunk = 4096) {
+    if(n == 0) return;
+    size_t chunks = std::max<size_t>(1, std::min(n / std::max<size_t>(minChunk, 1), numThreads() * 4));
+    size_t step = (n + chunks - 1) / chunks;
+    Pool::instance().run(chunks, [&](size_t c) {
+        size_t begin = c * step;
+        size_t end = std::min(n, begin + step);
+        if(begin < end) fn(begin, end);
+    });
+}
+
+// number of parts for `forParts`: one per thread, but none smaller than `minChunk` elements
+inline size_t numParts(size_t n, size_t minChunk = 4096) {
+    return std::max<size_t>(1, std::min(n / std::max<size_t>(minChunk, 1), numThreads()));
+}
+
+// splits [0, n) into `parts` contiguous ranges and calls `fn(begin, end, part)` for each of them
+// in parallel. Useful for algorithms that keep scratch data (such as histograms) per part.
+template<typename F>
+void forParts(size_t n, size_t parts, F fn) {
+    size_t step = (n + parts - 1) / parts;
+    Pool::instance().run(parts, [&](size_t p) {
+        size_t begin = std::min(n, p * step);
+        size_t end = std::min(n, begin + step);
+        fn(begin, end, p);
+    });
+}
+
+// sorts 64-bit keys with a parallel LSD radix sort (8 bit digits).
+// only the digits of `maxKey`, which no key may exceed, are sorted, and of those the ones which
+// are the same for every key are skipped, so keys that only use a few of their bits (e.g. packed
+// pairs of small vertex indices) need fewer passes. A sentinel for dropped keys should therefore
+// be just above the real ones rather than ~0, which would make every digit count.
+inline void radixSort(std::vector<uint64_t> &keys, uint64_t maxKey = ~uint64_t(0)) {
+    const size_t n = keys.size();
+    if(n < 65536) {
+        std::sort(keys.begin(), keys.end());
+        return;
+    }
+
+    const size_t parts = numParts(n, 65536);
+    int digits = 0;
+    for(; digits<8 && (maxKey >> (8 * digits)) != 0; ++digits) {}
+
+    // global histograms of all digits at once, to find out which passes are needed
+    std::vector<size_t> totals(parts * 8 * 256, 0);
+    forParts(n, parts, [&](size_t begin, size_t end, size_t p) {
+        size_t *h = &totals[p * 8 * 256];
+        for(size_t i=begin; i<end; ++i) {
+            uint64_t k = keys[i];
+            for(int d=0; d<digits; ++d)
+                h[d * 256 + ((k >> (8 * d)) & 0xff)]++;
+        }
+    });
+
+    std::vector<uint64_t> tmp(n);
+    std::vector<size_t> hist(parts * 256);
+    for(int d=0; d<digits; ++d) {
+        bool trivial = false;
+        for(size_t b=0; b<256 && !trivial; ++b) {
+            size_t c = 0;
+            for(size_t p=0; p<parts; ++p) c += totals[p * 8 * 256 + d * 256 + b];
+            trivial = (c == n);
+        }
+        if(trivial) continue;
+
+        const int shift = 8 * d;
+        std::fill(hist.begin(), hist.end(), 0);
+        forParts(n, parts, [&](size_t begin, size_t end, size_t p) {
+            size_t *h = &hist[p * 256];
+            for(size_t i=begin; i<end; ++i)
+                h[(keys[i] >> shift) & 0xff]++;
+        });
+
+        // exclusive prefix sum, bucket-major and part-minor so that the sort stays stable
+        size_t sum = 0;
+        for(size_t b=0; b<256; ++b) {
+            for(size_t p=0; p<parts; ++p) {
+                size_t c = hist[p * 256 + b];
+                hist[p * 256 + b] = sum;
+                sum += c;
+            }
+        }
+
+        forParts(n, parts, [&](size_t begin, size_t end, size_t p) {
+            size_t *h = &hist[p * 256];
+            for(size_t i=begin; i<end; ++i) {
+                uint64_t k = keys[i];
+                tmp[h[(k >> shift) & 0xff]++] = k;
+            }
+        });
+        keys.swap(tmp);
+    }
+}
+
+} // namespace ofxGpuThicklinesParallel
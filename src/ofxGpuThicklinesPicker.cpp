@@ -0,0 +1,283 @@
+#include "ofxGpuThicklinesPicker.h"
+#include "ofxGpuThicklinesMath.h"
+#include "ofxGpuThicklinesParallel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // in cells: the row and column ranges a segment covers are widened by this much, so that
+    // rounding never leaves out a cell it touches
+    const float cellEpsilon = 1e-3f;
+
+    // the cell of a coordinate in cells, clamped to [-1, cells] where the conversion to int
+    // can't overflow. Rounds down without calling floor(), which this runs too often for.
+    inline int cellIndex(float v, int cells) {
+        v = std::min(std::max(v, -1.0f), float(cells));
+        const int i = int(v);
+        return i - (v < i);
+    }
+}
+
+void ofxGpuThicklinesPicker::setSegments(vector<unsigned int> segments, size_t numVertices) {
+    clear();
+    m_segments = std::move(segments);
+    m_numVertices = numVertices;
+    m_disabled.assign(numSegments(), 0);
+
+    // vertex -> segments, counting sort
+    m_vertexStart.assign(numVertices + 1, 0);
+    for(unsigned int v : m_segments)
+        ++m_vertexStart[v + 1];
+    for(size_t v=0; v<numVertices; ++v)
+        m_vertexStart[v + 1] += m_vertexStart[v];
+    m_vertexSegments.resize(m_vertexStart[numVertices]);
+    vector<unsigned int> fill(m_vertexStart.begin(), m_vertexStart.end() - 1);
+    for(size_t i=0; i<m_segments.size(); ++i)
+        m_vertexSegments[fill[m_segments[i]]++] = unsigned(i / 2);
+}
+
+void ofxGpuThicklinesPicker::clear() {
+    vector<unsigned int>().swap(m_segments);
+    vector<unsigned int>().swap(m_vertexStart);
+    vector<unsigned int>().swap(m_vertexSegments);
+    vector<unsigned char>().swap(m_disabled);
+    vector<ofVec3f>().swap(m_screen);
+    vector<unsigned int>().swap(m_cellStart);
+    vector<unsigned int>().swap(m_cellSegments);
+    vector<uint64_t>().swap(m_movedCells);
+    vector<unsigned char>().swap(m_state);
+    m_numMoved = 0;
+    m_dirty.clear();
+    m_numVertices = 0;
+    m_built = false;
+}
+
+void ofxGpuThicklinesPicker::moved(size_t begin, size_t end) {
+    // without a grid, the next pick projects everything anyway
+    if(m_built)
+        m_dirty.add(begin, std::min(end, m_numVertices));
+}
+
+void ofxGpuThicklinesPicker::setEnabled(size_t begin, size_t end, bool enabled) {
+    end = std::min(end, numSegments());
+    if(begin < end)
+        std::fill(m_disabled.begin() + begin, m_disabled.begin() + end, enabled ? 0 : 1);
+}
+
+size_t ofxGpuThicklinesPicker::memoryBytes() const {
+    return (m_segments.capacity() + m_vertexStart.capacity() + m_vertexSegments.capacity()
+            + m_cellStart.capacity() + m_cellSegments.capacity()) * sizeof(unsigned int)
+        + m_movedCells.capacity() * sizeof(uint64_t) + m_screen.capacity() * sizeof(ofVec3f) + m_state.capacity() + m_disabled.capacity();
+}
+
+void ofxGpuThicklinesPicker::project(const ofVec3f *positions, const unsigned int *vertices, size_t count) {
+    ofxGpuThicklinesParallel::forRange(count, [&](size_t begin, size_t end) {
+        for(size_t k=begin; k<end; ++k) {
+            const size_t v = vertices ? vertices[k] : k;
+            ofVec4f clip = ofxGpuThicklinesMath::toClip(m_matrix, positions[v]);
+            if(! (clip.w > 0)) {
+                m_screen[v] = ofVec3f(0, 0, 0); // behind the eye
+                continue;
+            }
+            m_screen[v] = ofVec3f(m_viewport.x + (clip.x / clip.w + 1.0f) * 0.5f * m_viewport.width,
+                                  m_viewport.y + (1.0f - clip.y / clip.w) * 0.5f * m_viewport.height, clip.w);
+        }
+    }, 4096);
+}
+
+template<typename F>
+void ofxGpuThicklinesPicker::forEachCell(size_t s, F f) const {
+    const ofVec3f &a = m_screen[m_segments[2 * s]], &b = m_screen[m_segments[2 * s + 1]];
+    const float scale = 1.0f / m_cellSize;
+    const int cellsX = m_cellsX, cellsY = m_cellsY;
+    const float ax = (a.x - m_viewport.x) * scale, ay = (a.y - m_viewport.y) * scale;
+    const float bx = (b.x - m_viewport.x) * scale, by = (b.y - m_viewport.y) * scale;
+    const int row0 = std::max(0, cellIndex(std::min(ay, by) - cellEpsilon, cellsY));
+    const int row1 = std::min(cellsY - 1, cellIndex(std::max(ay, by) + cellEpsilon, cellsY));
+    if(row0 == row1) {
+        // most segments are short and stay in one row
+        const int col0 = std::max(0, cellIndex(std::min(ax, bx) - cellEpsilon, cellsX));
+        const int col1 = std::min(cellsX - 1, cellIndex(std::max(ax, bx) + cellEpsilon, cellsX));
+        for(int col=col0; col<=col1; ++col)
+            f(size_t(row0) * cellsX + col);
+        return;
+    }
+    const float dxdy = (bx - ax) / (by - ay);
+    for(int row=row0; row<=row1; ++row) {
+        // the part of the segment within the row
+        const float y0 = std::max(float(row), std::min(ay, by)), y1 = std::min(float(row + 1), std::max(ay, by));
+        float x0 = ax + (y0 - ay) * dxdy, x1 = ax + (y1 - ay) * dxdy;
+        if(x0 > x1) std::swap(x0, x1);
+        const int col0 = std::max(0, cellIndex(x0 - cellEpsilon, cellsX));
+        const int col1 = std::min(cellsX - 1, cellIndex(x1 + cellEpsilon, cellsX));
+        for(int col=col0; col<=col1; ++col)
+            f(size_t(row) * cellsX + col);
+    }
+}
+
+void ofxGpuThicklinesPicker::buildGrid() {
+    const size_t n = numSegments();
+    m_cellStart.assign(size_t(m_cellsX) * m_cellsY + 1, 0);
+    for(size_t s=0; s<n; ++s) {
+        if(onScreen(s))
+            forEachCell(s, [&](size_t cell) { ++m_cellStart[cell + 1]; });
+    }
+    for(size_t c=1; c<m_cellStart.size(); ++c)
+        m_cellStart[c] += m_cellStart[c - 1];
+    m_cellSegments.resize(m_cellStart.back());
+    vector<unsigned int> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+    for(size_t s=0; s<n; ++s) {
+        if(onScreen(s))
+            forEachCell(s, [&](size_t cell) { m_cellSegments[fill[cell]++] = unsigned(s); });
+    }
+}
+
+void ofxGpuThicklinesPicker::rebuild(const ofVec3f *positions) {
+    m_built = true;
+    m_stats.rebuilt = true;
+    m_dirty.clear();
+    vector<uint64_t>().swap(m_movedCells);
+    m_numMoved = 0;
+    m_state.assign(numSegments(), IN_GRID);
+    m_screen.resize(m_numVertices);
+    project(positions, nullptr, m_numVertices);
+
+    // cells of about `segmentsPerCell` segments, or half as large as the average segment, so
+    // that long segments don't fill many cells each
+    size_t visible = 0;
+    double length = 0;
+    const float diagonal = std::sqrt(m_viewport.width * m_viewport.width + m_viewport.height * m_viewport.height);
+    for(size_t s=0; s<numSegments(); ++s) {
+        if(! onScreen(s)) continue;
+        ++visible;
+        const ofVec3f &a = m_screen[m_segments[2 * s]], &b = m_screen[m_segments[2 * s + 1]];
+        length += std::min(ofVec2f(b.x - a.x, b.y - a.y).length(), diagonal);
+    }
+    const float area = m_viewport.width * m_viewport.height;
+    m_cellSize = std::max(m_viewport.width, m_viewport.height);
+    if(visible > 0) {
+        m_cellSize = std::min(m_cellSize, std::max(std::sqrt(area * segmentsPerCell / visible), float(0.5 * length / visible)));
+        m_cellSize = std::max(m_cellSize, 1.0f);
+    }
+    m_cellsX = std::max(1, int(std::ceil(m_viewport.width / m_cellSize)));
+    m_cellsY = std::max(1, int(std::ceil(m_viewport.height / m_cellSize)));
+    buildGrid();
+}
+
+void ofxGpuThicklinesPicker::update(const ofVec3f *positions) {
+    // the segments at the moved vertices, each once. Those moved before leave their old cells,
+    // found from where they were projected to then.
+    vector<unsigned int> vertices, changed;
+    vector<uint64_t> removed, added;
+    for(const ofxGpuThicklinesRanges::DirtyRanges::Range &r : m_dirty.coalesce()) {
+        for(size_t v=r.first; v<r.second; ++v)
+            vertices.push_back(unsigned(v));
+        for(unsigned int k=m_vertexStart[r.first]; k<m_vertexStart[r.second]; ++k) {
+            const unsigned int s = m_vertexSegments[k];
+            if(m_state[s] == CHANGED) continue;
+            if(m_state[s] == MOVED && onScreen(s))
+                forEachCell(s, [&](size_t cell) { removed.push_back(movedKey(cell, s)); });
+            if(m_state[s] == IN_GRID)
+                ++m_numMoved;
+            m_state[s] = CHANGED;
+            changed.push_back(s);
+        }
+    }
+    m_dirty.clear();
+    project(positions, vertices.data(), vertices.size());
+    if(m_numMoved * rebuildFraction > numSegments()) {
+        rebuild(positions);
+        return;
+    }
+    for(unsigned int s : changed) {
+        m_state[s] = MOVED;
+        if(onScreen(s))
+            forEachCell(s, [&](size_t cell) { added.push_back(movedKey(cell, s)); });
+    }
+
+    // one pass over the moved segments, which stay sorted by cell
+    std::sort(removed.begin(), removed.end());
+    std::sort(added.begin(), added.end());
+    vector<uint64_t> merged;
+    merged.reserve(m_movedCells.size() - removed.size() + added.size());
+    vector<uint64_t>::const_iterator r = removed.begin(), a = added.begin();
+    for(uint64_t key : m_movedCells) {
+        while(r != removed.end() && *r < key) ++r;
+        if(r != removed.end() && *r == key) {
+            ++r;
+            continue;
+        }
+        for(; a != added.end() && *a < key; ++a)
+            merged.push_back(*a);
+        merged.push_back(key);
+    }
+    merged.insert(merged.end(), a, added.cend());
+    m_movedCells.swap(merged);
+}
+
+void ofxGpuThicklinesPicker::measure(unsigned int s, ofVec2f p, float radius, Hit &best, float &bestAlong) {
+    if(m_disabled[s]) return;
+    ++m_stats.tested;
+    const ofVec3f &a = m_screen[m_segments[2 * s]], &b = m_screen[m_segments[2 * s + 1]];
+    const ofVec2f ab(b.x - a.x, b.y - a.y), ap(p.x - a.x, p.y - a.y);
+    const float lengthSquared = ab.lengthSquared();
+    const float along = lengthSquared > 0 ? ofClamp(ap.dot(ab) / lengthSquared, 0, 1) : 0;
+    const float distance = (ap - ab * along).length();
+    if(distance > radius) return;
+    if(! best.hit || distance < best.distance || (distance == best.distance && s < best.segment)) {
+        best.hit = true;
+        best.segment = s;
+        best.distance = distance;
+        bestAlong = along;
+    }
+}
+
+ofxGpuThicklinesPicker::Hit ofxGpuThicklinesPicker::pick(const ofVec3f *positions, ofVec2f screenPoint,
+                                                          const ofMatrix4x4 &modelViewProjection,
+                                                          const ofRectangle &viewport, float radius) {
+    uint64_t t0 = ofGetElapsedTimeMicros();
+    m_stats.rebuilt = false;
+    m_stats.tested = 0;
+    Hit best = Hit();
+    if(numSegments() == 0 || viewport.width <= 0 || viewport.height <= 0) {
+        m_stats.milliseconds = (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+        return best;
+    }
+
+    if(! m_built || modelViewProjection != m_matrix || viewport != m_viewport) {
+        m_matrix = modelViewProjection;
+        m_viewport = viewport;
+        rebuild(positions);
+    }
+    else if(! m_dirty.empty()) {
+        update(positions);
+    }
+    m_stats.cells = size_t(m_cellsX) * m_cellsY;
+    m_stats.movedSegments = m_numMoved;
+
+    // the cells within `radius`. A segment in several of them is measured each time, which is
+    // cheaper than keeping track of the ones seen.
+    const float scale = 1.0f / m_cellSize;
+    const float px = (screenPoint.x - m_viewport.x) * scale, py = (screenPoint.y - m_viewport.y) * scale, r = radius * scale;
+    const int col0 = std::max(0, cellIndex(px - r, m_cellsX)), col1 = std::min(m_cellsX - 1, cellIndex(px + r, m_cellsX));
+    const int row0 = std::max(0, cellIndex(py - r, m_cellsY)), row1 = std::min(m_cellsY - 1, cellIndex(py + r, m_cellsY));
+    float along = 0; // on screen
+    for(int row=row0; row<=row1 && col0<=col1; ++row) {
+        const size_t first = size_t(row) * m_cellsX + col0, last = size_t(row) * m_cellsX + col1;
+        for(unsigned int k=m_cellStart[first]; k<m_cellStart[last + 1]; ++k) {
+            if(m_state[m_cellSegments[k]] == IN_GRID)
+                measure(m_cellSegments[k], screenPoint, radius, best, along);
+        }
+        for(vector<uint64_t>::const_iterator it = std::lower_bound(m_movedCells.begin(), m_movedCells.end(), movedKey(first, 0));
+            it != m_movedCells.end() && (*it >> 32) <= last; ++it)
+            measure(unsigned(*it), screenPoint, radius, best, along);
+    }
+    if(best.hit) {
+        // on screen the segment is interpolated linearly in x / w and y / w, in object space in x and y
+        const float wa = m_screen[m_segments[2 * best.segment]].z, wb = m_screen[m_segments[2 * best.segment + 1]].z;
+        const float denominator = (1.0f - along) * wb + along * wa;
+        best.t = denominator > 0 ? along * wa / denominator : along;
+    }
+    m_stats.milliseconds = (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+    return best;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxGpuThicklinesRanges.h"
+
+// finds the segment closest to a point on screen, for hovering and selection, see
+// `ofxGpuThicklines::pick()`.
+//
+// the segments are projected with the matrix of the pick and sorted into a uniform grid over
+// the viewport, each into every cell it passes through, so a pick only measures the segments of
+// the few cells within its radius. The grid is kept while the matrix and viewport stay the same.
+// Segments at vertices that moved since are taken out of it and kept apart, in a list sorted by
+// cell. A pick only projects the vertices moved since the last one and merges their segments
+// into that list; once it holds more than 1 / `rebuildFraction` of the segments, or the view
+// changes, the whole grid is built anew.
+//
+// that rebuild is O(N) in the vertices and segments, and nothing of the old grid is reused: any
+// change of the matrix or viewport, such as every frame of a moving camera, pays for projecting
+// every vertex and sorting every segment into its cells, several times the cost of measuring
+// every segment once. The grid only pays off for several picks per view.
+//
+// only segments reaching into the viewport with both ends in front of the eye can be picked.
+class ofxGpuThicklinesPicker
+{
+public:
+    ofxGpuThicklinesPicker() : m_numVertices(0), m_built(false), m_cellSize(1), m_cellsX(0), m_cellsY(0), m_numMoved(0) {
+        m_stats = Stats();
+    }
+
+    static const size_t rebuildFraction = 8;
+    static const size_t segmentsPerCell = 4; // on average, for segments short compared to a cell
+
+    // the segments as pairs of vertex indices into `numVertices` vertices. Forgets the grid.
+    void setSegments(vector<unsigned int> segments, size_t numVertices);
+    size_t numSegments() const { return m_segments.size() / 2; }
+    // vertices [begin, end) moved, their segments are sorted again by the next pick
+    void moved(size_t begin, size_t end);
+    // whether segments [begin, end) can be picked. They stay in the grid either way.
+    void setEnabled(size_t begin, size_t end, bool enabled);
+    void clear();
+
+    struct Hit {
+        bool hit;
+        size_t segment;
+        float t;        // where on the segment, in object space: 0 at its first vertex, 1 at the second
+        float distance; // from the point to the segment on screen, in pixels
+    };
+    // the segment closest to `screenPoint` within `radius` pixels. `screenPoint` and `viewport` are
+    // in window pixels, y pointing down like the mouse position; `modelViewProjection` is in the
+    // row vector convention of ofMatrix4x4, as `ofxGpuThicklines::draw()` hands it to the shaders.
+    Hit pick(const ofVec3f *positions, ofVec2f screenPoint, const ofMatrix4x4 &modelViewProjection,
+             const ofRectangle &viewport, float radius);
+
+    struct Stats {
+        size_t cells;
+        size_t movedSegments; // kept apart from the grid
+        size_t tested;        // segments measured by the last pick
+        bool rebuilt;         // the last pick built the whole grid
+        float milliseconds;   // of the last pick
+    };
+    const Stats &stats() const { return m_stats; }
+
+    size_t memoryBytes() const;
+
+protected:
+    enum SegmentState { IN_GRID, MOVED, CHANGED }; // CHANGED: moved again, during `update()`
+    static uint64_t movedKey(size_t cell, unsigned int s) { return uint64_t(cell) << 32 | s; }
+    void project(const ofVec3f *positions, const unsigned int *vertices, size_t count); // all for `vertices == nullptr`
+    bool onScreen(size_t s) const { return m_screen[m_segments[2 * s]].z > 0 && m_screen[m_segments[2 * s + 1]].z > 0; }
+    void rebuild(const ofVec3f *positions);
+    void buildGrid();
+    void update(const ofVec3f *positions); // for the vertices moved since the last pick
+    template<typename F>
+    void forEachCell(size_t s, F f) const; // f(cell) for the cells segment s passes through
+    void measure(unsigned int s, ofVec2f p, float radius, Hit &best, float &bestAlong);
+
+    vector<unsigned int> m_segments;
+    size_t m_numVertices;
+    vector<unsigned int> m_vertexStart, m_vertexSegments; // vertex -> segments, CSR
+    vector<unsigned char> m_disabled; // per segment
+
+    bool m_built;
+    ofMatrix4x4 m_matrix;
+    ofRectangle m_viewport;
+    vector<ofVec3f> m_screen; // per vertex: window position and clip space w
+    float m_cellSize;
+    int m_cellsX, m_cellsY;
+    vector<unsigned int> m_cellStart, m_cellSegments; // cell -> segments, CSR
+    vector<unsigned char> m_state; // per segment, a SegmentState
+    vector<uint64_t> m_movedCells; // the MOVED segments by cell, as sorted `movedKey()`s
+    size_t m_numMoved;
+    ofxGpuThicklinesRanges::DirtyRanges m_dirty; // vertices moved since the last pick
+    Stats m_stats;
+};
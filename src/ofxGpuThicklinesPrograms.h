@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+// sharing of linked shader programs between the instances of ofxGpuThicklines
+namespace ofxGpuThicklinesPrograms {
+
+// programs of type T by key, alive as long as someone holds them. `get()` only builds a program
+// the first time its key is asked for, or again after all holders let go of it. The registry
+// itself only keeps weak references, so nothing outlives the GL context in it.
+//
+// Programs are found by the hash of their key, and the key itself is kept to tell apart the
+// ones whose hashes collide: Key is whatever the program is made from, compared with `==`.
+//
+// T is ofShader in the addon; anything default constructible works, so that the sharing can
+// be tried without a GL context.
+template<typename T, typename Key>
+class Registry {
+public:
+    Registry() : m_builds(0) {}
+
+    // `build(T&)` makes the program for `key`, `hash` is the hash of `key`
+    template<typename Build>
+    std::shared_ptr<T> get(uint64_t hash, const Key &key, Build build) {
+        purge(); // what is left is alive
+        std::pair<typename Map::iterator, typename Map::iterator> same = m_programs.equal_range(hash);
+        for(typename Map::iterator it=same.first; it!=same.second; ++it) {
+            if(it->second.key == key)
+                return it->second.program.lock();
+        }
+        std::shared_ptr<T> program = std::make_shared<T>();
+        build(*program);
+        Entry entry = { key, program };
+        m_programs.insert(std::make_pair(hash, entry));
+        ++m_builds;
+        return program;
+    }
+
+    // the programs held by someone right now
+    size_t size() const {
+        size_t n = 0;
+        for(const typename Map::value_type &p : m_programs)
+            n += p.second.program.expired() ? 0 : 1;
+        return n;
+    }
+    // how often `get()` had to build a program
+    size_t builds() const { return m_builds; }
+
+private:
+    struct Entry {
+        Key key;
+        std::weak_ptr<T> program;
+    };
+    typedef std::multimap<uint64_t, Entry> Map;
+
+    void purge() {
+        for(typename Map::iterator it=m_programs.begin(); it!=m_programs.end();) {
+            if(it->second.program.expired())
+                it = m_programs.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    Map m_programs;
+    size_t m_builds;
+};
+
+} // namespace ofxGpuThicklinesPrograms
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+// conversion of vertex attributes to the compact formats of `ofxGpuThicklines::VertexFormat`.
+//
+// the loops work on flat float arrays without branches in the common path, so that the
+// compiler can vectorize them; half floats use the F16C instructions where the build enables
+// them (-mf16c).
+namespace ofxGpuThicklinesQuantize {
+
+// largest finite half float, larger values saturate to it
+const float halfMax = 65504.0f;
+
+// round to nearest even, like the GPU and F16C do. Infinities saturate, NaN has no defined result.
+inline uint16_t toHalf(float f) {
+    uint32_t x;
+    memcpy(&x, &f, 4);
+    const uint32_t sign = (x >> 16) & 0x8000;
+    x &= 0x7fffffff;
+    uint32_t h;
+    if(x >= 0x477ff000) { // rounds to 65520 or more, or isn't a number
+        h = x > 0x7f800000 ? 0x7e00 : 0x7bff;
+    }
+    else if(x < 0x38800000) { // subnormal: let the float adder do the rounding
+        float a;
+        memcpy(&a, &x, 4);
+        a += 0.5f;
+        memcpy(&h, &a, 4);
+        h -= 0x3f000000;
+    }
+    else { // rebias the exponent and round the mantissa
+        x += 0xc8000fff + ((x >> 13) & 1);
+        h = x >> 13;
+    }
+    return uint16_t(sign | h);
+}
+
+inline float fromHalf(uint16_t h) {
+    const uint32_t sign = uint32_t(h & 0x8000) << 16;
+    const uint32_t exponent = (h >> 10) & 0x1f;
+    const uint32_t mantissa = h & 0x3ff;
+    uint32_t x;
+    if(exponent == 0x1f) { // infinity or NaN
+        x = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if(exponent == 0) { // zero or subnormal
+        float f = float(mantissa) * (1.0f / 16777216.0f);
+        memcpy(&x, &f, 4);
+        x |= sign;
+    }
+    else {
+        x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float f;
+    memcpy(&f, &x, 4);
+    return f;
+}
+
+// `n` floats to half floats
+inline void packHalf(const float *in, size_t n, uint16_t *out) {
+    size_t i = 0;
+#if defined(__F16C__)
+    const __m128 lo = _mm_set1_ps(-halfMax), hi = _mm_set1_ps(halfMax);
+    for(; i + 4 <= n; i += 4) {
+        __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), lo), hi);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_cvtps_ph(v, 0));
+    }
+#endif
+    for(; i<n; ++i)
+        out[i] = toHalf(in[i]);
+}
+
+// `n` points of 3 floats to 4 half floats each, the 4th is 1. Points start `outStride` values
+// apart in `out`, for interleaved vertices.
+inline void packHalfPoints(const float *in, size_t n, uint16_t *out, size_t outStride = 4) {
+#if defined(__F16C__)
+    const __m128 lo = _mm_set1_ps(-halfMax), hi = _mm_set1_ps(halfMax);
+    for(size_t i=0; i<n; ++i) {
+        const float *p = in + 3 * i;
+        __m128 v = _mm_min_ps(_mm_max_ps(_mm_setr_ps(p[0], p[1], p[2], 1.0f), lo), hi);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + outStride * i), _mm_cvtps_ph(v, 0));
+    }
+#else
+    for(size_t i=0; i<n; ++i) {
+        for(int c=0; c<3; ++c)
+            out[outStride * i + c] = toHalf(in[3 * i + c]);
+        out[outStride * i + 3] = 0x3c00;
+    }
+#endif
+}
+
+// `n` points of 3 floats to 4 unsigned normalized 16 bit values, each coordinate mapped from
+// [offset, offset + scale] to [0, 65535] and clamped. The 4th is 65535, i.e. 1. `outStride` as above.
+inline void packUnorm16Points(const float *in, size_t n, const float offset[3], const float scale[3], uint16_t *out,
+                              size_t outStride = 4) {
+    float inverse[3];
+    for(int c=0; c<3; ++c)
+        inverse[c] = scale[c] > 0 ? 65535.0f / scale[c] : 0.0f;
+    for(size_t i=0; i<n; ++i) {
+        for(int c=0; c<3; ++c) {
+            float v = (in[3 * i + c] - offset[c]) * inverse[c];
+            out[outStride * i + c] = uint16_t(std::min(std::max(v, 0.0f), 65535.0f) + 0.5f);
+        }
+        out[outStride * i + 3] = 0xffff;
+    }
+}
+
+// `n` floats in [0, 1] to unsigned normalized bytes, clamped
+inline void packUnorm8(const float *in, size_t n, uint8_t *out) {
+    for(size_t i=0; i<n; ++i)
+        out[i] = uint8_t(std::min(std::max(in[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// the largest error of a coordinate within [-maxAbs, maxAbs] after `packHalf`, up to halfMax:
+// half an ulp, 2^-11 relative to the power of two at or above it, and 2^-25 for subnormals
+inline float halfError(float maxAbs) {
+    if(maxAbs < 6.103515625e-05f) return 2.98023224e-08f;
+    int e;
+    std::frexp(std::min(maxAbs, halfMax), &e);
+    return std::ldexp(1.0f, e - 12);
+}
+
+// the largest error of a coordinate after `packUnorm16Points` with `scale`, inside the range
+inline float unorm16Error(float scale) { return scale / 65535.0f * 0.5f; }
+
+// the largest error of a color channel in [0, 1] after `packUnorm8`
+const float unorm8Error = 0.5f / 255.0f;
+
+} // namespace ofxGpuThicklinesQuantize
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+// bookkeeping of element ranges inside the buffers of ofxGpuThicklines
+namespace ofxGpuThicklinesRanges {
+
+// hands out blocks of a linear element space (e.g. an index buffer) and takes them back.
+//
+// freed blocks go to a free list that is coalesced with its neighbours and searched best-fit.
+// blocks are only appended at the end when no free block is large enough, and freeing the
+// last block shrinks the used space again.
+class BlockAllocator {
+public:
+    BlockAllocator() : m_end(0), m_freeElements(0) {}
+
+    // forget all blocks, with [0, end) considered allocated
+    void reset(size_t end = 0) {
+        m_byOffset.clear();
+        m_bySize.clear();
+        m_end = end;
+        m_freeElements = 0;
+    }
+
+    // returns the offset of a new block of `n` elements
+    size_t allocate(size_t n) {
+        if(n == 0) return 0;
+        std::multimap<size_t, size_t>::iterator fit = m_bySize.lower_bound(n);
+        if(fit == m_bySize.end()) {
+            size_t offset = m_end;
+            m_end += n;
+            return offset;
+        }
+        size_t offset = fit->second;
+        size_t size = fit->first;
+        eraseFree(offset, size);
+        if(size > n)
+            insertFree(offset + n, size - n);
+        return offset;
+    }
+
+    void release(size_t offset, size_t n) {
+        if(n == 0) return;
+        // merge with the free block right after ...
+        std::map<size_t, size_t>::iterator next = m_byOffset.find(offset + n);
+        if(next != m_byOffset.end()) {
+            n += next->second;
+            eraseFree(next->first, next->second);
+        }
+        // ... and right before
+        std::map<size_t, size_t>::iterator prev = m_byOffset.lower_bound(offset);
+        if(prev != m_byOffset.begin()) {
+            --prev;
+            if(prev->first + prev->second == offset) {
+                offset = prev->first;
+                n += prev->second;
+                eraseFree(prev->first, prev->second);
+            }
+        }
+        if(offset + n == m_end)
+            m_end = offset;
+        else
+            insertFree(offset, n);
+    }
+
+    // one past the last element in use. Everything in [0, end()) not handed out is free.
+    size_t end() const { return m_end; }
+    // number of free elements below `end()`
+    size_t freeElements() const { return m_freeElements; }
+    const std::map<size_t, size_t> &freeBlocks() const { return m_byOffset; }
+
+private:
+    void insertFree(size_t offset, size_t n) {
+        m_byOffset[offset] = n;
+        m_bySize.insert(std::make_pair(n, offset));
+        m_freeElements += n;
+    }
+    void eraseFree(size_t offset, size_t n) {
+        m_byOffset.erase(offset);
+        std::pair<std::multimap<size_t, size_t>::iterator, std::multimap<size_t, size_t>::iterator> r = m_bySize.equal_range(n);
+        for(std::multimap<size_t, size_t>::iterator it = r.first; it != r.second; ++it) {
+            if(it->second == offset) {
+                m_bySize.erase(it);
+                break;
+            }
+        }
+        m_freeElements -= n;
+    }
+
+    std::map<size_t, size_t> m_byOffset;     // offset -> size
+    std::multimap<size_t, size_t> m_bySize;  // size -> offset
+    size_t m_end;
+    size_t m_freeElements;
+};
+
+// collects ranges of modified elements so that only those get uploaded.
+//
+// consecutive additions that touch the previous range are merged right away (the common
+// case of updating neighbouring vertices in a loop), `coalesce()` sorts and merges the rest.
+// the list is coalesced in place whenever it grows past `maxRanges`. Updates scattered so
+// widely that it stays long switch it to a bitmap of 1 bit per element, which `coalesce()`
+// and `ranges()` turn back into sorted ranges, without sorting.
+class DirtyRanges {
+public:
+    typedef std::pair<size_t, size_t> Range; // [first, second)
+
+    static const size_t maxRanges = 4096;
+
+    DirtyRanges() : m_bitmap(false) {}
+
+    void add(size_t begin, size_t end) {
+        if(begin >= end) return;
+        if(m_bitmap) {
+            setBits(begin, end);
+            return;
+        }
+        if(! m_ranges.empty()) {
+            Range &last = m_ranges.back();
+            if(begin <= last.second && end >= last.first) {
+                last.first = std::min(last.first, begin);
+                last.second = std::max(last.second, end);
+                return;
+            }
+        }
+        m_ranges.push_back(Range(begin, end));
+        if(m_ranges.size() > maxRanges) {
+            // at least maxRanges / 2 more additions before the next time
+            coalesce();
+            if(m_ranges.size() > maxRanges / 2)
+                toBitmap();
+        }
+    }
+    void add(size_t i) { add(i, i + 1); }
+
+    // sorts the ranges and merges those that overlap or are less than `gap` elements apart.
+    const std::vector<Range> &coalesce(size_t gap = 0) {
+        if(m_bitmap) {
+            fromBitmap(gap);
+        }
+        else if(m_ranges.size() > 1) {
+            std::sort(m_ranges.begin(), m_ranges.end());
+            size_t out = 0;
+            for(size_t i=1; i<m_ranges.size(); ++i) {
+                if(m_ranges[i].first <= m_ranges[out].second + gap)
+                    m_ranges[out].second = std::max(m_ranges[out].second, m_ranges[i].second);
+                else
+                    m_ranges[++out] = m_ranges[i];
+            }
+            m_ranges.resize(out + 1);
+        }
+        return m_ranges;
+    }
+
+    // number of elements covered. Only exact after `coalesce()`, or in bitmap mode.
+    size_t count() const {
+        size_t n = 0;
+        if(m_bitmap) {
+            for(uint64_t word : m_bits) n += bitCount(word);
+            return n;
+        }
+        for(const Range &r : m_ranges) n += r.second - r.first;
+        return n;
+    }
+
+    // in bitmap mode sorted and merged, as by `coalesce()`
+    const std::vector<Range> &ranges() const {
+        if(m_bitmap)
+            fromBitmap(0);
+        return m_ranges;
+    }
+    bool empty() const { return ! m_bitmap && m_ranges.empty(); }
+    void clear() {
+        m_ranges.clear();
+        m_bits.clear();
+        m_bitmap = false;
+    }
+
+private:
+    static size_t bitCount(uint64_t x) {
+        x = x - ((x >> 1) & 0x5555555555555555ull);
+        x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+        x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+        return size_t((x * 0x0101010101010101ull) >> 56);
+    }
+    static size_t lowestBit(uint64_t x) { // of x != 0
+        size_t i = 0;
+        for(; (x & 0xff) == 0; x >>= 8) i += 8;
+        for(; (x & 1) == 0; x >>= 1) ++i;
+        return i;
+    }
+    void setBits(size_t begin, size_t end) {
+        if((end + 63) / 64 > m_bits.size())
+            m_bits.resize((end + 63) / 64, 0);
+        for(size_t i=begin; i<end; ) {
+            const size_t bit = i % 64, n = std::min<size_t>(64 - bit, end - i);
+            m_bits[i / 64] |= (n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << bit;
+            i += n;
+        }
+    }
+    void toBitmap() {
+        m_bitmap = true;
+        for(const Range &r : m_ranges)
+            setBits(r.first, r.second);
+        m_ranges.clear();
+    }
+    // the runs of set bits, runs less than `gap` apart merged
+    void fromBitmap(size_t gap) const {
+        m_ranges.clear();
+        const size_t words = m_bits.size();
+        size_t w = 0;
+        uint64_t word = words > 0 ? m_bits[0] : 0;
+        while(true) {
+            // the next set bit, then the next clear one
+            while(word == 0 && ++w < words) word = m_bits[w];
+            if(word == 0) break;
+            const size_t begin = w * 64 + lowestBit(word);
+            word = ~word & (~uint64_t(0) << (begin % 64));
+            while(word == 0 && ++w < words) word = ~m_bits[w];
+            const size_t end = word == 0 ? words * 64 : w * 64 + lowestBit(word);
+            if(! m_ranges.empty() && begin <= m_ranges.back().second + gap)
+                m_ranges.back().second = end;
+            else
+                m_ranges.push_back(Range(begin, end));
+            if(word == 0) break;
+            word = ~word & (~uint64_t(0) << (end % 64));
+        }
+    }
+
+    mutable std::vector<Range> m_ranges; // in bitmap mode, what the last `ranges()` or `coalesce()` made of it
+    std::vector<uint64_t> m_bits;
+    bool m_bitmap;
+};
+
+// uploads the elements of `data` in `ranges` to `buffer` (an ofBufferObject), returns the number of bytes sent
+template<typename Buffer, typename T>
+size_t uploadRanges(Buffer &buffer, const std::vector<T> &data, const std::vector<DirtyRanges::Range> &ranges) {
+    size_t bytes = 0;
+    for(const DirtyRanges::Range &r : ranges) {
+        buffer.updateData(r.first * sizeof(T), (r.second - r.first) * sizeof(T), &data[r.first]);
+        bytes += (r.second - r.first) * sizeof(T);
+    }
+    return bytes;
+}
+
+} // namespace ofxGpuThicklinesRanges
@@ -0,0 +1,238 @@
+#include "ofxGpuThicklinesRasterizer.h"
+#include "ofxGpuThicklinesParallel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const int subpixelBits = 8;
+    const int32_t subpixels = 1 << subpixelBits;
+
+    // twice the signed area of (a, b, p), positive if p lies left of a -> b
+    inline int64_t orient(int32_t ax, int32_t ay, int32_t bx, int32_t by, int32_t px, int32_t py) {
+        return int64_t(bx - ax) * int64_t(py - ay) - int64_t(by - ay) * int64_t(px - ax);
+    }
+
+    // pixels whose center lies in [lo, hi], in 1/256 pixel
+    inline int firstCenter(int32_t lo) { return (lo - subpixels / 2 + subpixels - 1) >> subpixelBits; }
+    inline int lastCenter(int32_t hi) { return (hi - subpixels / 2) >> subpixelBits; }
+
+    // floor(a / b) for b > 0
+    inline int64_t floorDiv(int64_t a, int64_t b) {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    inline unsigned char toByte(float v) {
+        return (unsigned char)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    // `src * sourceFactor + dst * destinationFactor` per channel, with the factors of the blend
+    // mode as openFrameworks passes them to glBlendFunc
+    inline void blend(ofBlendMode mode, const float src[4], unsigned char *out) {
+        const float sa = src[3];
+        for(int c=0; c<4; ++c) {
+            const float d = out[c] / 255.0f;
+            float v;
+            switch(mode) {
+                case OF_BLENDMODE_ALPHA:    v = src[c] * sa + d * (1.0f - sa); break;
+                case OF_BLENDMODE_ADD:      v = src[c] * sa + d; break;
+                case OF_BLENDMODE_SUBTRACT: v = d - src[c] * sa; break; // GL_FUNC_REVERSE_SUBTRACT
+                case OF_BLENDMODE_MULTIPLY: v = src[c] * d + d * (1.0f - sa); break;
+                case OF_BLENDMODE_SCREEN:   v = src[c] * (1.0f - d) + d; break;
+                default:                    v = src[c]; break;
+            }
+            out[c] = toByte(v);
+        }
+    }
+}
+
+void ofxGpuThicklinesRasterizer::allocate(size_t width, size_t height, const ofFloatColor &background) {
+    m_pixels.allocate(width, height, 4);
+    clear(background);
+}
+
+void ofxGpuThicklinesRasterizer::clear(const ofFloatColor &background) {
+    const unsigned char color[4] = { toByte(background.r), toByte(background.g), toByte(background.b), toByte(background.a) };
+    unsigned char *p = m_pixels.getData();
+    for(size_t i=0; i<width() * height(); ++i, p+=4)
+        std::copy(color, color + 4, p);
+}
+
+void ofxGpuThicklinesRasterizer::draw(const ofxGpuThicklines &lines, const ofMatrix4x4 &modelViewProjection,
+                                      float lineWidth, bool perspective) {
+    m_tessellator.tessellate(lines, modelViewProjection, ofVec2f(width(), height()), lineWidth, perspective, m_triangles);
+    draw(m_triangles);
+    m_stats.tessellateMs = m_tessellator.stats().milliseconds;
+}
+
+void ofxGpuThicklinesRasterizer::draw(const ofxGpuThicklinesTessellator::Output &triangles) {
+    m_stats = Stats();
+    if(width() == 0 || height() == 0) return;
+    uint64_t t0 = ofGetElapsedTimeMicros();
+
+    const int w = int(width()), h = int(height());
+    const size_t tilesX = (width() + tileSize - 1) / tileSize;
+    const size_t numTiles = tilesX * ((height() + tileSize - 1) / tileSize);
+    const size_t numTriangles = triangles.indices.size() / 3;
+
+    // setup and binning: every part bins its own triangles in order, so a tile that goes
+    // through the parts in order sees them in the order they were submitted
+    m_setup.resize(numTriangles);
+    const size_t parts = ofxGpuThicklinesParallel::numParts(numTriangles, 4096);
+    m_bins.resize(parts);
+    vector<size_t> partTriangles(parts, 0);
+    ofxGpuThicklinesParallel::forParts(numTriangles, parts, [&](size_t begin, size_t end, size_t p) {
+        vector< vector<unsigned int> > &bins = m_bins[p];
+        bins.resize(numTiles);
+        for(vector<unsigned int> &bin : bins)
+            bin.clear();
+        for(size_t t=begin; t<end; ++t) {
+            Triangle &tri = m_setup[t];
+            bool dropped = false;
+            for(int k=0; k<3; ++k) {
+                tri.vertex[k] = triangles.indices[3 * t + k];
+                const ofVec2f &ndc = triangles.vertices[tri.vertex[k]].position;
+                float x = (ndc.x + 1.0f) * 0.5f * w, y = (ndc.y + 1.0f) * 0.5f * h;
+                // also catches NaN, from segments of zero length
+                if(! (x > -guardBand && x < w + guardBand && y > -guardBand && y < h + guardBand)) {
+                    dropped = true;
+                    break;
+                }
+                tri.x[k] = int32_t(std::floor(x * subpixels + 0.5f));
+                tri.y[k] = int32_t(std::floor(y * subpixels + 0.5f));
+            }
+            if(dropped) continue;
+            tri.area = orient(tri.x[0], tri.y[0], tri.x[1], tri.y[1], tri.x[2], tri.y[2]);
+            if(tri.area == 0) continue;
+            if(tri.area < 0) { // no culling: both windings are drawn
+                std::swap(tri.x[1], tri.x[2]);
+                std::swap(tri.y[1], tri.y[2]);
+                std::swap(tri.vertex[1], tri.vertex[2]);
+                tri.area = -tri.area;
+            }
+            tri.minX = std::max(0, firstCenter(std::min(tri.x[0], std::min(tri.x[1], tri.x[2]))));
+            tri.minY = std::max(0, firstCenter(std::min(tri.y[0], std::min(tri.y[1], tri.y[2]))));
+            tri.maxX = std::min(w - 1, lastCenter(std::max(tri.x[0], std::max(tri.x[1], tri.x[2]))));
+            tri.maxY = std::min(h - 1, lastCenter(std::max(tri.y[0], std::max(tri.y[1], tri.y[2]))));
+            if(tri.minX > tri.maxX || tri.minY > tri.maxY) continue;
+            ++partTriangles[p];
+            for(int ty=tri.minY / tileSize; ty<=tri.maxY / tileSize; ++ty) {
+                for(int tx=tri.minX / tileSize; tx<=tri.maxX / tileSize; ++tx)
+                    bins[ty * tilesX + tx].push_back(unsigned(t));
+            }
+        }
+    });
+    for(size_t n : partTriangles)
+        m_stats.triangles += n;
+    m_stats.setupMs = (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+
+    t0 = ofGetElapsedTimeMicros();
+    m_tileFragments.assign(numTiles, 0);
+    ofxGpuThicklinesParallel::forRange(numTiles, [&](size_t begin, size_t end) {
+        for(size_t tile=begin; tile<end; ++tile)
+            rasterizeTile(tile, triangles);
+    }, 1);
+    for(size_t n : m_tileFragments)
+        m_stats.fragments += n;
+    m_stats.rasterMs = (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+}
+
+void ofxGpuThicklinesRasterizer::rasterizeTile(size_t tile, const ofxGpuThicklinesTessellator::Output &triangles) {
+    const size_t tilesX = (width() + tileSize - 1) / tileSize;
+    const int tileX0 = int(tile % tilesX) * tileSize, tileY0 = int(tile / tilesX) * tileSize;
+    const int tileX1 = std::min(int(width()), tileX0 + tileSize) - 1;
+    const int tileY1 = std::min(int(height()), tileY0 + tileSize) - 1;
+    unsigned char *image = m_pixels.getData();
+    size_t fragments = 0;
+
+    for(const vector< vector<unsigned int> > &bins : m_bins) {
+        for(unsigned int t : bins[tile]) {
+            const Triangle &tri = m_setup[t];
+            const int x0 = std::max(tri.minX, tileX0), x1 = std::min(tri.maxX, tileX1);
+            const int y0 = std::max(tri.minY, tileY0), y1 = std::min(tri.maxY, tileY1);
+            if(x0 > x1 || y0 > y1) continue;
+
+            // edge i is opposite to vertex i. Pixels exactly on an edge belong to the triangle
+            // if the edge is a top or left one, i.e. runs down or, horizontally, to the left.
+            int64_t stepX[3], stepY[3];
+            int bias[3];
+            for(int i=0; i<3; ++i) {
+                const int a = (i + 1) % 3, b = (i + 2) % 3;
+                const int32_t dx = tri.x[b] - tri.x[a], dy = tri.y[b] - tri.y[a];
+                stepX[i] = -int64_t(dy) * subpixels;
+                stepY[i] = int64_t(dx) * subpixels;
+                bias[i] = (dy < 0 || (dy == 0 && dx < 0)) ? 1 : 0;
+            }
+            const ofxGpuThicklinesTessellator::Vertex *v[3] = {
+                &triangles.vertices[tri.vertex[0]], &triangles.vertices[tri.vertex[1]], &triangles.vertices[tri.vertex[2]]
+            };
+            const float inverseArea = 1.0f / float(tri.area);
+
+            const int32_t cx = x0 * subpixels + subpixels / 2, cy = y0 * subpixels + subpixels / 2;
+            int64_t row[3];
+            for(int i=0; i<3; ++i) {
+                const int a = (i + 1) % 3, b = (i + 2) % 3;
+                row[i] = orient(tri.x[a], tri.y[a], tri.x[b], tri.y[b], cx, cy);
+            }
+            for(int y=y0; y<=y1; ++y) {
+                // the span of the row inside all three edges, solved exactly instead of testing
+                // every pixel of the bounding box, which is mostly empty for thin diagonal lines
+                int64_t first = 0, last = x1 - x0;
+                for(int i=0; i<3; ++i) {
+                    // inside where row[i] + k * stepX[i] + bias[i] > 0, for pixel k of the row
+                    const int64_t r = row[i] + bias[i];
+                    if(stepX[i] > 0)
+                        first = std::max(first, floorDiv(-r, stepX[i]) + 1);
+                    else if(stepX[i] < 0)
+                        last = std::min(last, -floorDiv(-r, -stepX[i]) - 1);
+                    else if(r <= 0)
+                        last = -1;
+                }
+                if(first <= last) {
+                    int64_t e[3];
+                    for(int i=0; i<3; ++i)
+                        e[i] = row[i] + first * stepX[i];
+                    unsigned char *out = image + ((height() - 1 - y) * width() + x0 + first) * 4;
+                    for(int64_t k=first; k<=last; ++k, out+=4) {
+                        // colors are interpolated linearly on screen: the shaders output w = 1
+                        const float b0 = e[0] * inverseArea, b1 = e[1] * inverseArea, b2 = e[2] * inverseArea;
+                        const ofVec4f color = v[0]->color * b0 + v[1]->color * b1 + v[2]->color * b2;
+                        // the default fragment shader, and the clamp of a fixed point framebuffer
+                        const float src[4] = {
+                            std::min(std::max(m_globalColor.r * color.x, 0.0f), 1.0f),
+                            std::min(std::max(m_globalColor.g * color.y, 0.0f), 1.0f),
+                            std::min(std::max(m_globalColor.b * color.z, 0.0f), 1.0f),
+                            std::min(std::max(m_globalColor.a * color.w, 0.0f), 1.0f)
+                        };
+                        blend(m_blendMode, src, out);
+                        for(int i=0; i<3; ++i)
+                            e[i] += stepX[i];
+                    }
+                    fragments += size_t(last - first + 1);
+                }
+                for(int i=0; i<3; ++i)
+                    row[i] += stepY[i];
+            }
+        }
+    }
+    m_tileFragments[tile] = fragments;
+}
+
+ofxGpuThicklinesRasterizer::Difference ofxGpuThicklinesRasterizer::compare(const ofPixels &a, const ofPixels &b, int tolerance) {
+    Difference d = { 0, 0 };
+    if(a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight() || a.getNumChannels() != b.getNumChannels()) {
+        d.pixels = std::max(a.getWidth() * a.getHeight(), b.getWidth() * b.getHeight());
+        d.maxDifference = 255;
+        return d;
+    }
+    const size_t channels = a.getNumChannels();
+    const unsigned char *pa = a.getData(), *pb = b.getData();
+    for(size_t i=0; i<a.getWidth() * a.getHeight(); ++i) {
+        int largest = 0;
+        for(size_t c=0; c<channels; ++c)
+            largest = std::max(largest, std::abs(int(pa[i * channels + c]) - int(pb[i * channels + c])));
+        if(largest > tolerance)
+            ++d.pixels;
+        d.maxDifference = std::max(d.maxDifference, largest);
+    }
+    return d;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxGpuThicklines.h"
+#include "ofxGpuThicklinesTessellator.h"
+
+// draws ofxGpuThicklines on the CPU into an image, as a reference for what the GPU backends
+// draw: the vertex transform and geometry shader expansion of ofxGpuThicklinesTessellator,
+// then rasterization with the rules of GL and the default fragment shader
+// (`globalColor * fColorVarying`), blended like the GL blend modes of openFrameworks.
+//
+// the result only depends on the input, not on the machine or the number of threads, so it
+// can be compared with golden images byte for byte. Triangle setup is done in parallel and the
+// triangles are binned into tiles of `tileSize` pixels, which are rasterized in parallel, each
+// in the order the triangles were submitted. Vertices are snapped to 1/256 of a pixel, pixels
+// are covered by their center, and the top-left rule decides pixels on a shared edge, so
+// triangles of one segment never blend a pixel twice. Triangles reaching further than
+// `guardBand` pixels outside the image are dropped instead of clipped.
+//
+// like the tessellator, only the adjacency index modes are supported.
+class ofxGpuThicklinesRasterizer
+{
+public:
+    ofxGpuThicklinesRasterizer() : m_globalColor(1, 1, 1, 1), m_blendMode(OF_BLENDMODE_ALPHA) { m_stats = Stats(); }
+
+    static const int tileSize = 64;
+    static const int guardBand = 1 << 20;
+
+    // RGBA, cleared to `background`
+    void allocate(size_t width, size_t height, const ofFloatColor &background = ofFloatColor(0, 0, 0, 1));
+    void clear(const ofFloatColor &background);
+    size_t width() const { return m_pixels.getWidth(); }
+    size_t height() const { return m_pixels.getHeight(); }
+
+    // what `ofSetColor()` and `ofEnableBlendMode()` would be for the GPU draw. ofSetColor() is
+    // white and the blend mode alpha by default, as in openFrameworks.
+    void setGlobalColor(const ofFloatColor &color) { m_globalColor = color; }
+    void setBlendMode(ofBlendMode mode) { m_blendMode = mode; }
+
+    // like `lines.draw(lineWidth, perspective)` into the whole image, with `modelViewProjection`
+    // as the matrix the shader would get
+    void draw(const ofxGpuThicklines &lines, const ofMatrix4x4 &modelViewProjection, float lineWidth = 3,
+              bool perspective = true);
+    // triangles of the tessellator, in normalized device coordinates
+    void draw(const ofxGpuThicklinesTessellator::Output &triangles);
+
+    // top row first, as an image file has it
+    const ofPixels &pixels() const { return m_pixels; }
+
+    struct Stats {
+        size_t triangles; // drawn, without the degenerate and dropped ones
+        size_t fragments;
+        float tessellateMs;
+        float setupMs;    // triangle setup and binning
+        float rasterMs;
+    };
+    // of the last `draw()`
+    const Stats &stats() const { return m_stats; }
+
+    // pixels in which some channel differs by more than `tolerance`, and the largest difference.
+    // Images of different sizes differ in every pixel.
+    struct Difference {
+        size_t pixels;
+        int maxDifference;
+    };
+    static Difference compare(const ofPixels &a, const ofPixels &b, int tolerance = 0);
+
+protected:
+    struct Triangle {
+        int32_t x[3], y[3]; // window coordinates in 1/256 pixel, counterclockwise
+        unsigned int vertex[3];
+        int64_t area;       // twice the area in 1/256^2 pixel
+        int minX, minY, maxX, maxY; // covered pixels
+    };
+    void rasterizeTile(size_t tile, const ofxGpuThicklinesTessellator::Output &triangles);
+
+    ofPixels m_pixels;
+    ofFloatColor m_globalColor;
+    ofBlendMode m_blendMode;
+    ofxGpuThicklinesTessellator m_tessellator;
+    ofxGpuThicklinesTessellator::Output m_triangles;
+    vector<Triangle> m_setup;
+    vector< vector< vector<unsigned int> > > m_bins; // per part of the setup, per tile: triangles
+    vector<size_t> m_tileFragments;
+    Stats m_stats;
+};
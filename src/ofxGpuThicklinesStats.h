@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// frame statistics of ofxGpuThicklines
+namespace ofxGpuThicklinesStats {
+
+struct Summary {
+    float min, avg, p99;
+};
+
+// of `values`, all 0 when there are none
+inline Summary summarize(std::vector<float> values) {
+    Summary s = { 0, 0, 0 };
+    if(values.empty()) return s;
+    double sum = 0;
+    for(float v : values)
+        sum += v;
+    s.avg = float(sum / values.size());
+    s.min = *std::min_element(values.begin(), values.end());
+    // nearest rank
+    size_t rank = (values.size() * 99 + 99) / 100 - 1;
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    s.p99 = values[rank];
+    return s;
+}
+
+// the last `capacity` elements pushed, older ones are overwritten.
+// indexed oldest first.
+template<typename T>
+class Ring {
+public:
+    explicit Ring(size_t capacity) : m_elements(capacity), m_first(0), m_size(0) {}
+
+    void push(const T &element) {
+        if(m_size < m_elements.size()) {
+            m_elements[(m_first + m_size++) % m_elements.size()] = element;
+        }
+        else {
+            m_elements[m_first] = element;
+            m_first = (m_first + 1) % m_elements.size();
+        }
+    }
+    void clear() { m_first = m_size = 0; }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    T &operator[](size_t i) { return m_elements[(m_first + i) % m_elements.size()]; }
+    const T &operator[](size_t i) const { return m_elements[(m_first + i) % m_elements.size()]; }
+    T &back() { return (*this)[m_size - 1]; }
+    const T &back() const { return (*this)[m_size - 1]; }
+
+private:
+    std::vector<T> m_elements;
+    size_t m_first, m_size;
+};
+
+} // namespace ofxGpuThicklinesStats
@@ -0,0 +1,330 @@
+#include "ofxGpuThicklinesTessellator.h"
+#include "ofxGpuThicklinesMath.h"
+#include "ofxGpuThicklinesParallel.h"
+#include <cmath>
+
+namespace {
+
+const unsigned int restartIndex = 0xffffffff;
+
+// segments are expanded `lanes` at a time. All per-segment math runs in loops over the lanes of
+// structure-of-arrays batches, written without branches so that the compiler turns them into
+// SIMD code for whatever the target has (SSE/AVX, NEON).
+const int lanes = 8;
+
+struct SegmentBatch {
+    int count;
+    unsigned int index[4][lanes];         // previous, start, end and next vertex
+    float x[4][lanes], y[4][lanes], w[4][lanes];
+};
+
+// everything the output vertices of a segment are made of, as in ofxGpuThicklinesMath::segmentFrame()
+struct ExpandedBatch {
+    float p1x[lanes], p1y[lanes], p2x[lanes], p2y[lanes];
+    float ax[lanes], ay[lanes];           // miter_a * length_a
+    float bx[lanes], by[lanes];           // miter_b * length_b
+    float cx[lanes], cy[lanes];           // outer corner of the MITER_LIMIT triangle (both coincide, as n0 == n1)
+    float g[lanes];
+    int capStart[lanes];
+};
+
+// the square roots get loops of their own: as std::sqrt may set errno, GCC only vectorizes
+// loops calling it with -fno-math-errno (or -ffast-math). This way only they stay scalar.
+inline void sqrtLanes(float *v, int n) {
+    for(int i=0; i<n; ++i)
+        v[i] = std::sqrt(v[i]);
+}
+
+// `perspective` is a template argument so that the loops have no branch left
+template<bool perspective>
+void expandBatch(const SegmentBatch &in, const ofxGpuThicklinesMath::Params &params, ExpandedBatch &out) {
+    const float vx = params.viewportSize.x;
+    const float vy = params.viewportSize.y;
+    const float thickness = params.thickness;
+
+    // screen space positions and the directions of the previous, current and next segment
+    float px[4][lanes], py[4][lanes];
+    for(int k=0; k<4; ++k) {
+        for(int l=0; l<lanes; ++l) {
+            px[k][l] = in.x[k][l] / in.w[k][l] * vx;
+            py[k][l] = in.y[k][l] / in.w[k][l] * vy;
+        }
+    }
+    float dx[3][lanes], dy[3][lanes], len[3][lanes];
+    for(int k=0; k<3; ++k) {
+        for(int l=0; l<lanes; ++l) {
+            dx[k][l] = px[k + 1][l] - px[k][l];
+            dy[k][l] = py[k + 1][l] - py[k][l];
+            len[k][l] = dx[k][l] * dx[k][l] + dy[k][l] * dy[k][l];
+        }
+    }
+    for(int l=0; l<lanes; ++l) {
+        out.p1x[l] = px[1][l]; out.p1y[l] = py[1][l];
+        out.p2x[l] = px[2][l]; out.p2y[l] = py[2][l];
+    }
+    sqrtLanes(&len[0][0], 3 * lanes);
+
+    // n0 = n2 = n1, like the FIXME in the geometry shader, so both miters are normalize(n1 + n1)
+    float miterLen[lanes];
+    for(int l=0; l<lanes; ++l) {
+        float n1x = -(dy[1][l] / len[1][l]), n1y = dx[1][l] / len[1][l];
+        float sx = n1x + n1x, sy = n1y + n1y;
+        miterLen[l] = sx * sx + sy * sy;
+    }
+    sqrtLanes(miterLen, lanes);
+
+    // both variants of the offsets at p1 and p2: with the miter, and along the normal where the
+    // angle exceeds MITER_LIMIT. They are kept in arrays and picked in a loop of its own, otherwise
+    // the compiler moves each computation into a branch, and a loop with branches is not vectorized.
+    float miterX[2][lanes], miterY[2][lanes], normalX[2][lanes], normalY[2][lanes];
+    int cap[2][lanes];
+    for(int l=0; l<lanes; ++l) {
+        float thicknessA = thickness * (perspective ? (500.0f / in.w[1][l]) : 1.0f);
+        float thicknessB = thickness * (perspective ? (500.0f / in.w[2][l]) : 1.0f);
+
+        float v0x = dx[0][l] / len[0][l], v0y = dy[0][l] / len[0][l];
+        float v1x = dx[1][l] / len[1][l], v1y = dy[1][l] / len[1][l];
+        float v2x = dx[2][l] / len[2][l], v2y = dy[2][l] / len[2][l];
+
+        float n1x = -v1y, n1y = v1x;
+        float mx = (n1x + n1x) / miterLen[l], my = (n1y + n1y) / miterLen[l];
+        float miterDot = mx * n1x + my * n1y;
+        float lengthA = thicknessA / miterDot;
+        float lengthB = thicknessB / miterDot;
+        miterX[0][l] = mx * lengthA; miterY[0][l] = my * lengthA;
+        miterX[1][l] = mx * lengthB; miterY[1][l] = my * lengthB;
+        normalX[0][l] = n1x * thicknessA; normalY[0][l] = n1y * thicknessA;
+        normalX[1][l] = n1x * thicknessB; normalY[1][l] = n1y * thicknessB;
+
+        cap[0][l] = v0x * v1x + v0y * v1y < -OFX_GPU_THICKLINES_MITER_LIMIT;
+        cap[1][l] = v1x * v2x + v1y * v2y < -OFX_GPU_THICKLINES_MITER_LIMIT;
+
+        // the triangle filling the corner at p1
+        float dn = v0x * n1x + v0y * n1y;
+        float f = float(dn > 0) - float(dn < 0); // sign(dn)
+        float g = 1.0f - std::fabs(f);
+        // mix(n0, n1, g), which equals mix(n1, n0, g) with n0 == n1
+        float cnx = n1x * (1.0f - g) + n1x * g, cny = n1y * (1.0f - g) + n1y * g;
+        float capScale = thicknessA * f;
+        out.cx[l] = out.p1x[l] + cnx * capScale; out.cy[l] = out.p1y[l] + cny * capScale;
+        out.g[l] = g;
+        out.capStart[l] = cap[0][l];
+    }
+
+    for(int l=0; l<lanes; ++l) {
+        out.ax[l] = cap[0][l] ? normalX[0][l] : miterX[0][l];
+        out.ay[l] = cap[0][l] ? normalY[0][l] : miterY[0][l];
+        out.bx[l] = cap[1][l] ? normalX[1][l] : miterX[1][l];
+        out.by[l] = cap[1][l] ? normalY[1][l] : miterY[1][l];
+    }
+}
+
+void expandBatch(const SegmentBatch &in, const ofxGpuThicklinesMath::Params &params, ExpandedBatch &out) {
+    if(params.perspective)
+        expandBatch<true>(in, params, out);
+    else
+        expandBatch<false>(in, params, out);
+}
+
+void emitBatch(const SegmentBatch &in, const ExpandedBatch &e, const ofxGpuThicklinesTessellator::Input &src,
+               const ofxGpuThicklinesMath::Params &params, ofxGpuThicklinesTessellator::Output &out) {
+    const float vx = params.viewportSize.x;
+    const float vy = params.viewportSize.y;
+
+    int caps = 0;
+    for(int l=0; l<in.count; ++l) caps += e.capStart[l];
+    size_t firstVertex = out.vertices.size(), firstIndex = out.indices.size();
+    out.vertices.resize(firstVertex + 4 * in.count + 3 * caps);
+    out.indices.resize(firstIndex + 6 * in.count + 3 * caps);
+    ofxGpuThicklinesTessellator::Vertex *v = &out.vertices[firstVertex];
+    unsigned int *idx = &out.indices[firstIndex];
+    unsigned int base = firstVertex;
+
+    for(int l=0; l<in.count; ++l) {
+        unsigned int i1 = in.index[1][l], i2 = in.index[2][l];
+        ofxGpuThicklinesTessellator::Vertex start, end;
+        start.color = src.colors[i1];
+        end.color = src.colors[i2];
+        start.texcoord = src.texcoords ? src.texcoords[i1] : ofVec2f(0, 0);
+        end.texcoord = src.texcoords ? src.texcoords[i2] : ofVec2f(0, 0);
+        start.edgeTexCoord = end.edgeTexCoord = (start.texcoord + end.texcoord) / 2.0f;
+        start.edgeID = end.edgeID = src.edgeTable ? ofxGpuThicklinesMath::edgeID(src.edgeTable, src.numVertices, i1, i2, src.edgeIdBase)
+                                                  : ofxGpuThicklinesMath::edgeHash(i1, i2);
+
+        if(e.capStart[l]) {
+            v[0] = start;
+            v[0].localTexCoord = ofVec2f(0, e.g[l]);
+            v[0].position = ofVec2f(e.cx[l] / vx, e.cy[l] / vy);
+            v[1] = v[0];
+            v[2] = start;
+            v[2].localTexCoord = ofVec2f(0, 0.5f);
+            v[2].position = ofVec2f(e.p1x[l] / vx, e.p1y[l] / vy);
+            idx[0] = base; idx[1] = base + 1; idx[2] = base + 2;
+            v += 3; idx += 3; base += 3;
+        }
+
+        // the strip of the geometry shader, as two triangles
+        v[0] = start;
+        v[0].localTexCoord = ofVec2f(0, 0);
+        v[0].position = ofVec2f((e.p1x[l] + e.ax[l]) / vx, (e.p1y[l] + e.ay[l]) / vy);
+        v[1] = start;
+        v[1].localTexCoord = ofVec2f(0, 1);
+        v[1].position = ofVec2f((e.p1x[l] - e.ax[l]) / vx, (e.p1y[l] - e.ay[l]) / vy);
+        v[2] = end;
+        v[2].localTexCoord = ofVec2f(1, 0);
+        v[2].position = ofVec2f((e.p2x[l] + e.bx[l]) / vx, (e.p2y[l] + e.by[l]) / vy);
+        v[3] = end;
+        v[3].localTexCoord = ofVec2f(1, 1);
+        v[3].position = ofVec2f((e.p2x[l] - e.bx[l]) / vx, (e.p2y[l] - e.by[l]) / vy);
+        idx[0] = base; idx[1] = base + 1; idx[2] = base + 2;
+        idx[3] = base + 2; idx[4] = base + 1; idx[5] = base + 3;
+        v += 4; idx += 6; base += 4;
+    }
+}
+
+} // namespace
+
+ofxGpuThicklinesTessellator::Input ofxGpuThicklinesTessellator::input(const ofxGpuThicklines &lines) {
+    Input in;
+    in.positions = lines.positions().data();
+    in.colors = lines.colors().data();
+    in.texcoords = lines.texcoords().empty() ? nullptr : lines.texcoords().data();
+    in.numVertices = lines.positions().size();
+    in.indices = lines.indices().data();
+    in.numIndices = lines.numIndices();
+    in.mode = lines.indexMode();
+    in.edgeTable = lines.edgeTable().empty() ? nullptr : lines.edgeTable().data();
+    in.edgeIdBase = lines.edgeIdBase();
+    return in;
+}
+
+void ofxGpuThicklinesTessellator::tessellate(const Input &in, const ofMatrix4x4 &modelViewProjection, ofVec2f viewportSize,
+                                             float lineWidth, bool perspective, Output &out) {
+    uint64_t t0 = ofGetElapsedTimeMicros();
+
+    if(in.mode == ofxGpuThicklines::INDEX_LINES) {
+        // the joins of this mode live in a vertex attribute the tessellator does not read
+        ofLogWarning("ofxGpuThicklines") << "the tessellator only supports the adjacency index modes";
+        out.vertices.clear();
+        out.indices.clear();
+        m_stats = Stats();
+        return;
+    }
+    if(viewportSize.x == 0)
+        viewportSize = ofVec2f(ofGetWidth(), ofGetHeight());
+    ofxGpuThicklinesMath::Params params;
+    params.thickness = lineWidth;
+    params.perspective = perspective;
+    params.viewportSize = ofxGpuThicklinesMath::Vec2(viewportSize.x, viewportSize.y);
+
+    // clip space positions, once per vertex instead of once per segment corner
+    m_clipX.resize(in.numVertices);
+    m_clipY.resize(in.numVertices);
+    m_clipW.resize(in.numVertices);
+    const float *m = modelViewProjection.getPtr();
+    ofxGpuThicklinesParallel::forRange(in.numVertices, [&](size_t begin, size_t end) {
+        for(size_t i=begin; i<end; ++i) {
+            const ofVec3f &p = in.positions[i];
+            m_clipX[i] = p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12];
+            m_clipY[i] = p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13];
+            m_clipW[i] = p.x * m[3] + p.y * m[7] + p.z * m[11] + m[15];
+        }
+    });
+
+    // every segment is a window of 4 indices: one per 4 indices in the adjacency layout,
+    // one per index in the strip layout. Windows touching a restart index are no segment.
+    const bool strip = in.mode == ofxGpuThicklines::INDEX_LINE_STRIP_ADJACENCY;
+    const size_t windowStep = strip ? 1 : 4;
+    const size_t numWindows = in.numIndices < 4 ? 0 : (strip ? in.numIndices - 3 : in.numIndices / 4);
+
+    const size_t parts = ofxGpuThicklinesParallel::numParts(numWindows, 4096);
+    // each part collects its triangles with indices relative to itself, in buffers kept for the next call
+    m_parts.resize(parts);
+    vector<size_t> partSegments(parts, 0);
+    ofxGpuThicklinesParallel::forParts(numWindows, parts, [&](size_t begin, size_t end, size_t p) {
+        Output &po = m_parts[p];
+        po.vertices.clear();
+        po.indices.clear();
+        po.vertices.reserve((end - begin) * 4);
+        po.indices.reserve((end - begin) * 6);
+        SegmentBatch batch;
+        ExpandedBatch expanded;
+        batch.count = 0;
+        for(size_t s=begin; s<end; ++s) {
+            const unsigned int *w = in.indices + s * windowStep;
+            if(w[0] == restartIndex || w[1] == restartIndex || w[2] == restartIndex || w[3] == restartIndex)
+                continue;
+            for(int k=0; k<4; ++k) {
+                batch.index[k][batch.count] = w[k];
+                batch.x[k][batch.count] = m_clipX[w[k]];
+                batch.y[k][batch.count] = m_clipY[w[k]];
+                batch.w[k][batch.count] = m_clipW[w[k]];
+            }
+            if(++batch.count == lanes) {
+                expandBatch(batch, params, expanded);
+                emitBatch(batch, expanded, in, params, po);
+                partSegments[p] += batch.count;
+                batch.count = 0;
+            }
+        }
+        if(batch.count > 0) {
+            // pad the unused lanes with a copy of the first segment, their results are not emitted
+            for(int l=batch.count; l<lanes; ++l) {
+                for(int k=0; k<4; ++k) {
+                    batch.x[k][l] = batch.x[k][0];
+                    batch.y[k][l] = batch.y[k][0];
+                    batch.w[k][l] = batch.w[k][0];
+                }
+            }
+            expandBatch(batch, params, expanded);
+            emitBatch(batch, expanded, in, params, po);
+            partSegments[p] += batch.count;
+        }
+    });
+
+    // concatenate the parts
+    size_t segments = 0;
+    for(size_t p=0; p<parts; ++p)
+        segments += partSegments[p];
+    if(parts == 1) {
+        out.vertices.swap(m_parts[0].vertices);
+        out.indices.swap(m_parts[0].indices);
+    }
+    else {
+        vector<size_t> vertexOffset(parts + 1, 0), indexOffset(parts + 1, 0);
+        for(size_t p=0; p<parts; ++p) {
+            vertexOffset[p + 1] = vertexOffset[p] + m_parts[p].vertices.size();
+            indexOffset[p + 1] = indexOffset[p] + m_parts[p].indices.size();
+        }
+        out.vertices.resize(vertexOffset[parts]);
+        out.indices.resize(indexOffset[parts]);
+        ofxGpuThicklinesParallel::Pool::instance().run(parts, [&](size_t p) {
+            const Output &po = m_parts[p];
+            std::copy(po.vertices.begin(), po.vertices.end(), out.vertices.begin() + vertexOffset[p]);
+            unsigned int base = vertexOffset[p];
+            unsigned int *dst = out.indices.data() + indexOffset[p];
+            for(size_t i=0; i<po.indices.size(); ++i)
+                dst[i] = po.indices[i] + base;
+        });
+    }
+
+    m_stats.segments = segments;
+    m_stats.triangles = out.indices.size() / 3;
+    m_stats.milliseconds = (ofGetElapsedTimeMicros() - t0) / 1000.0f;
+    m_stats.segmentsPerSecond = m_stats.milliseconds > 0 ? segments / (m_stats.milliseconds / 1000.0) : 0;
+    ofLogVerbose("ofxGpuThicklines") << "tessellated " << segments << " segments into " << m_stats.triangles
+                                     << " triangles in " << m_stats.milliseconds << " ms";
+}
+
+ofMesh ofxGpuThicklinesTessellator::Output::toMesh() const {
+    ofMesh mesh;
+    mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+    for(const Vertex &v : vertices) {
+        mesh.addVertex(ofVec3f(v.position.x, v.position.y, 0));
+        mesh.addColor(ofFloatColor(v.color.x, v.color.y, v.color.z, v.color.w));
+        mesh.addTexCoord(v.texcoord);
+    }
+    for(unsigned int i : indices)
+        mesh.addIndex(i);
+    return mesh;
+}
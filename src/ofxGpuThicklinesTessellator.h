@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxGpuThicklines.h"
+
+// turns the curves of an ofxGpuThicklines into plain triangles on the CPU, with the same
+// output as the geometry shader: screen space expansion, miters, the MITER_LIMIT corner
+// triangle and the `flocalTexCoord`/`fedgeTexCoord` values.
+//
+// use it on targets without geometry shaders or for headless exports. The segments are
+// processed in fixed-width batches stored as structure-of-arrays, spread over all cores.
+class ofxGpuThicklinesTessellator
+{
+public:
+    ofxGpuThicklinesTessellator() { m_stats = Stats(); }
+
+    // the raw data to tessellate, as kept by ofxGpuThicklines.
+    // `texcoords` may be null. `indices` uses the layout of `mode`, with 0xffffffff as restart index. INDEX_LINES is not supported.
+    struct Input {
+        const ofVec3f *positions;
+        const ofVec4f *colors;
+        const ofVec2f *texcoords;
+        size_t numVertices;
+        const unsigned int *indices;
+        size_t numIndices;
+        ofxGpuThicklines::IndexMode mode;
+        // `ofxGpuThicklines::edgeTable()` and `edgeIdBase()` for the edge ids. Without a table,
+        // the ids are the hash of the batch and trail shaders.
+        const unsigned int *edgeTable;
+        unsigned int edgeIdBase;
+    };
+    static Input input(const ofxGpuThicklines &lines);
+
+    struct Vertex {
+        ofVec2f position;      // normalized device coordinates
+        ofVec4f color;         // fColorVarying
+        ofVec2f texcoord;      // fTexCoordVarying
+        ofVec2f localTexCoord; // flocalTexCoord
+        ofVec2f edgeTexCoord;  // fedgeTexCoord
+        int edgeID;
+    };
+    // triangles: every three indices form one
+    struct Output {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+
+        // positions (with z = 0), colors, texcoords and indices as an OF_PRIMITIVE_TRIANGLES mesh
+        ofMesh toMesh() const;
+    };
+
+    struct Stats {
+        size_t segments;
+        size_t triangles;
+        float milliseconds;
+        double segmentsPerSecond;
+    };
+
+    // the arguments are the same as for `ofxGpuThicklines::draw()`, plus the model view
+    // projection matrix the shader would get. Texture coordinates are used as they are,
+    // i.e. with an identity texture matrix.
+    void tessellate(const Input &in, const ofMatrix4x4 &modelViewProjection, ofVec2f viewportSize,
+                    float lineWidth, bool perspective, Output &out);
+    void tessellate(const ofxGpuThicklines &lines, const ofMatrix4x4 &modelViewProjection, ofVec2f viewportSize,
+                    float lineWidth, bool perspective, Output &out) {
+        tessellate(input(lines), modelViewProjection, viewportSize, lineWidth, perspective, out);
+    }
+
+    // of the last `tessellate()` call
+    const Stats &stats() const { return m_stats; }
+
+protected:
+    vector<float> m_clipX, m_clipY, m_clipW; // per vertex, structure-of-arrays
+    vector<Output> m_parts; // per thread output, indices relative to the part
+    Stats m_stats;
+};
@@ -0,0 +1,130 @@
+#include "ofxGpuThicklinesTrail.h"
+#include <algorithm>
+
+namespace {
+    const size_t indicesPerSegment = 4;
+
+    using ofxGpuThicklinesRanges::uploadRanges;
+}
+
+void ofxGpuThicklinesTrail::setup(size_t capacity, string customFragShader) {
+    m_sharedShader = ofxGpuThicklines::sharedShader(ofxGpuThicklines::BACKEND_GEOMETRY_SHADER, "", customFragShader);
+    m_shader = *m_sharedShader;
+    m_colorLocation = m_shader.getAttributeLocation("color");
+    if(m_colorLocation < 0) m_colorLocation = ofShader::COLOR_ATTRIBUTE;
+
+    m_capacity = std::max(capacity, size_t(2));
+    m_positions.assign(m_capacity, ofVec3f());
+    m_colors.assign(m_capacity, ofVec4f(1,1,1,1));
+    m_indices.assign(m_capacity * indicesPerSegment, 0);
+    m_first = m_size = 0;
+    m_dirtyVertices.clear();
+    m_dirtyIndices.clear();
+    if(! m_indexBuffer.isAllocated())
+        m_indexBuffer.allocate();
+    m_buffersResized = true;
+}
+
+void ofxGpuThicklinesTrail::writeSegment(size_t s) {
+    // like `writeCurveIndices()`, the ends of the trail stand in for the missing neighbours
+    size_t end = (s + 1) % m_capacity;
+    size_t last = slot(m_size - 1);
+    unsigned int *out = &m_indices[s * indicesPerSegment];
+    out[0] = unsigned(s == m_first ? s : (s + m_capacity - 1) % m_capacity);
+    out[1] = unsigned(s);
+    out[2] = unsigned(end);
+    out[3] = unsigned(end == last ? end : (end + 1) % m_capacity);
+    m_dirtyIndices.add(s * indicesPerSegment, (s + 1) * indicesPerSegment);
+}
+
+void ofxGpuThicklinesTrail::append(const ofVec3f &point, const ofVec4f &color) {
+    if(m_capacity == 0) return;
+    if(m_size == m_capacity)
+        expire(1);
+    size_t t = slot(m_size);
+    m_positions[t] = point;
+    m_colors[t] = color;
+    m_dirtyVertices.add(t);
+    ++m_size;
+    // the new last segment, and the one before it now has a next point
+    if(m_size >= 2)
+        writeSegment(slot(m_size - 2));
+    if(m_size >= 3)
+        writeSegment(slot(m_size - 3));
+}
+
+void ofxGpuThicklinesTrail::expire(size_t n) {
+    n = std::min(n, m_size);
+    if(n == 0) return;
+    m_first = (m_first + n) % m_capacity;
+    m_size -= n;
+    if(m_size == 0)
+        m_first = 0;
+    // the new first segment starts without a previous point
+    if(m_size >= 2)
+        writeSegment(m_first);
+}
+
+void ofxGpuThicklinesTrail::upload() {
+    m_bytesUploaded = 0;
+    if(m_buffersResized) {
+        m_vbo.setVertexData(&m_positions[0], int(m_capacity), GL_DYNAMIC_DRAW);
+        m_vbo.setAttributeData(m_colorLocation, &m_colors[0].x, 4, int(m_capacity), GL_DYNAMIC_DRAW);
+        m_indexBuffer.setData(m_indices.size() * sizeof(unsigned int), &m_indices[0], GL_DYNAMIC_DRAW);
+        m_bytesUploaded = m_capacity * (sizeof(ofVec3f) + sizeof(ofVec4f)) + m_indices.size() * sizeof(unsigned int);
+        m_buffersResized = false;
+    }
+    else {
+        const vector<ofxGpuThicklinesRanges::DirtyRanges::Range> &vertices = m_dirtyVertices.coalesce(16);
+        m_bytesUploaded += uploadRanges(m_vbo.getVertexBuffer(), m_positions, vertices);
+        m_bytesUploaded += uploadRanges(m_vbo.getAttributeBuffer(m_colorLocation), m_colors, vertices);
+        m_bytesUploaded += uploadRanges(m_indexBuffer, m_indices, m_dirtyIndices.coalesce(16));
+    }
+    m_dirtyVertices.clear();
+    m_dirtyIndices.clear();
+}
+
+ofShader &ofxGpuThicklinesTrail::prepareDraw() {
+    m_shader.begin();
+    m_shaderBegun = true;
+    return m_shader;
+}
+
+void ofxGpuThicklinesTrail::draw(float lineWidth, bool perspective, ofVec2f viewportSize) {
+    if(m_capacity == 0) {
+        // nothing to draw, but the shader `prepareDraw()` began still has to end
+        if(m_shaderBegun)
+            m_shader.end();
+        m_shaderBegun = false;
+        return;
+    }
+    upload();
+    ofFill();
+    if(! m_shaderBegun)
+        m_shader.begin();
+    if(viewportSize.x == 0)
+        viewportSize = ofVec2f(ofGetWidth(), ofGetHeight());
+    m_shader.setUniform2f("viewportSize", viewportSize);
+    m_shader.setUniform1i("perspective", (int)perspective);
+    m_shader.setUniform1f("thickness", lineWidth);
+
+    if(m_size >= 2) {
+        // the segments from the first slot on, in two pieces when they wrap around
+        const size_t segments = m_size - 1;
+        const size_t head = std::min(segments, m_capacity - m_first);
+        m_drawCounts.assign(1, GLsizei(head * indicesPerSegment));
+        m_drawOffsets.assign(1, reinterpret_cast<const void*>(m_first * indicesPerSegment * sizeof(unsigned int)));
+        if(head < segments) {
+            m_drawCounts.push_back(GLsizei((segments - head) * indicesPerSegment));
+            m_drawOffsets.push_back(nullptr);
+        }
+        m_vbo.bind();
+        m_indexBuffer.bind(GL_ELEMENT_ARRAY_BUFFER);
+        glMultiDrawElements(GL_LINES_ADJACENCY, &m_drawCounts[0], GL_UNSIGNED_INT,
+                            &m_drawOffsets[0], GLsizei(m_drawCounts.size()));
+        m_vbo.unbind();
+    }
+
+    m_shader.end();
+    m_shaderBegun = false;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxGpuThicklines.h"
+#include "ofxGpuThicklinesRanges.h"
+
+// a single curve that grows at its end and shrinks at its start, for trails and time series.
+//
+// points live in a ring buffer of fixed capacity, and so do the segments in the index buffer:
+// segment i joins the points in slots i and i + 1. `append()` writes the new point and the
+// indices of at most two segments, `expire()` only moves the start and rewrites the indices of
+// the new first segment, so the upload per frame depends on the points added, not on the
+// length of the trail. When the trail wraps around the end of the ring, `draw()` submits it
+// as two ranges of one multi-draw.
+//
+// uses the geometry shader backend with INDEX_LINES_ADJACENCY indices.
+class ofxGpuThicklinesTrail
+{
+public:
+    ofxGpuThicklinesTrail() : m_colorLocation(ofShader::COLOR_ATTRIBUTE), m_capacity(0), m_first(0), m_size(0),
+                              m_buffersResized(false), m_bytesUploaded(0), m_shaderBegun(false) { ; }
+    virtual ~ofxGpuThicklinesTrail() { ; }
+
+    // the trail holds at most `capacity` points, at least 2
+    void setup(size_t capacity, string customFragShader = "");
+
+    // adds a point at the end, expiring the oldest one when the trail is full
+    void append(const ofVec3f &point, const ofVec4f &color);
+    void expire(size_t n); // drops the `n` oldest points
+    void clear() { expire(m_size); }
+
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    // the i-th oldest point
+    const ofVec3f &point(size_t i) const { return m_positions[slot(i)]; }
+    const ofVec4f &color(size_t i) const { return m_colors[slot(i)]; }
+
+    ofShader &prepareDraw(); // as in ofxGpuThicklines
+    void draw(float lineWidth = 3, bool perspective = true, ofVec2f viewportSize = ofVec2f(0,0));
+
+    // bytes sent to the GPU by the last `draw()`
+    size_t bytesUploaded() const { return m_bytesUploaded; }
+
+protected:
+    size_t slot(size_t i) const { return (m_first + i) % m_capacity; }
+    void writeSegment(size_t s); // the indices of the segment starting in slot s
+    void upload();
+
+    ofShader m_shader;
+    shared_ptr<ofShader> m_sharedShader;
+    GLint m_colorLocation;
+    ofVbo m_vbo;
+    ofBufferObject m_indexBuffer;
+
+    vector<ofVec3f> m_positions; // the ring, `m_capacity` slots
+    vector<ofVec4f> m_colors;
+    vector<unsigned int> m_indices; // 4 per slot, for the segment starting there
+    size_t m_capacity;
+    size_t m_first, m_size; // slot of the oldest point, number of points
+    bool m_buffersResized; // everything is uploaded again
+
+    ofxGpuThicklinesRanges::DirtyRanges m_dirtyVertices, m_dirtyIndices;
+    size_t m_bytesUploaded;
+    vector<GLsizei> m_drawCounts;
+    vector<const void*> m_drawOffsets;
+
+    bool m_shaderBegun;
+};